@@ -0,0 +1,121 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+# decoder for the binary console log (BINARY_LOG in config.h)
+# message table is read from sunray/binlog.h, console text between records is passed through
+#
+# usage:  python logdecode.py capture.bin            (file)
+#         python logdecode.py < capture.bin          (stdin)
+#         python logdecode.py --port /dev/ttyACM0    (serial port, needs pyserial)
+
+import os
+import re
+import struct
+import sys
+import time
+
+SYNC = 0xA5
+HEADER = 7   # sync, id, length, timestamp
+TYPES = {'f': 'f', 'd': 'd', 'i': 'i', 'u': 'I', 'b': 'B'}
+LEVELS = {'LOG_ERROR': 'E', 'LOG_WARN': 'W', 'LOG_INFO': 'I', 'LOG_DEBUG': 'D'}
+
+default_header = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'sunray', 'binlog.h')
+
+
+def load_messages(path=default_header):
+  # LOG_MSG(id, level, "types", "format") lines of message table (enum order)
+  messages = []
+  pattern = re.compile(r'^\s*LOG_MSG\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"(\w*)"\s*,\s*"(.*)"\s*\)')
+  with open(path) as f:
+    for line in f:
+      m = pattern.match(line)
+      if m:
+        name, level, types, fmt = m.groups()
+        fmt = fmt.encode('utf-8').decode('unicode_escape')
+        messages.append((name, LEVELS.get(level, '?'), '<' + ''.join(TYPES[t] for t in types), fmt))
+  return messages
+
+
+class LogDecoder:
+  def __init__(self, messages):
+    self.messages = messages
+    self.buf = bytearray()
+    self.records = 0
+    self.errors = 0   # checksum/length errors (resynchronized)
+
+  # drop partial record (data lost)
+  def reset(self):
+    self.buf = bytearray()
+
+  # returns list of (timestamp or None, text)
+  def feed(self, data):
+    self.buf += data
+    out = []
+    text = bytearray()
+    while self.buf:
+      if self.buf[0] != SYNC:
+        text.append(self.buf.pop(0))
+        continue
+      if len(self.buf) < HEADER:
+        break
+      msg_id = self.buf[1]
+      length = self.buf[2]
+      if (msg_id >= len(self.messages)) or (struct.calcsize(self.messages[msg_id][2]) != length):
+        self.errors += 1
+        text.append(self.buf.pop(0))
+        continue
+      if len(self.buf) < HEADER + length + 1:
+        break
+      checksum = 0
+      for b in self.buf[1:HEADER + length]:
+        checksum ^= b
+      if checksum != self.buf[HEADER + length]:
+        self.errors += 1
+        text.append(self.buf.pop(0))
+        continue
+      if text:
+        out.append((None, text.decode('utf-8', 'replace')))
+        text = bytearray()
+      name, level, layout, fmt = self.messages[msg_id]
+      timestamp = struct.unpack_from('<I', self.buf, 3)[0]
+      args = struct.unpack_from(layout, self.buf, HEADER)
+      out.append((timestamp, '[%s] %s\n' % (level, fmt % args)))
+      self.records += 1
+      del self.buf[:HEADER + length + 1]
+    if text:
+      out.append((None, text.decode('utf-8', 'replace')))
+    return out
+
+
+def format_line(timestamp, text):
+  if timestamp is None:
+    return text
+  return '%10.3f %s' % (timestamp / 1000.0, text)
+
+
+def main():
+  decoder = LogDecoder(load_messages())
+  if (len(sys.argv) > 2) and (sys.argv[1] == '--port'):
+    import serial
+    stream = serial.Serial(sys.argv[2], int(sys.argv[3]) if len(sys.argv) > 3 else 115200, timeout=0.1)
+    read = lambda: stream.read(1024)
+  else:
+    stream = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else getattr(sys.stdin, 'buffer', sys.stdin)
+    read = lambda: stream.read(4096)
+  try:
+    while True:
+      data = read()
+      if not data:
+        if not hasattr(stream, 'in_waiting'):
+          break
+        continue
+      for timestamp, text in decoder.feed(data):
+        sys.stdout.write(format_line(timestamp, text))
+      sys.stdout.flush()
+  except KeyboardInterrupt:
+    pass
+  sys.stderr.write('records=%d errors=%d\n' % (decoder.records, decoder.errors))
+
+
+if __name__ == '__main__':
+  main()
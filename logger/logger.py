@@ -1,31 +1,113 @@
 #!/usr/bin/env python
 # -*- coding: utf-8 -*-
 
+# UDP console logger (ENABLE_UDP in config.h)
+# datagram: 'S', 'R', sequence number (uint32), robot millis (uint32), console bytes
+# lost datagrams are detected by sequence gaps, console bytes are decoded (text and binary log records, see logdecode.py)
+# and all datagrams are written to a capture file for offline analysis:
+#   capture record: host time (double, s), sequence number (uint32), robot millis (uint32), length (uint16), console bytes
+#
+# usage:  python logger.py              (receive, print and capture)
+#         python logger.py capture.bin  (replay capture file)
+
 import socket
+import struct
+import sys
+import time
+
+from logdecode import LogDecoder, load_messages, format_line
 
 host = ""
 port = 4210
 
-bufsize = 99
-
-addr = (host, port)
-UDPSock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-UDPSock.bind(addr)
-UDPSock.setblocking(0)
-
-print("waiting for messages (port: " + str(port) + ") ...")
-
-# Endlosschleife fuer Empfang, Abbruch durch Strg-C
-try:
-  while True:
-    try: 
-      (data, addr) = UDPSock.recvfrom(bufsize)
-    except socket.error:
-      pass
-    else:   
-      print (data.decode('utf-8'), end='', flush=True)      
-except KeyboardInterrupt:
-  UDPSock.close()
-  print ("terminating ...")
-  exit(0)
-  
\ No newline at end of file
+bufsize = 2048
+
+HEADER = struct.Struct('<2sII')
+CAPTURE = struct.Struct('<dIIH')
+
+
+class Reassembler:
+  def __init__(self):
+    self.expected = None
+    self.packets = 0
+    self.lost = 0
+    self.reordered = 0
+
+  # returns message (or None) for sequence number of received datagram
+  def check(self, seq):
+    self.packets += 1
+    msg = None
+    if (self.expected is None) or (seq == 0):
+      if self.expected is not None:
+        msg = 'robot restarted (sequence reset)'
+    elif seq > self.expected:
+      self.lost += seq - self.expected
+      msg = 'lost %d datagram(s) (seq %d..%d)' % (seq - self.expected, self.expected, seq - 1)
+    elif seq < self.expected:
+      self.reordered += 1
+      return 'late datagram (seq %d)' % seq
+    self.expected = seq + 1
+    return msg
+
+  def summary(self):
+    return 'datagrams=%d lost=%d late=%d' % (self.packets, self.lost, self.reordered)
+
+
+def read_capture(path):
+  with open(path, 'rb') as f:
+    while True:
+      hdr = f.read(CAPTURE.size)
+      if len(hdr) < CAPTURE.size:
+        return
+      hosttime, seq, millis, length = CAPTURE.unpack(hdr)
+      yield hosttime, seq, millis, f.read(length)
+
+
+def receive():
+  addr = (host, port)
+  UDPSock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  UDPSock.bind(addr)
+  UDPSock.settimeout(0.5)
+  filename = time.strftime('capture-%Y%m%d-%H%M%S.bin')
+  capture = open(filename, 'wb')
+  print("waiting for messages (port: " + str(port) + ", capture: " + filename + ") ...")
+  try:
+    while True:
+      try:
+        (data, addr) = UDPSock.recvfrom(bufsize)
+      except socket.timeout:
+        continue
+      if (len(data) < HEADER.size) or (data[:2] != b'SR'):
+        continue
+      magic, seq, millis = HEADER.unpack_from(data)
+      payload = data[HEADER.size:]
+      capture.write(CAPTURE.pack(time.time(), seq, millis, len(payload)) + payload)
+      capture.flush()
+      yield seq, millis, payload
+  finally:
+    UDPSock.close()
+    capture.close()
+
+
+def main():
+  decoder = LogDecoder(load_messages())
+  reassembler = Reassembler()
+  if len(sys.argv) > 1:
+    source = ((seq, millis, payload) for hosttime, seq, millis, payload in read_capture(sys.argv[1]))
+  else:
+    source = receive()
+  try:
+    for seq, millis, payload in source:
+      msg = reassembler.check(seq)
+      if msg is not None:
+        decoder.reset()
+        print('\n--- %s ---' % msg, flush=True)
+      for timestamp, text in decoder.feed(payload):
+        print(format_line(timestamp, text), end='', flush=True)
+  except KeyboardInterrupt:
+    print ("terminating ...")
+  print(reassembler.summary() + ' records=%d errors=%d' % (decoder.records, decoder.errors))
+
+
+if __name__ == '__main__':
+  main()
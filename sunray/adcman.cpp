@@ -0,0 +1,88 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "adcman.h"
+#include "config.h"
+
+
+#define ADC_BUFFER_SIZE ADC_BUFFER_SAMPLES
+
+ADCManager ADCMan;
+
+volatile uint16_t adcBuffer[2][ADC_BUFFER_SIZE];   // PDC double buffer
+volatile int adcBufferIdx = 0;                     // buffer currently filled by PDC 
+volatile uint16_t adcBufferCount = 0;              // samples per buffer 
+volatile uint16_t adcValue[ADC_CHANNELS];          // averaged value per channel (12 bit)
+
+
+// PDC buffer full: average samples per channel and queue buffer again
+void ADC_Handler(){
+  if ((ADC->ADC_ISR & ADC_ISR_ENDRX) == 0) return;
+  // PDC has switched to the next buffer, so this buffer is ours until we queue it again
+  volatile uint16_t *buf = adcBuffer[adcBufferIdx];
+  uint32_t sum[ADC_CHANNELS];
+  uint16_t count[ADC_CHANNELS];
+  for (int i=0; i < ADC_CHANNELS; i++){
+    sum[i] = 0;
+    count[i] = 0;
+  }
+  for (int i=0; i < adcBufferCount; i++){
+    uint16_t v = buf[i];
+    int ch = v >> 12;          // channel tag
+    sum[ch] += (v & 0x0FFF);
+    count[ch]++;
+  }
+  for (int i=0; i < ADC_CHANNELS; i++){
+    if (count[i] > 0) adcValue[i] = sum[i] / count[i];
+  }
+  ADC->ADC_RNPR = (uint32_t)(uintptr_t)buf;
+  ADC->ADC_RNCR = adcBufferCount;
+  adcBufferIdx ^= 1;
+  ADCMan.conversions++;
+}
+
+
+void ADCManager::begin(){
+  conversions = 0;
+  for (int i=0; i < ADC_CHANNELS; i++) adcValue[i] = 0;
+  pmc_enable_periph_clk(ID_ADC);
+  ADC->ADC_CR = ADC_CR_SWRST;
+  ADC->ADC_CHDR = 0xFFFF;
+  // ADC clock MCK/((PRESCAL+1)*2) = 1.05 MHz (SAM3X: 1..20 MHz) with longest tracking time (16 clocks, ~15 us)
+  // for the high source impedance of the PCB dividers: tracking + conversion + transfer ~45 clocks = ~43 us 
+  // per sample, i.e. ~260 us per scan of 6 channels
+  ADC->ADC_MR = ADC_MR_FREERUN_ON | ADC_MR_PRESCAL(39) | ADC_MR_STARTUP_SUT64 
+              | ADC_MR_TRACKTIM(15) | ADC_MR_SETTLING_AST17 | ADC_MR_TRANSFER(3);
+  ADC->ADC_EMR = ADC_EMR_TAG;  // channel number in the upper 4 bits of each sample 
+  ADC->ADC_IDR = 0xFFFFFFFF;
+  ADC->ADC_PTCR = ADC_PTCR_RXTDIS;
+  adcBufferIdx = 0;
+  adcBufferCount = ADC_BUFFER_SIZE;
+  ADC->ADC_RPR = (uint32_t)(uintptr_t)adcBuffer[0];
+  ADC->ADC_RCR = adcBufferCount;
+  ADC->ADC_RNPR = (uint32_t)(uintptr_t)adcBuffer[1];
+  ADC->ADC_RNCR = adcBufferCount;
+  ADC->ADC_IER = ADC_IER_ENDRX;
+  NVIC_EnableIRQ(ADC_IRQn);
+  ADC->ADC_PTCR = ADC_PTCR_RXTEN;
+}
+
+void ADCManager::setCapture(int pin){
+  int ch = g_APinDescription[pin].ulADCChannelNumber;
+  if ((ch < 0) || (ch >= ADC_CHANNELS)) return;
+  if ((ADC->ADC_CHSR & (1 << ch)) != 0) return;
+  ADC->ADC_CHER = (1 << ch);
+  ADC->ADC_CR = ADC_CR_START;   // (re-)start free-running conversions
+}
+
+int ADCManager::readRaw(int pin){
+  int ch = g_APinDescription[pin].ulADCChannelNumber;
+  if ((ch < 0) || (ch >= ADC_CHANNELS)) return 0;
+  return adcValue[ch];
+}
+
+float ADCManager::read(int pin){
+  return ((float)readRaw(pin)) / 4.0;    
+}
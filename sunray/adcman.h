@@ -0,0 +1,41 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  ADC manager - background sampling of analog pins (Arduino Due)
+  
+  The SAM3X ADC runs in free-running mode and scans all captured channels, the conversion results
+  (tagged with their channel number) are transferred by the PDC (DMA) into a double buffer. 
+  Each time a buffer is full, the samples are averaged per channel (interrupt), and a new buffer
+  is queued. Reading a value is just a memory access (no blocking analogRead conversion).
+*/
+
+#ifndef ADCMAN_H
+#define ADCMAN_H
+
+#include <Arduino.h>
+
+#define ADC_CHANNELS 16      // SAM3X ADC channels
+#define ADC_BUFFER_SAMPLES 128   // samples per buffer - all captured channels interleaved, averaged per channel
+                                 // (6 channels: ~21 samples per channel, one buffer per ~5.5 ms)
+
+
+class ADCManager {
+  public:
+    // number of completed buffers (each buffer updates all captured channels)
+    volatile unsigned long conversions;
+    void begin();
+    // sample this analog pin in background
+    void setCapture(int pin);
+    // latest averaged value of pin (10 bit resolution like analogRead, but with fractional part)
+    float read(int pin);
+    // latest averaged value of pin (12 bit raw value)
+    int readRaw(int pin);
+};
+
+extern ADCManager ADCMan;
+
+
+#endif
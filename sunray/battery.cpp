@@ -9,9 +9,20 @@
 #include "motor.h"
 #include "robot.h"
 #include "buzzer.h"
+#include "adcman.h"
 #include <Arduino.h>
 
 
+#define MOW_COST_WINDOW 5.0   // mowing distance used to estimate charge per meter (m)
+
+// Li-Ion open-circuit cell voltage (V) to state of charge (0..1)
+const float cellVoltageCurve[][2] = { 
+  {3.00, 0.00}, {3.30, 0.05}, {3.50, 0.10}, {3.60, 0.20}, {3.70, 0.40}, 
+  {3.80, 0.55}, {3.90, 0.70}, {4.00, 0.82}, {4.10, 0.92}, {4.20, 1.00} 
+};
+const int cellVoltageCurveCount = sizeof(cellVoltageCurve) / sizeof(cellVoltageCurve[0]);
+
+
 void Battery::begin()
 {
   // keep battery switched ON
@@ -31,14 +42,26 @@ void Battery::begin()
   batFullCurrent  = 0.2;      // current flowing when battery is fully charged
   startChargingIfBelow = 28.0; // start charging if battery Voltage is below  
   batteryVoltage = 0;
+  batCells = BAT_CELLS;        // Li-Ion cells in series
+  batCapacity = BAT_CAPACITY;  // Ah
+  batIdleCurrent = 0.3;        // PCB, Arduino, GPS, WIFI etc. (A)
+  batReserve = 0.05;           // keep 5% capacity as reserve
+  stateOfCharge = 0;
+  socInitialized = false;
+  dischargeCurrent = 0;
+  mowAhPerMeter = 0;
+  mowSpeed = 0;
+  dockDistance = 0;
+  mowWindowTime = 0;
+  lastRunTime = millis();
 
   pinMode(pinChargeRelay, OUTPUT);
   pinMode(pinBatteryVoltage, INPUT);
   pinMode(pinChargeVoltage, INPUT);
   pinMode(pinChargeCurrent, INPUT);
-  pinMode(pinChargeCurrent, INPUT);
-  pinMode(pinBatteryVoltage, INPUT);
-  pinMode(pinChargeVoltage, INPUT);
+  ADCMan.setCapture(pinBatteryVoltage);
+  ADCMan.setCapture(pinChargeVoltage);
+  ADCMan.setCapture(pinChargeCurrent);
   
   enableCharging(false);
   allowSwitchOff(false);
@@ -48,8 +71,11 @@ void Battery::begin()
 
 void Battery::enableCharging(bool flag){
   if (chargingEnabled == flag) return;
-  DEBUG(F("enableCharging "));
-  DEBUGLN(flag);
+  if (binLog.enabled) binLog.log(LOG_CHARGING, flag);
+  else {
+    DEBUG(F("enableCharging "));
+    DEBUGLN(flag);
+  }
   chargingEnabled = flag;
   digitalWrite(pinChargeRelay, flag);      
 	nextPrintTime = 0;  	   	   	
@@ -60,8 +86,83 @@ bool Battery::chargerConnected(){
 }
   
 
+// go home if voltage too low, or if remaining charge is just enough to drive the path to the docking station
 bool Battery::shouldGoHome(){
-  return (batteryVoltage < batGoHomeIfBelow);
+  if (batteryVoltage < batGoHomeIfBelow) return true;
+  if ((!socInitialized) || (mowAhPerMeter <= 0)) return false;
+  return (remainingAh() < reserveAh());
+}
+
+// state of charge from cell voltage (linear interpolation in voltage curve)
+float Battery::voltageStateOfCharge(){
+  float v = batteryVoltage / ((float)batCells);
+  if (v <= cellVoltageCurve[0][0]) return 0;
+  for (int i=1; i < cellVoltageCurveCount; i++){
+    if (v < cellVoltageCurve[i][0]){
+      float w = (v - cellVoltageCurve[i-1][0]) / (cellVoltageCurve[i][0] - cellVoltageCurve[i-1][0]);
+      return cellVoltageCurve[i-1][1] + w * (cellVoltageCurve[i][1] - cellVoltageCurve[i-1][1]);
+    }
+  }
+  return 1.0;
+}
+
+// usable charge left (Ah)
+float Battery::remainingAh(){
+  return max(0, (stateOfCharge - batReserve) * batCapacity);
+}
+
+// charge required to drive home (Ah), with 50% safety margin
+float Battery::reserveAh(){
+  return dockDistance * mowAhPerMeter * 1.5;
+}
+
+float Battery::remainingMowMinutes(){
+  float ah = remainingAh() - reserveAh();
+  if (ah <= 0) return 0;
+  if ((mowAhPerMeter > 0) && (mowSpeed > 0)){
+    // recent mowing cost
+    return ah / mowAhPerMeter / mowSpeed / 60.0;
+  }
+  // no mowing cost yet, use current consumption
+  if (dischargeCurrent <= 0) return 0;
+  return ah / dischargeCurrent * 60.0;
+}
+
+// coulomb counting (motor currents, charge current) 
+void Battery::estimateStateOfCharge(float dt){
+  dischargeCurrent = batIdleCurrent + motor.motorLeftSense + motor.motorRightSense + motor.motorMowSense;
+  float current = -dischargeCurrent;
+  if ((chargerConnectedState) && (chargingEnabled)) current += chargingCurrent;
+  stateOfCharge += current * dt / 3600.0 / batCapacity;
+  stateOfCharge = min(1.0, max(0, stateOfCharge));
+}
+
+// charge used per mowing distance (over a sliding window of MOW_COST_WINDOW meters)
+void Battery::estimateMowCost(){
+  float charge = stateOfCharge * batCapacity;
+  if (stateOp != OP_MOW){
+    mowWindowTime = 0;
+    return;
+  }
+  if (mowWindowTime == 0){
+    mowWindowTime = millis();
+    mowWindowDistance = statMowDistanceTraveled;
+    mowWindowCharge = charge;
+    return;
+  }
+  float dist = statMowDistanceTraveled - mowWindowDistance;
+  if (dist < MOW_COST_WINDOW) return;
+  float ahPerMeter = (mowWindowCharge - charge) / dist;
+  float speed = dist / (((float)(millis() - mowWindowTime)) / 1000.0);
+  if (ahPerMeter > 0){
+    if (mowAhPerMeter <= 0) mowAhPerMeter = ahPerMeter;
+      else mowAhPerMeter = 0.7 * mowAhPerMeter + 0.3 * ahPerMeter;
+  }
+  if (mowSpeed <= 0) mowSpeed = speed;
+    else mowSpeed = 0.7 * mowSpeed + 0.3 * speed;
+  mowWindowTime = millis();
+  mowWindowDistance = statMowDistanceTraveled;
+  mowWindowCharge = charge;
 }
 
 bool Battery::underVoltage(){
@@ -79,11 +180,15 @@ void Battery::allowSwitchOff(bool flag){
 
 
 void Battery::run(){  
-  chargingVoltage = ((float)ADC2voltage(analogRead(pinChargeVoltage))) * batteryFactor;  
+  chargingVoltage = ((float)ADC2voltage(ADCMan.read(pinChargeVoltage))) * batteryFactor;  
   float w = 0.99;
   if (batteryVoltage < 5) w = 0;
-  batteryVoltage = w * batteryVoltage + (1-w) * ((float)ADC2voltage(analogRead(pinBatteryVoltage))) * batteryFactor;  
-  chargingCurrent = 0.9 * chargingCurrent + 0.1 * ((float)ADC2voltage(analogRead(pinChargeCurrent))) * currentFactor;    
+  batteryVoltage = w * batteryVoltage + (1-w) * ((float)ADC2voltage(ADCMan.read(pinBatteryVoltage))) * batteryFactor;  
+  chargingCurrent = 0.9 * chargingCurrent + 0.1 * ((float)ADC2voltage(ADCMan.read(pinChargeCurrent))) * currentFactor;    
+  
+  unsigned long now = millis();
+  estimateStateOfCharge( ((float)(now - lastRunTime)) / 1000.0 );
+  lastRunTime = now;
 		
   if (!chargerConnectedState){
 	  if (chargingVoltage > 5){
@@ -102,6 +207,16 @@ void Battery::run(){
       }
     }      		
     timeMinutes = (millis()-chargingStartTime) / 1000 /60;
+    if (batteryVoltage > 5){
+      if (!socInitialized){
+        socInitialized = true;
+        stateOfCharge = voltageStateOfCharge();
+      } else if ((!chargerConnectedState) && (dischargeCurrent < batIdleCurrent + 0.2)) {
+        // low load: battery voltage is near open-circuit voltage, correct coulomb counting drift
+        stateOfCharge = 0.95 * stateOfCharge + 0.05 * voltageStateOfCharge();
+      }
+    }
+    estimateMowCost();
     if (switchOffAllowed) {
       if (underVoltage()) {
         DEBUGLN(F("SWITCHING OFF (undervoltage)"));              
@@ -121,6 +236,7 @@ void Battery::run(){
           if (chargingCurrent < batFullCurrent) {        
             // stop charging
             enableCharging(false);
+            stateOfCharge = 1.0;
           }
         } else {
            //if (batteryVoltage < startChargingIfBelow) {
@@ -25,6 +25,16 @@ class Battery {
 	  float chargingCurrent;
     bool chargingEnabled;
 	  float ADCRef;
+    // state-of-charge estimation (coulomb counting, corrected by voltage curve)
+    int batCells;            // number of battery cells in series
+    float batCapacity;       // battery capacity (Ah)
+    float batIdleCurrent;    // current consumed by electronics (A)
+    float batReserve;        // capacity reserve (0..1) not to be used for mowing
+    float stateOfCharge;     // 0..1
+    float dischargeCurrent;  // current consumed (A)
+    float mowAhPerMeter;     // recent charge used per mowing distance (Ah/m)
+    float mowSpeed;          // recent mowing speed (m/s)
+    float dockDistance;      // path length from robot to docking station (m) - set by robot
     void begin();            
     void run();	  
 	  bool chargerConnected();
@@ -33,8 +43,20 @@ class Battery {
     bool shouldGoHome();    
     bool underVoltage();
     void resetIdle();
+    // predicted remaining mowing time (minutes) until robot has to go home
+    float remainingMowMinutes();
   protected:           
     unsigned long timeMinutes;
+    bool socInitialized;
+    unsigned long lastRunTime;
+    float mowWindowDistance;   // distance at start of mowing cost window (m)
+    float mowWindowCharge;     // charge at start of mowing cost window (Ah)
+    unsigned long mowWindowTime;
+    float voltageStateOfCharge();
+    float remainingAh();
+    float reserveAh();
+    void estimateStateOfCharge(float dt);
+    void estimateMowCost();
 		bool chargerConnectedState;
     bool switchOffAllowed;
     unsigned long switchOffTime;
@@ -0,0 +1,127 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "binlog.h"
+#include "config.h"
+
+
+#define BINLOG_BUFFER_SIZE    2048    // ring buffer (power of 2)
+#define BINLOG_MAX_RECORD     128     // max. record size (bytes)
+#define BINLOG_DRAIN_BUDGET   128     // max. bytes written to CONSOLE per run (at least one record)
+#define BINLOG_HEADER         7       // sync, id, length, timestamp
+
+static uint8_t logBuffer[BINLOG_BUFFER_SIZE];
+
+#define LOG_MSG(id, level, types, format) level,
+static const uint8_t logLevels[LOG_COUNT] = { LOG_MESSAGES };
+#undef LOG_MSG
+
+BinLog binLog;
+
+
+void BinLog::begin(){
+  enabled = BINARY_LOG;
+  level = LOG_INFO;
+  head = 0;
+  tail = 0;
+  dropped = 0;
+  droppedPending = 0;
+}
+
+void BinLog::put(const void *data, int len){
+  const uint8_t *p = (const uint8_t*)data;
+  for (int i=0; i < len; i++){
+    logBuffer[writeIdx] = p[i];
+    writeIdx = (writeIdx + 1) & (BINLOG_BUFFER_SIZE-1);
+  }
+}
+
+// reserve space for a record (false: level filtered or buffer full)
+bool BinLog::start(LogId id){
+  if ((!enabled) || (logLevels[id] > level)) return false;
+  unsigned int used = (head - tail) & (BINLOG_BUFFER_SIZE-1);
+  if (BINLOG_BUFFER_SIZE - 1 - used < 2 * BINLOG_MAX_RECORD){
+    dropped++;
+    droppedPending++;
+    return false;
+  }
+  if (droppedPending > 0){
+    // report dropped records first
+    unsigned long count = droppedPending;
+    droppedPending = 0;
+    if (start(LOG_DROPPED)){   // not written if WARN is filtered by log level
+      add(count);
+      end();
+    }
+  }
+  recordIdx = head;
+  writeIdx = head;
+  uint8_t hdr[3] = { BINLOG_SYNC, (uint8_t)id, 0 };
+  put(hdr, 3);
+  unsigned long timestamp = millis();
+  put(&timestamp, 4);
+  return true;
+}
+
+void BinLog::add(float v){
+  put(&v, 4);
+}
+
+void BinLog::add(double v){
+  put(&v, 8);
+}
+
+void BinLog::add(int v){
+  int32_t i = v;
+  put(&i, 4);
+}
+
+void BinLog::add(long v){
+  int32_t i = v;
+  put(&i, 4);
+}
+
+void BinLog::add(unsigned int v){
+  uint32_t u = v;
+  put(&u, 4);
+}
+
+void BinLog::add(unsigned long v){
+  uint32_t u = v;
+  put(&u, 4);
+}
+
+void BinLog::add(uint8_t v){
+  put(&v, 1);
+}
+
+void BinLog::add(bool v){
+  uint8_t b = v;
+  put(&b, 1);
+}
+
+// fill in length and checksum, publish record
+void BinLog::end(){
+  unsigned int len = ((writeIdx - recordIdx) & (BINLOG_BUFFER_SIZE-1)) - BINLOG_HEADER;
+  logBuffer[(recordIdx + 2) & (BINLOG_BUFFER_SIZE-1)] = len;
+  uint8_t checksum = 0;
+  for (unsigned int i=1; i < BINLOG_HEADER + len; i++) checksum ^= logBuffer[(recordIdx + i) & (BINLOG_BUFFER_SIZE-1)];
+  put(&checksum, 1);
+  head = writeIdx;
+}
+
+// write complete records only (CONSOLE text is not interleaved into a record)
+void BinLog::run(){
+  int budget = BINLOG_DRAIN_BUDGET;
+  while (tail != head){
+    unsigned int len = BINLOG_HEADER + logBuffer[(tail + 2) & (BINLOG_BUFFER_SIZE-1)] + 1;
+    if ((int)len > budget) break;
+    budget -= len;
+    unsigned int first = min(len, BINLOG_BUFFER_SIZE - tail);
+    CONSOLE.write(&logBuffer[tail], first);
+    if (first < len) CONSOLE.write(&logBuffer[0], len - first);
+    tail = (tail + len) & (BINLOG_BUFFER_SIZE-1);
+  }
+}
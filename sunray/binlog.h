@@ -0,0 +1,87 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  deferred-format binary logging (BINARY_LOG):
+    a log call only copies message id, timestamp and the raw arguments into a ring buffer, run() 
+    drains complete records to CONSOLE with a byte budget per loop - text formatting is done by 
+    the host decoder (logger/logdecode.py), which reads the message table below from this file
+
+  record: 0xA5, id, argument bytes, timestamp (ms, uint32), arguments, checksum (xor of id..arguments)
+  (all little endian, CONSOLE text between records is passed through by the decoder)
+*/
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <Arduino.h>
+
+#define BINLOG_SYNC 0xA5
+
+// log levels
+#define LOG_ERROR   0
+#define LOG_WARN    1
+#define LOG_INFO    2
+#define LOG_DEBUG   3
+
+// message table: id, level, argument types (f: float, d: double, i: int32, u: uint32, b: uint8), format
+// (keep one message per line - parsed by logger/logdecode.py)
+#define LOG_MESSAGES \
+  LOG_MSG(LOG_DROPPED,      LOG_WARN,  "u", "log: %u records dropped") \
+  LOG_MSG(LOG_STATUS,       LOG_INFO,  "fufbifffffffffffuddfffbf", "ctlDur=%.3f  ctlUs=%u  xtRms=%.3f  op=%u  freem=%d volt=%.2f soc=%.0f mowMin=%.0f mowRpm=%.0f mowLoad=%.2f spdFactor=%.2f tg=%.2f,%.2f x=%.2f y=%.2f delta=%.2f  tow=%u\tlon=%.8f\tlat=%.8f\tn=%.2f\te=%.2f\td=%.2f\tsol=%u\tage=%.2f") \
+  LOG_MSG(LOG_IMU_TIMEOUT,  LOG_ERROR, "u", "ERROR IMU timeout: %u") \
+  LOG_MSG(LOG_IMU_TILT,     LOG_ERROR, "fffff", "ERROR IMU tilt\nimu ypr=%.2f,%.2f,%.2f rollChange=%.2f pitchChange=%.2f") \
+  LOG_MSG(LOG_CHARGING,     LOG_DEBUG, "b", "enableCharging %u") \
+  LOG_MSG(LOG_GPS_CONFIG,   LOG_INFO,  "ii", "GPS config: changed=%d errors=%d") \
+  LOG_MSG(LOG_OPERATION,    LOG_INFO,  "b", "setOperation op=%u")
+
+#define LOG_MSG(id, level, types, format) id,
+enum LogId { LOG_MESSAGES LOG_COUNT };
+#undef LOG_MSG
+typedef enum LogId LogId;
+
+
+class BinLog {
+  public:
+    bool enabled;
+    int level;                // records above this level are skipped
+    unsigned long dropped;    // records dropped (buffer full), total
+    void begin();
+    // drain buffered records to CONSOLE (byte budget per call)
+    void run();
+    // record with arguments (types must match message table)
+    template<typename... Args> void log(LogId id, Args... args){
+      if (!start(id)) return;
+      addArgs(args...);
+      end();
+    }
+    bool start(LogId id);
+    void add(float v);
+    void add(double v);
+    void add(int v);
+    void add(long v);
+    void add(unsigned int v);
+    void add(unsigned long v);
+    void add(uint8_t v);
+    void add(bool v);
+    void end();
+  protected:
+    volatile unsigned int head;   // write index (published at end of record)
+    volatile unsigned int tail;   // read index
+    unsigned int recordIdx;       // record being written
+    unsigned int writeIdx;
+    unsigned long droppedPending; // dropped records not yet reported
+    void addArgs() {}
+    template<typename T, typename... Args> void addArgs(T v, Args... args){
+      add(v);
+      addArgs(args...);
+    }
+    void put(const void *data, int len);
+};
+
+extern BinLog binLog;
+
+
+#endif
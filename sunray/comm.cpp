@@ -105,6 +105,29 @@ void cmdMotorTest(){
   motor.test();  
 }
 
+// select line tracking controller (AT+L,type  0: Stanley, 1: pure pursuit, 2: MPC)
+void cmdLineController(){
+  if (cmd.length() > 5) lineTracker.setType(cmd.substring(5).toInt());
+  CONSOLE.print("line controller: ");
+  CONSOLE.println(lineTracker.typeName());
+  String s = F("L,");
+  s += lineTracker.type;
+  cmdAnswer(s);
+}
+
+// motor speed control tuning (AT+U: tune, AT+U,0: reset to default PID)
+void cmdMotorTune(){
+  if ((cmd.length() > 5) && (cmd[5] == '0')) {
+    motor.resetTuning();
+    motor.saveTuning();
+  } else {
+    motor.autoTune();
+  }
+  String s = F("U,");
+  s += motor.feedForward;
+  cmdAnswer(s);
+}
+
 
 // request waypoint
 void cmdWaypoint(){
@@ -147,6 +170,7 @@ void cmdWaypoint(){
   CONSOLE.print(x);
   CONSOLE.print(",");
   CONSOLE.println(y);*/  
+  mapValidator.request();
   if (success){    
     String s = F("W,");
     s += widx;              
@@ -154,6 +178,95 @@ void cmdWaypoint(){
   }  
 }
 
+// timetable entry: AT+K,idx,days,startMinute,endMinute,zone (days: bit 0 monday ... bit 6 sunday, 0: unused)
+// (startMinute > endMinute: overnight window, ends on the next day)
+// query entry: AT+K,idx
+void cmdTimetable(){
+  if (cmd.length()<6) return;
+  int counter = 0;
+  int lastCommaIdx = 0;
+  int values[6];
+  for (int idx=0; idx < cmd.length(); idx++){
+    char ch = cmd[idx];
+    if ((ch == ',') || (idx == cmd.length()-1)){
+      if ((counter >= 1) && (counter <= 5)) values[counter] = cmd.substring(lastCommaIdx+1, idx+1).toInt();
+      counter++;
+      lastCommaIdx = idx;
+    }
+  }
+  int widx = values[1];
+  if (counter >= 6){
+    if (!timetable.setEntry(widx, values[2], values[3], values[4], values[5])) {
+      CONSOLE.println("invalid timetable entry");
+      return;
+    }
+  } else if ((widx < 0) || (widx >= TIMETABLE_ENTRIES)) return;
+  const timetable_entry_t &e = timetable.entries[widx];
+  String s = F("K,");
+  s += widx;
+  s += ",";
+  s += e.days;
+  s += ",";
+  s += e.startMinute;
+  s += ",";
+  s += e.endMinute;
+  s += ",";
+  s += e.zone;
+  cmdAnswer(s);
+}
+
+// set RTC: AT+R,year,month,day,weekday,hour,minute,second (weekday: 0 monday ... 6 sunday)
+// read RTC: AT+R
+void cmdClock(){
+  if (cmd.length() > 5){
+    int counter = 0;
+    int lastCommaIdx = 0;
+    int values[8];
+    for (int idx=0; idx < cmd.length(); idx++){
+      char ch = cmd[idx];
+      if ((ch == ',') || (idx == cmd.length()-1)){
+        if ((counter >= 1) && (counter <= 7)) values[counter] = cmd.substring(lastCommaIdx+1, idx+1).toInt();
+        counter++;
+        lastCommaIdx = idx;
+      }
+    }
+    if (counter < 8) return;
+    datetime_t dt;
+    dt.year = values[1];
+    dt.month = values[2];
+    dt.day = values[3];
+    dt.weekday = values[4] % 7;
+    dt.hour = values[5];
+    dt.minute = values[6];
+    dt.second = values[7];
+    if (!timetable.setDateTime(dt)) {
+      CONSOLE.println("RTC not found");
+      return;
+    }
+  }
+  datetime_t dt;
+  timetable.getDateTime(dt);
+  String s = F("R,");
+  s += dt.year;
+  s += ",";
+  s += dt.month;
+  s += ",";
+  s += dt.day;
+  s += ",";
+  s += dt.weekday;
+  s += ",";
+  s += dt.hour;
+  s += ",";
+  s += dt.minute;
+  s += ",";
+  s += dt.second;
+  s += ",";
+  s += timetable.raining;
+  s += ",";
+  s += timetable.activeEntry;
+  cmdAnswer(s);
+}
+
 
 // request waypoints count
 void cmdWayCount(){
@@ -182,6 +295,7 @@ void cmdWayCount(){
       lastCommaIdx = idx;
     }    
   }        
+  mapValidator.request();
   String s = F("N");    
   cmdAnswer(s);         
   maps.dump();
@@ -212,12 +326,122 @@ void cmdExclusionCount(){
       lastCommaIdx = idx;
     }    
   }        
+  mapValidator.request();
   String s = F("X,");
   s += widx;              
   cmdAnswer(s);         
 }
 
 
+// zone section table: AT+Z,idx,perimeterCount,exclusionCount,transitCount,mowCount,name
+// (after points, counts and exclusions are transferred)
+void cmdZone(){
+  if (cmd.length()<6) return;
+  int counter = 0;
+  int lastCommaIdx = 0;
+  int values[6];
+  String name = "";
+  for (int idx=0; idx < cmd.length(); idx++){
+    char ch = cmd[idx];
+    if ((ch == ',') || (idx == cmd.length()-1)){
+      if ((counter >= 1) && (counter <= 5)) values[counter] = cmd.substring(lastCommaIdx+1, idx+1).toInt();
+      if (counter == 6) name = cmd.substring(lastCommaIdx+1, (ch == ',') ? idx : idx+1);
+      counter++;
+      lastCommaIdx = idx;
+    }
+  }
+  if (counter < 6) return;
+  if (!maps.setZone(values[1], values[2], values[3], values[4], values[5], name.c_str())) return;
+  mapValidator.request();
+  String s = F("Z,");
+  s += values[1];
+  cmdAnswer(s);
+}
+
+// select zone: AT+Y,idx,sequence (sequence=1: continue with next zones when zone is finished)
+void cmdSelectZone(){
+  if (cmd.length()>5){
+    int counter = 0;
+    int lastCommaIdx = 0;
+    for (int idx=0; idx < cmd.length(); idx++){
+      char ch = cmd[idx];
+      if ((ch == ',') || (idx == cmd.length()-1)){
+        int intValue = cmd.substring(lastCommaIdx+1, idx+1).toInt();
+        if (counter == 1){
+          if (!maps.selectZone(intValue)) return;
+        } else if (counter == 2){
+          maps.zoneSequence = (intValue != 0);
+        }
+        counter++;
+        lastCommaIdx = idx;
+      }
+    }
+  }
+  String s = F("Y,");
+  s += maps.zoneIdx;
+  s += ",";
+  s += maps.zoneCount;
+  s += ",";
+  s += maps.zoneSequence;
+  cmdAnswer(s);
+}
+
+// map validation result: A,issueCount,type,pointIndex,type,pointIndex,... (validates pending map transfer,
+// issueCount -1: not validated yet, robot is driving)
+void cmdMapValidation(){
+  if ((!mapValidator.validated) && (mapValidator.canValidate())) mapValidator.validate();
+  String s = F("A,");
+  if (!mapValidator.validated){
+    s += -1;
+    cmdAnswer(s);
+    return;
+  }
+  s += mapValidator.issueCount;
+  for (int i=0; i < min(mapValidator.issueCount, MAX_VALIDATION_ISSUES); i++){
+    s += ",";
+    s += mapValidator.issues[i].type;
+    s += ",";
+    s += mapValidator.issues[i].idx;
+  }
+  cmdAnswer(s);
+}
+
+// binary log level: AT+G,level (0: error, 1: warn, 2: info, 3: debug)
+void cmdLogLevel(){
+  if (cmd.length() > 5) binLog.level = cmd.substring(5).toInt();
+  String s = F("G,");
+  s += binLog.level;
+  s += ",";
+  s += binLog.dropped;
+  cmdAnswer(s);
+}
+
+// request UDP console statistics: D,packets,sendErrors,overflows (ENABLE_UDP)
+void cmdUdpStats(){
+  String s = F("D,");
+  s += udpSerial.packets;
+  s += ",";
+  s += udpSerial.sendErrors;
+  s += ",";
+  s += udpSerial.overflows;
+  cmdAnswer(s);
+}
+
+// request GPS receive statistics (PDC ring, UBX frames)
+void cmdGpsReceive(){
+  String s = F("I,");
+  s += gpsSerial.enabled;
+  s += ",";
+  s += gpsSerial.maxFill;
+  s += ",";
+  s += gpsSerial.overruns;
+  s += ",";
+  s += gpsSerial.frameErrors;
+  s += ",";
+  s += gps.droppedFrames;
+  cmdAnswer(s);
+}
+
 // request position mode
 void cmdPosMode(){
   if (cmd.length()<6) return;  
@@ -241,6 +465,7 @@ void cmdPosMode(){
       lastCommaIdx = idx;
     }    
   }        
+  updateAbsolutePosSource();
   CONSOLE.print("absolutePosSource=");
   CONSOLE.print(absolutePosSource);
   CONSOLE.print(" lon=");
@@ -289,6 +514,28 @@ void cmdSummary(){
   cmdAnswer(s);  
 }
 
+// request GPS signal quality (per constellation, see UBLOX::signalQuality)
+void cmdSignalQuality(){
+  String s = F("Q,");
+  s += gps.sigEpochs;
+  for (int gnssId=0; gnssId < UBX_GNSS_COUNT; gnssId++){
+    float signals;
+    float cno;
+    float resAvg;
+    float resMax;
+    gps.signalQuality(gnssId, signals, cno, resAvg, resMax);
+    s += ",";
+    s += signals;
+    s += ",";
+    s += cno;
+    s += ",";
+    s += resAvg;
+    s += ",";
+    s += resMax;
+  }
+  cmdAnswer(s);
+}
+
 // request statistics
 void cmdStats(){
   String s = F("T,");
@@ -359,6 +606,17 @@ void processCmd(bool checkCrc){
   if (cmd[3] == 'P') cmdPosMode();  
   if (cmd[3] == 'T') cmdStats();
   if (cmd[3] == 'E') cmdMotorTest();  
+  if (cmd[3] == 'Q') cmdSignalQuality();
+  if (cmd[3] == 'U') cmdMotorTune();
+  if (cmd[3] == 'L') cmdLineController();
+  if (cmd[3] == 'K') cmdTimetable();
+  if (cmd[3] == 'R') cmdClock();
+  if (cmd[3] == 'Z') cmdZone();
+  if (cmd[3] == 'Y') cmdSelectZone();
+  if (cmd[3] == 'A') cmdMapValidation();
+  if (cmd[3] == 'G') cmdLogLevel();
+  if (cmd[3] == 'I') cmdGpsReceive();
+  if (cmd[3] == 'D') cmdUdpStats();
 }
 
 // process console input
@@ -469,15 +727,40 @@ void processWifi()
 void outputConsole(){
   if (millis() > nextInfoTime){        
     nextInfoTime = millis() + 5000;               
+    if (binLog.enabled){
+      binLog.log(LOG_STATUS, (float)(1.0 / (controlLoops/5.0)), (unsigned long)(controlDuration / max(1, controlLoops)),
+        lineTracker.crossTrackRMS(), (uint8_t)stateOp, freeMemory(), battery.batteryVoltage, (float)(battery.stateOfCharge * 100.0),
+        battery.remainingMowMinutes(), motor.motorMowRpmCurr, motor.mowLoad, motor.mowSpeedFactor, 
+        maps.targetPoint.x, maps.targetPoint.y, stateX, stateY, stateDelta, gps.iTOW, gps.lon, gps.lat, 
+        gps.relPosN, gps.relPosE, gps.relPosD, (uint8_t)gps.solution, (float)((millis()-gps.dgpsAge)/1000.0));
+      controlLoops=0;
+      controlDuration=0;
+      return;
+    }
     CONSOLE.print ("ctlDur=");    
     CONSOLE.print (1.0 / (controlLoops/5.0));
+    CONSOLE.print ("  ctlUs=");    // average line tracking time per control cycle (us)
+    CONSOLE.print (controlDuration / max(1, controlLoops));
+    CONSOLE.print ("  xtRms=");    // cross-track error RMS (m)
+    CONSOLE.print (lineTracker.crossTrackRMS(), 3);
     controlLoops=0;
+    controlDuration=0;
     CONSOLE.print ("  op=");    
     CONSOLE.print (stateOp);
     CONSOLE.print ("  freem=");
     CONSOLE.print (freeMemory ());
     CONSOLE.print(" volt=");
     CONSOLE.print(battery.batteryVoltage);
+    CONSOLE.print(" soc=");
+    CONSOLE.print(battery.stateOfCharge * 100.0, 0);
+    CONSOLE.print(" mowMin=");
+    CONSOLE.print(battery.remainingMowMinutes(), 0);
+    CONSOLE.print(" mowRpm=");
+    CONSOLE.print(motor.motorMowRpmCurr, 0);
+    CONSOLE.print(" mowLoad=");
+    CONSOLE.print(motor.mowLoad);
+    CONSOLE.print(" spdFactor=");
+    CONSOLE.print(motor.mowSpeedFactor);
     CONSOLE.print(" tg=");
     CONSOLE.print(maps.targetPoint.x);
     CONSOLE.print(",");
@@ -74,6 +74,21 @@ Also, you may choose the serial port below for serial monitor output (CONSOLE).
 #define BLE Serial2
 #define GPS Serial3
 
+// ------ GPS receiver configuration ----------------------------
+// upload F9P configuration (ubloxcfg.h, generated from ublox_f9p_configs/*.txt with f9p_config.py) at startup?
+// only differing settings are written (RAM, BBR and flash) - the receiver keeps them, so this is opt-in
+// (receiver not answering at GPS_CONFIG_BAUDRATE, GPS_BAUDRATE or 38400: configuration is skipped)
+//#define GPS_CONFIG true
+#define GPS_CONFIG false
+#define GPS_CONFIG_BAUDRATE  GPS_BAUDRATE   // raise F9P UART1 baudrate to this value after configuration
+#define GPS_CONFIG_RATE_MS   0              // override navigation rate (ms), 0: use configuration file
+
+// receive GPS data by PDC (DMA) into a 4 KB ring buffer? (survives main loop stalls of ~180 ms at 115200 baud, 
+// Arduino serial buffer: 128 bytes ~11 ms) - receive statistics: AT+I
+#define GPS_DMA true
+//#define GPS_DMA false
+#define GPS_USART USART3    // USART of GPS port (Serial1: USART0, Serial2: USART1, Serial3: USART3)
+
 // ------ odometry -----------------------------------
 // values below are for Ardumower chassis and Ardumower motors
 // see Wiki on how to configure the odometry divider:
@@ -103,6 +118,16 @@ Also, you may choose the serial port below for serial monitor output (CONSOLE).
 #define MOW_TOGGLE_DIR       true
 //#define MOW_TOGGLE_DIR       false
 
+// mowing motor RPM sensor pulses per revolution (pinMotorMowRpm), 0: no sensor
+#define MOW_TICKS_PER_REVOLUTION  1
+
+// adapt ground speed to mowing load (mowing motor RPM drop and current)? 
+// (thick grass: smooth slowdown, sparse grass: faster than set speed)
+//#define ADAPTIVE_SPEED  true
+#define ADAPTIVE_SPEED  false
+// mowing motor current (amps) at the target mowing load (depends on mowing motor and blade)
+#define MOW_LOAD_CURRENT  1.0
+
 // should the motor overload detection be enabled?
 #define ENABLE_OVERLOAD_DETECTION  true
 //#define ENABLE_OVERLOAD_DETECTION  false
@@ -112,6 +137,12 @@ Also, you may choose the serial port below for serial monitor output (CONSOLE).
 //#define ENABLE_ERROR_DETECTION  false
 
 
+// ------ battery ---------------------------------------------------
+// battery pack (state of charge, reserve and remaining mowing time are computed from these)
+#define BAT_CELLS      7       // Li-Ion cells in series (7S: 29.4V full)
+#define BAT_CAPACITY   4.4     // capacity (Ah)
+
+
 // ------ WIFI module (ESP8266 ESP-01) --------------------------------
 // WARNING: WIFI is highly experimental - not for productive use (yet)
 // NOTE: all settings (maps, absolute position source etc.) are stored in your phone - when using another
@@ -136,6 +167,62 @@ Also, you may choose the serial port below for serial monitor output (CONSOLE).
 #define KIDNAP_DETECT true
 //#define KIDNAP_DETECT false
 
+// estimate odometry (wheel scales, wheel base) from GPS fix positions and store it (RTC module EEPROM)?
+//#define ODOMETRY_CALIBRATION true
+#define ODOMETRY_CALIBRATION false
+
+// detect slip, stall and obstacles within a few hundred ms (wheel speeds, GPS speed, IMU yaw rate, motor currents)?
+// (otherwise only: no GPS ground speed within 5 seconds of linear motion)
+//#define MOTION_DETECTION true
+#define MOTION_DETECTION false
+
+// mission manager: dock for charging when battery is low, continue mowing where it stopped when charged,
+// dock when all points are mowed?
+//#define MISSION_MANAGER true
+#define MISSION_MANAGER false
+
+// resume mowing (after charging, error) at the unmowed mowing point nearest to the robot instead of the last 
+// mowing point? (mowed points are skipped, the points left behind are mowed at the end)
+//#define NEAREST_RESUME true
+#define NEAREST_RESUME false
+
+// binary console log (status, errors): records are buffered and formatted on the PC by logger/logdecode.py 
+// (log level: AT+G,level)
+//#define BINARY_LOG true
+#define BINARY_LOG false
+
+// weekly mowing timetable (RTC module): start mowing in time windows, dock at window end?
+// (windows: AT+K, clock: AT+R)
+//#define TIMETABLE true
+#define TIMETABLE false
+
+// rain sensor connected to pinRain (with TIMETABLE)? rain stops any mowing (dock) and prevents mowing for 2 hours
+// sensor must pull pinRain to GND when wet (internal pull-up is enabled), without a sensor leave this off
+//#define RAIN_SENSOR true
+#define RAIN_SENSOR false
+
+// drive a detour around obstacles (sonar, motion stall) instead of stopping with an error?
+//#define OBSTACLE_AVOIDANCE true
+#define OBSTACLE_AVOIDANCE false
+
+// use fixed-point (CORDIC) instead of soft-float trigonometry in odometry and line tracking? (Due has no FPU)
+// not measured on the Due yet - enable only if the control cycle time (ctlUs, console) drops
+//#define FIXED_POINT_MATH true
+#define FIXED_POINT_MATH false
+
+// plan speed along waypoints (accelerate, brake for upcoming curves) instead of 0.1 m/s near each waypoint?
+//#define VELOCITY_PROFILE true
+#define VELOCITY_PROFILE false
+
+// line tracking controller (0: Stanley, 1: pure pursuit, 2: MPC) - can be changed at runtime (AT+L)
+#define LINE_CONTROLLER 0
+
+// replace corners between mowing lines by curvature-continuous curves (robot keeps moving through lane 
+// changes instead of turning on the spot)? corners up to SMOOTH_TRANSITION_MAX_ANGLE (degree) are smoothed
+//#define SMOOTH_TRANSITIONS true
+#define SMOOTH_TRANSITIONS false
+#define SMOOTH_TRANSITION_MAX_ANGLE 100
+
 // drive curves smoothly?
 //#define SMOOTH_CURVES  true
 #define SMOOTH_CURVES  false
@@ -0,0 +1,127 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "fixmath.h"
+
+
+#define CORDIC_ITERATIONS 16
+#define CORDIC_GAIN_Q30   652032874L    // 1/K = 0.607253 (Q2.30)
+
+// atan(2^-i) (Q16.16)
+static const fix_t cordicAngles[CORDIC_ITERATIONS] = {
+  51472, 30386, 16055, 8150, 4091, 2047, 1024, 512, 256, 128, 64, 32, 16, 8, 4, 2
+};
+
+
+fix_t fixScalePI(fix_t v){
+  if ((v < -FIX_PI) || (v > FIX_PI)){
+    v %= FIX_2PI;
+    if (v < -FIX_PI) v += FIX_2PI;
+      else if (v > FIX_PI) v -= FIX_2PI;
+  }
+  return v;
+}
+
+// bit-by-bit integer square root of v * 2^16
+fix_t fixSqrt(fix_t v){
+  if (v <= 0) return 0;
+  uint64_t num = ((uint64_t)v) << FIX_SHIFT;
+  uint64_t res = 0;
+  uint64_t bit = 1ULL << 46;
+  while (bit > num) bit >>= 2;
+  while (bit != 0){
+    if (num >= res + bit){
+      num -= res + bit;
+      res = (res >> 1) + bit;
+    } else res >>= 1;
+    bit >>= 2;
+  }
+  return (fix_t)res;
+}
+
+// CORDIC vectoring mode
+fix_t fixAtan2(fix_t y, fix_t x){
+  if ((x == 0) && (y == 0)) return 0;
+  // atan2 is scale invariant: normalize to use full resolution without overflow
+  int32_t ax = (x < 0) ? -x : x;
+  int32_t ay = (y < 0) ? -y : y;
+  int32_t m = (ax > ay) ? ax : ay;
+  while (m >= (1L << 29)) { x >>= 1; y >>= 1; m >>= 1; }
+  while (m < (1L << 28)) { x <<= 1; y <<= 1; m <<= 1; }
+  // rotate into right half plane
+  fix_t angle = 0;
+  if (x < 0){
+    int32_t t = x;
+    if (y >= 0) { x = y; y = -t; angle = FIX_PI_2; }
+      else { x = -y; y = t; angle = -FIX_PI_2; }
+  }
+  for (int i=0; i < CORDIC_ITERATIONS; i++){
+    int32_t xs = x >> i;
+    int32_t ys = y >> i;
+    if (y > 0){
+      x += ys; y -= xs; angle += cordicAngles[i];
+    } else {
+      x -= ys; y += xs; angle -= cordicAngles[i];
+    }
+  }
+  return fixScalePI(angle);
+}
+
+// CORDIC rotation mode
+void fixSinCos(fix_t angle, fix_t &s, fix_t &c){
+  angle = fixScalePI(angle);
+  // reduce to -PI/2..PI/2
+  bool negate = false;
+  if (angle > FIX_PI_2) { angle -= FIX_PI; negate = true; }
+    else if (angle < -FIX_PI_2) { angle += FIX_PI; negate = true; }
+  int32_t x = CORDIC_GAIN_Q30;
+  int32_t y = 0;
+  for (int i=0; i < CORDIC_ITERATIONS; i++){
+    int32_t xs = x >> i;
+    int32_t ys = y >> i;
+    if (angle >= 0){
+      x -= ys; y += xs; angle -= cordicAngles[i];
+    } else {
+      x += ys; y -= xs; angle += cordicAngles[i];
+    }
+  }
+  // Q2.30 -> Q16.16
+  c = (x + (1L << 13)) >> 14;
+  s = (y + (1L << 13)) >> 14;
+  if (negate) { c = -c; s = -s; }
+}
+
+float fixAtan2f(float y, float x){
+  // keep resolution for small vectors (fixAtan2 normalizes its input)
+  float m = max(fabs(x), fabs(y));
+  if (m < 1e-6) return 0;
+  float scale = 16384.0f / m;
+  return fixToFloat(fixAtan2((fix_t)(y * scale * 65536.0f), (fix_t)(x * scale * 65536.0f)) );
+}
+
+void fixSinCosf(float angle, float &s, float &c){
+  fix_t fs;
+  fix_t fc;
+  fixSinCos(floatToFix(angle), fs, fc);
+  s = fixToFloat(fs);
+  c = fixToFloat(fc);
+}
+
+// sqrt(v) = 16^k * sqrt(v / 256^k) - keeps large arguments (squared distances) inside Q16.16, 
+// small arguments are scaled up to keep their resolution
+float fixSqrtf(float v){
+  if (v <= 0) return 0;
+  float scale = 1;
+  if (v < 0.5f){
+    v *= 65536.0f;
+    scale = 1.0f / 256.0f;
+  }
+  while (v >= 16384.0f){
+    v *= 1.0f / 256.0f;
+    scale *= 16;
+  }
+  return fixToFloat(fixSqrt(floatToFix(v))) * scale;
+}
+
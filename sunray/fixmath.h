@@ -0,0 +1,59 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// Q16.16 fixed-point math (CORDIC atan2/sin/cos, integer sqrt) for the FPU-less Arduino Due
+// enable via FIXED_POINT_MATH (config.h)
+
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <Arduino.h>
+
+
+typedef int32_t fix_t;   // Q16.16
+
+#define FIX_SHIFT    16
+#define FIX_ONE      65536L
+#define FIX_PI       205887L     // PI
+#define FIX_2PI      411775L     // 2*PI
+#define FIX_PI_2     102944L     // PI/2
+#define FIX_MAX_FLOAT  32767.99f   // Q16.16 range (larger values are clamped)
+
+inline fix_t floatToFix(float v){
+  if (v >= FIX_MAX_FLOAT) return INT32_MAX;
+  if (v <= -FIX_MAX_FLOAT) return -INT32_MAX;
+  return (fix_t)(v * 65536.0f + ((v >= 0) ? 0.5f : -0.5f));
+}
+
+inline float fixToFloat(fix_t v){
+  return ((float)v) * (1.0f / 65536.0f);
+}
+
+inline fix_t fixMul(fix_t a, fix_t b){
+  return (fix_t)(((int64_t)a * b) >> FIX_SHIFT);
+}
+
+inline fix_t fixDiv(fix_t a, fix_t b){
+  if (b == 0) return (a >= 0) ? INT32_MAX : INT32_MIN;
+  return (fix_t)((((int64_t)a) << FIX_SHIFT) / b);
+}
+
+// scale angle to -PI..PI
+fix_t fixScalePI(fix_t v);
+// square root (v >= 0)
+fix_t fixSqrt(fix_t v);
+// atan2 (result -PI..PI)
+fix_t fixAtan2(fix_t y, fix_t x);
+// sine and cosine of angle (any range)
+void fixSinCos(fix_t angle, fix_t &s, fix_t &c);
+
+// float interface (conversion is cheap compared to soft-float trigonometry) 
+// fixSqrtf scales its argument into the Q16.16 range, fixSinCosf expects |angle| < 32768
+float fixAtan2f(float y, float x);
+void fixSinCosf(float angle, float &s, float &c);
+float fixSqrtf(float v);
+
+
+#endif
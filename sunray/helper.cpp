@@ -7,6 +7,7 @@
 #include <Arduino.h>
 #include "helper.h"
 #include "config.h"
+#include "fixmath.h"
 
 
 // Spannungsteiler Gesamtspannung ermitteln (Reihenschaltung R1-R2, U2 bekannt, U_GES zu ermitteln)
@@ -118,7 +119,11 @@ double rad2deg(double rad) {
 float pointsAngle(float x1, float y1, float x2, float y2){
   float dX = x2 - x1;
   float dY = y2 - y1;
-  float angle = scalePI(atan2(dY, dX));           
+  #if FIXED_POINT_MATH
+    float angle = fixAtan2f(dY, dX);    // already scaled to -PI..PI
+  #else
+    float angle = scalePI(atan2(dY, dX));           
+  #endif
   return angle;
 }
 
@@ -0,0 +1,151 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "linetracker.h"
+#include "config.h"
+#include "helper.h"
+#include "fixmath.h"
+
+
+#define STANLEY_K              0.5      // Stanley: lateral error gain
+#define STANLEY_K_SLOW         0.1      // Stanley: lateral error gain (slow tracking)
+#define PP_LOOKAHEAD_TIME      2.0      // pure pursuit: look-ahead distance per speed (s)
+#define PP_LOOKAHEAD_MIN       0.3      // pure pursuit: min. look-ahead distance (m)
+#define PP_LOOKAHEAD_MAX       1.5      // pure pursuit: max. look-ahead distance (m)
+#define MPC_SPEED_MIN          0.05     // MPC: gain table speed range (m/s)
+#define MPC_SPEED_MAX          1.0
+#define MPC_STEP               0.1      // MPC: prediction step (s)
+#define MPC_HORIZON            30       // MPC: prediction steps
+#define MPC_WEIGHT_ERROR       5.0      // MPC: cost of lateral error (per m^2)
+#define MPC_WEIGHT_HEADING     0.2      // MPC: cost of heading error (per rad^2)
+#define MPC_WEIGHT_ANGULAR     0.1      // MPC: cost of angular speed (per (rad/s)^2)
+#define RMS_MIN_SPEED          0.15     // cross-track RMS: min. speed (m/s), excludes approach, float and docking speed
+
+
+// ---- Stanley --------------------------------------------------------------------
+
+float StanleyController::angular(const track_t &t){
+  float k = (t.slow) ? STANLEY_K_SLOW : STANLEY_K;
+  #if FIXED_POINT_MATH
+    return t.targetError + fixAtan2f(k * t.lateralError, (0.001 + t.speed));
+  #else
+    return t.targetError + atan2(k * t.lateralError, (0.001 + t.speed));
+  #endif
+}
+
+
+// ---- pure pursuit ---------------------------------------------------------------
+
+float PurePursuitController::angular(const track_t &t){
+  float lookahead = max((float)PP_LOOKAHEAD_MIN, min((float)PP_LOOKAHEAD_MAX, PP_LOOKAHEAD_TIME * t.speed));
+  // goal point on line (not beyond target point), in line coordinates relative to robot
+  float along = max(0.05f, min(lookahead, t.targetDist));
+  float dist = sqrt( sq(along) + sq(t.lateralError) );
+  #if FIXED_POINT_MATH
+    float alpha = fixAtan2f(t.lateralError, along) + t.headingError;
+    float sinAlpha;
+    float cosAlpha;
+    fixSinCosf(alpha, sinAlpha, cosAlpha);
+  #else
+    float alpha = atan2(t.lateralError, along) + t.headingError;
+    float sinAlpha = sin(alpha);
+  #endif
+  // curvature of circle through goal point: 2 sin(alpha) / distance
+  return 2.0 * max(0.1f, t.speed) * sinAlpha / dist;
+}
+
+
+// ---- MPC ------------------------------------------------------------------------
+
+// model (x: lateral error, robot heading minus line heading):  x' = A x + B angular
+//   A = [1  -v*dt; 0  1],  B = [0; dt]
+// finite horizon Riccati recursion gives feedback gains K (angular = -K x) for first step
+void MPCController::begin(){
+  for (int i=0; i < MPC_SPEEDS; i++){
+    float v = MPC_SPEED_MIN + (MPC_SPEED_MAX - MPC_SPEED_MIN) * i / (MPC_SPEEDS-1);
+    float a = -v * MPC_STEP;
+    float b = MPC_STEP;
+    float P[2][2] = { {MPC_WEIGHT_ERROR, 0}, {0, MPC_WEIGHT_HEADING} };
+    float K[2] = {0, 0};
+    for (int n=0; n < MPC_HORIZON; n++){
+      // B'PA and B'PB
+      float bpa0 = b * P[1][0];
+      float bpa1 = b * (P[1][0] * a + P[1][1]);
+      float s = MPC_WEIGHT_ANGULAR + b * b * P[1][1];
+      K[0] = bpa0 / s;
+      K[1] = bpa1 / s;
+      // A'PA
+      float apa00 = P[0][0];
+      float apa01 = P[0][0] * a + P[0][1];
+      float apa11 = a * (P[0][0] * a + P[0][1]) + P[1][0] * a + P[1][1];
+      P[0][0] = MPC_WEIGHT_ERROR + apa00 - bpa0 * K[0];
+      P[0][1] = apa01 - bpa0 * K[1];
+      P[1][0] = P[0][1];
+      P[1][1] = MPC_WEIGHT_HEADING + apa11 - bpa1 * K[1];
+    }
+    gainError[i] = K[0];
+    gainHeading[i] = K[1];
+  }
+}
+
+float MPCController::angular(const track_t &t){
+  // interpolate gains for speed
+  float pos = (t.speed - MPC_SPEED_MIN) / (MPC_SPEED_MAX - MPC_SPEED_MIN) * (MPC_SPEEDS-1);
+  pos = max(0.0f, min((float)(MPC_SPEEDS-1), pos));
+  int i = min((int)pos, MPC_SPEEDS-2);
+  float w = pos - i;
+  float kError = gainError[i] + w * (gainError[i+1] - gainError[i]);
+  float kHeading = gainHeading[i] + w * (gainHeading[i+1] - gainHeading[i]);
+  return -(kError * t.lateralError - kHeading * t.headingError);
+}
+
+
+// ---- controller selection -------------------------------------------------------
+
+void LineTracker::begin(){
+  stanley.begin();
+  purePursuit.begin();
+  mpc.begin();
+  errorSqSum = 0;
+  errorCount = 0;
+  setType(LINE_CONTROLLER);
+}
+
+bool LineTracker::setType(int controllerType){
+  switch (controllerType){
+    case CTL_STANLEY: controller = &stanley; break;
+    case CTL_PURE_PURSUIT: controller = &purePursuit; break;
+    case CTL_MPC: controller = &mpc; break;
+    default: return false;
+  }
+  type = (ControllerType)controllerType;
+  errorSqSum = 0;
+  errorCount = 0;
+  return true;
+}
+
+const char *LineTracker::typeName(){
+  switch (type){
+    case CTL_PURE_PURSUIT: return "pure pursuit";
+    case CTL_MPC: return "MPC";
+    default: return "Stanley";
+  }
+}
+
+float LineTracker::angular(const track_t &t){
+  if ((!t.reverse) && (!t.slow) && (t.speed >= RMS_MIN_SPEED)){
+    errorSqSum += sq(t.lateralError);
+    errorCount++;
+  }
+  if (t.reverse) return stanley.angular(t);
+  return controller->angular(t);
+}
+
+float LineTracker::crossTrackRMS(){
+  float rms = (errorCount == 0) ? 0 : sqrt(errorSqSum / errorCount);
+  errorSqSum = 0;
+  errorCount = 0;
+  return rms;
+}
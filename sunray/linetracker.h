@@ -0,0 +1,89 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  lateral line tracking controllers (selectable at runtime, AT+L):
+    Stanley:       angular = target angle error + atan2(k * lateral error, speed)
+    pure pursuit:  steer on a circle to a point on the line ahead (look-ahead grows with speed)
+    MPC:           linear model (lateral error, heading error), finite horizon quadratic cost -
+                   without constraints the optimal first control is a state feedback, its gains are
+                   precomputed per speed at startup (Riccati recursion) and interpolated
+*/
+
+#ifndef LINETRACKER_H
+#define LINETRACKER_H
+
+#include <Arduino.h>
+
+#define MPC_SPEEDS 8   // MPC gain table entries (speeds)
+
+
+enum ControllerType {CTL_STANLEY, CTL_PURE_PURSUIT, CTL_MPC};
+typedef enum ControllerType ControllerType;
+
+#define CTL_COUNT 3
+
+
+// tracking situation (line: lastTargetPoint -> targetPoint)
+struct track_t {
+  float lateralError;   // signed distance to line (m), positive: right of line
+  float headingError;   // line heading minus robot heading (rad)
+  float targetError;    // target point angle minus robot heading (rad)
+  float targetDist;     // distance to target point along line (m)
+  float speed;          // linear speed (m/s), positive
+  bool slow;            // slow tracking (docking)
+  bool reverse;         // reverse tracking (docking) - always Stanley
+};
+
+typedef struct track_t track_t;
+
+
+class Controller {
+  public:
+    virtual void begin() {}
+    // angular speed (rad/s)
+    virtual float angular(const track_t &t) = 0;
+};
+
+class StanleyController : public Controller {
+  public:
+    float angular(const track_t &t);
+};
+
+class PurePursuitController : public Controller {
+  public:
+    float angular(const track_t &t);
+};
+
+class MPCController : public Controller {
+  public:
+    void begin();
+    float angular(const track_t &t);
+  protected:
+    float gainError[MPC_SPEEDS];    // feedback gains per speed
+    float gainHeading[MPC_SPEEDS];
+};
+
+
+class LineTracker {
+  public:
+    ControllerType type;
+    void begin();
+    bool setType(int controllerType);
+    const char *typeName();
+    float angular(const track_t &t);
+    // cross-track error RMS (m) of forward line tracking at mowing speed since last call
+    float crossTrackRMS();
+  protected:
+    StanleyController stanley;
+    PurePursuitController purePursuit;
+    MPCController mpc;
+    Controller *controller;
+    float errorSqSum;
+    unsigned long errorCount;
+};
+
+
+#endif
@@ -4,8 +4,7 @@
 // or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
 
 
-// TODO:  
-// + obstacle avoidance:
+// obstacle avoidance:
 //    https://wiki.ardumower.de/index.php?title=Ardumower_Sunray#How_the_obstacle_avoidance_works
 
 #include "map.h"
@@ -14,7 +13,33 @@
 #include "helper.h"
 
 
+#define OBSTACLE_RADIUS        0.15     // radius of a single obstacle trigger (m)
+#define OBSTACLE_MERGE_RADIUS  0.5      // merge triggers closer than this to an existing obstacle (m)
+#define OBSTACLE_MAX_RADIUS    1.5      // maximum radius of a merged obstacle (m)
+#define OBSTACLE_DECAY_TIME    600000   // forget obstacle if not triggered again within this time (ms)
+#define DETOUR_CLEARANCE       0.4      // distance kept between robot center and obstacle (m)
+#define DETOUR_BACKOFF         0.3      // reverse distance before driving detour (m)
+#define DETOUR_REJOIN          0.3      // distance behind obstacle to rejoin lane (m)
+#define DETOUR_MAX_ATTEMPTS    3        // maximum detour re-plans for the same lane
+#define PROFILE_DECEL          0.2      // velocity profile: braking deceleration (m/s^2)
+#define PROFILE_LAT_ACCEL      0.3      // velocity profile: max. lateral acceleration in curves (m/s^2)
+#define PROFILE_MAX_SPEED      1.0      // velocity profile: speed limit for straight lines (m/s)
+#define PROFILE_ACCEL          0.3      // velocity profile: max. acceleration (m/s^2)
+#define PROFILE_BRAKE          0.5      // velocity profile: max. deceleration (m/s^2), above PROFILE_DECEL so that
+                                        // jerk-limited braking catches up with the braking curve
+#define PROFILE_JERK           1.0      // velocity profile: max. jerk (m/s^3)
+#define PROFILE_MAX_DT         0.1      // velocity profile: max. time step (s), longer pauses restart the limiter
+#define TRANSITION_MIN_ANGLE   20.0     // lane transition: smaller turns are driven without curve (degree)
+#define TRANSITION_TANGENT     0.5      // lane transition: max. curve start distance before corner (m)
+#define TRANSITION_STEP_ANGLE  15.0     // lane transition: heading change between curve points (degree)
+#define TRANSITION_MIN_STEP    0.1      // lane transition: min. distance between curve points (m)
+#define TRANSITION_SUBSTEPS    4        // lane transition: integration steps per curve point
+
+
 void Map::begin(){
+  nearestResume = NEAREST_RESUME;
+  velocityProfile = VELOCITY_PROFILE;
+  smoothTransitions = SMOOTH_TRANSITIONS;
   wayMode = WAY_MOW;
   trackReverse = false;
   trackSlow = false;
@@ -31,6 +56,28 @@ void Map::begin(){
   freePointsCount = 0;
   storeIdx = 0;
   targetPointIdx = 0;
+  exclusionCount = 0;
+  mapPerimeterPointsCount = 0;
+  mapMowPointsCount = 0;
+  perimeterStartIdx = 0;
+  dockStartIdx = 0;
+  mowStartIdx = 0;
+  freeStartIdx = 0;
+  zoneSequence = true;
+  mowIndexExplicit = false;
+  mowIndex.clear();
+  clearZones();
+  segmentTargetIdx = -1;
+  profileStartIdx = -1;
+  profileCount = 0;
+  profileAccel = 0;
+  segmentEndSpeed = 0;
+  transitionActive = false;
+  transitionCornerIdx = -1;
+  resumePointValid = false;
+  detourPlanning = false;
+  detourActive = false;
+  clearObstacles();
   for (int i=0; i < MAX_POINTS; i++){
     points[i].x=0;
     points[i].y=0;
@@ -40,19 +87,33 @@ void Map::begin(){
 void Map::dump(){
   CONSOLE.println("map dump");
   CONSOLE.print("perimeter: ");
-  CONSOLE.println(perimeterPointsCount);
+  CONSOLE.println(mapPerimeterPointsCount);
   CONSOLE.print("exclusions: ");
   CONSOLE.println(exclusionPointsCount);  
   CONSOLE.print("dock: ");
   CONSOLE.println(dockPointsCount);
   CONSOLE.print("mow: ");  
-  CONSOLE.println(mowPointsCount);
+  CONSOLE.println(mapMowPointsCount);
   CONSOLE.print("first mow point:");
   CONSOLE.print(points[mowStartIdx].x);
   CONSOLE.print(",");
   CONSOLE.println(points[mowStartIdx].y);
   CONSOLE.print("free: ");
   CONSOLE.println(freePointsCount);
+  for (int i=0; i < zoneCount; i++){
+    CONSOLE.print("zone ");
+    CONSOLE.print(i);
+    CONSOLE.print(" ");
+    CONSOLE.print(zones[i].name);
+    CONSOLE.print(": perimeter=");
+    CONSOLE.print(zones[i].perimeterCount);
+    CONSOLE.print(" exclusions=");
+    CONSOLE.print(zones[i].exclusionCount);
+    CONSOLE.print(" transit=");
+    CONSOLE.print(zones[i].transitCount);
+    CONSOLE.print(" mow=");
+    CONSOLE.println(zones[i].mowCount);
+  }
 }
 
 // set point
@@ -65,6 +126,10 @@ bool Map::setPoint(int idx, float x, float y){
   points[idx].x = x;
   points[idx].y = y;
   storeIdx = idx;
+  mowIndex.clear();
+  profileStartIdx = -1;
+  transitionActive = false;
+  transitionCornerIdx = -1;
   return true;
 }
 
@@ -73,15 +138,16 @@ bool Map::setPoint(int idx, float x, float y){
 bool Map::setWayCount(WayType type, int count){
   switch (type){
     case WAY_PERIMETER:      
-      perimeterPointsCount = count;      
+      mapPerimeterPointsCount = count;      
       break;
     case WAY_EXCLUSION:      
       exclusionPointsCount = count;      
       break;
     case WAY_DOCK:    
       dockPointsCount = count;      
+      break;
     case WAY_MOW:      
-      mowPointsCount = count;            
+      mapMowPointsCount = count;            
       break;    
     case WAY_FREE:
       freePointsCount = count;
@@ -89,21 +155,23 @@ bool Map::setWayCount(WayType type, int count){
     default: 
       return false;       
   }
-  dockStartIdx = perimeterPointsCount + exclusionPointsCount;
-  mowStartIdx = dockStartIdx + dockPointsCount;
-  freeStartIdx = mowStartIdx + mowPointsCount;
+  dockStartIdx = mapPerimeterPointsCount + exclusionPointsCount;
+  freeStartIdx = dockStartIdx + dockPointsCount + mapMowPointsCount;
+  clearZones();
   targetPointIdx = mowStartIdx;
+  return true;
 }
 
 
 // set number exclusion points for exclusion
 bool Map::setExclusionLength(int idx, int len){
-  if (idx >= MAX_EXCLUSIONS) return false;
-  int prevStartIdx = perimeterPointsCount;
-  if (idx > 0) prevStartIdx = exclusionStartIdx[idx-1];          
+  if ((idx < 0) || (idx >= MAX_EXCLUSIONS)) return false;
+  int startIdx = mapPerimeterPointsCount;
+  if (idx > 0) startIdx = exclusionStartIdx[idx-1] + exclusionLength[idx-1];
   exclusionCount = idx + 1;
-  exclusionStartIdx[idx] = prevStartIdx + len;            
+  exclusionStartIdx[idx] = startIdx;            
   exclusionLength[idx] = len;
+  if (zoneIdx < 0) zoneExclusionCount = exclusionCount;
   //CONSOLE.print("exclusion ");
   //CONSOLE.print(idx);
   //CONSOLE.print(": ");
@@ -112,19 +180,351 @@ bool Map::setExclusionLength(int idx, int len){
 }
 
 
+
+// ---- zones -------------------------------------------------------------------------
+
+// no section table: the whole map is one zone
+void Map::clearZones(){
+  zoneCount = 0;
+  zoneIdx = -1;
+  perimeterStartIdx = 0;
+  perimeterPointsCount = mapPerimeterPointsCount;
+  zoneExclusionIdx = 0;
+  zoneExclusionCount = exclusionCount;
+  zoneExclusionPointIdx = mapPerimeterPointsCount;
+  mowStartIdx = dockStartIdx + dockPointsCount;
+  mowPointsCount = mapMowPointsCount;
+}
+
+// set zone (after point counts and exclusion lengths are set)
+bool Map::setZone(int idx, int perimeterCount, int exclusions, int transitCount, int mowCount, const char *name){
+  if ((idx < 0) || (idx >= MAX_ZONES) || (idx > zoneCount)) return false;
+  if ((perimeterCount < 0) || (exclusions < 0) || (transitCount < 0) || (mowCount < 0)) return false;
+  zone_t z;
+  if (idx == 0){
+    z.perimeterStartIdx = 0;
+    z.exclusionIdx = 0;
+    z.transitStartIdx = dockStartIdx + dockPointsCount;
+  } else {
+    zone_t &prev = zones[idx-1];
+    z.perimeterStartIdx = prev.perimeterStartIdx + prev.perimeterCount;
+    z.exclusionIdx = prev.exclusionIdx + prev.exclusionCount;
+    z.transitStartIdx = prev.mowStartIdx + prev.mowCount;
+  }
+  z.perimeterCount = perimeterCount;
+  z.exclusionCount = exclusions;
+  z.exclusionPointIdx = (z.exclusionIdx < exclusionCount) ? exclusionStartIdx[z.exclusionIdx] : dockStartIdx;
+  z.transitCount = transitCount;
+  z.mowStartIdx = z.transitStartIdx + transitCount;
+  z.mowCount = mowCount;
+  strncpy(z.name, name, ZONE_NAME_LEN-1);
+  z.name[ZONE_NAME_LEN-1] = 0;
+  // ranges must fit into uploaded blocks
+  if (z.perimeterStartIdx + perimeterCount > mapPerimeterPointsCount) return false;
+  if (z.exclusionIdx + exclusions > exclusionCount) return false;
+  if (z.mowStartIdx + mowCount > freeStartIdx) return false;
+  zones[idx] = z;
+  zoneCount = idx + 1;
+  if (idx == 0) {
+    zoneIdx = -1;
+    selectZone(0);
+  }
+  return true;
+}
+
+// switch zone by swapping the active ranges
+bool Map::selectZone(int idx){
+  if ((idx < 0) || (idx >= zoneCount)) return false;
+  if (idx == zoneIdx) return true;
+  zone_t &z = zones[idx];
+  zoneIdx = idx;
+  perimeterStartIdx = z.perimeterStartIdx;
+  perimeterPointsCount = z.perimeterCount;
+  zoneExclusionIdx = z.exclusionIdx;
+  zoneExclusionCount = z.exclusionCount;
+  zoneExclusionPointIdx = z.exclusionPointIdx;
+  mowStartIdx = z.mowStartIdx;
+  mowPointsCount = z.mowCount;
+  mowPointsIdx = 0;
+  if (wayMode == WAY_MOW) targetPointIdx = mowStartIdx;
+  profileStartIdx = -1;
+  transitionActive = false;
+  transitionCornerIdx = -1;
+  resumePointValid = false;
+  CONSOLE.print("zone ");
+  CONSOLE.print(idx);
+  CONSOLE.print(" ");
+  CONSOLE.println(z.name);
+  return true;
+}
+
+int Map::zoneAt(float x, float y){
+  for (int i=0; i < zoneCount; i++){
+    if ((zones[i].perimeterCount >= 3) && (isPointInsidePolygon(zones[i].perimeterStartIdx, zones[i].perimeterCount, x, y))) return i;
+  }
+  return -1;
+}
+
+// free points from zone to zone (-1: docking area) and finally to target: leave zone on its transit path 
+// (reversed), enter other zone on its transit path - returns number of free points
+int Map::transferPath(int fromZone, int toZone, pt_t target){
+  int count = 0;
+  if ((zoneCount > 0) && (fromZone != toZone)){
+    int len = 1;
+    if (fromZone >= 0) len += zones[fromZone].transitCount;
+    if (toZone >= 0) len += zones[toZone].transitCount;
+    if (freeStartIdx + len <= MAX_POINTS){
+      if (fromZone >= 0){
+        zone_t &z = zones[fromZone];
+        for (int i=z.transitCount-1; i >= 0; i--) points[freeStartIdx + count++] = points[z.transitStartIdx + i];
+      }
+      if (toZone >= 0){
+        zone_t &z = zones[toZone];
+        for (int i=0; i < z.transitCount; i++) points[freeStartIdx + count++] = points[z.transitStartIdx + i];
+      }
+    }
+  }
+  points[freeStartIdx + count++] = target;
+  freePointsCount = count;
+  freePointsIdx = 0;
+  return count;
+}
+
 // set desired progress in mowing points list
 // 1.0 = 100%
 void Map::setMowingPointPercent(float perc){
+  if ((nearestResume) && (updateMowIndex()) && (mowIndex.mowedCount > 0) && (fabs(perc * 100.0 - percentCompleted) < 1.0)) {
+    return;  // progress unchanged - resume at nearest unmowed point
+  }
   mowPointsIdx = (int)( ((float)mowPointsCount) * perc);
   if (mowPointsIdx >= mowPointsCount) {
     mowPointsIdx = mowPointsCount-1;
   }
   targetPointIdx = mowStartIdx + mowPointsIdx;
+  if (mowIndex.valid) {
+    mowIndex.setProgress(mowPointsIdx);
+    mowIndexExplicit = true;
+  }
+}
+
+// (re)build index if mowing points changed (upload, zone) - mowed: points before current mowing point
+bool Map::updateMowIndex(){
+  if ((mowIndex.valid) && (mowIndexStartIdx == mowStartIdx) && (mowIndex.count == mowPointsCount)) return true;
+  mowIndexStartIdx = mowStartIdx;
+  if (!mowIndex.build(&points[mowStartIdx], mowPointsCount)) return false;
+  mowIndex.setProgress(mowPointsIdx);
+  return true;
 }
 
 void Map::run(){
-  targetPoint = points[targetPointIdx];  
-  percentCompleted = (((float)mowPointsIdx) / ((float)mowPointsCount) * 100.0);
+  if (smoothTransitions) updateTransition();
+  if (transitionActive) targetPoint = transitionPoints[transitionPointIdx];
+    else targetPoint = points[targetPointIdx];  
+  if (mowIndex.valid) percentCompleted = (((float)mowIndex.mowedCount) / ((float)mowPointsCount) * 100.0);
+    else percentCompleted = (((float)mowPointsIdx) / ((float)mowPointsCount) * 100.0);
+  if ( (targetPointIdx != segmentTargetIdx) || (wayMode != segmentWayMode)
+      || (targetPoint.x != segmentEnd.x) || (targetPoint.y != segmentEnd.y)
+      || (lastTargetPoint.x != segmentStart.x) || (lastTargetPoint.y != segmentStart.y) ) {
+    updateSegment();
+  }
+  decayObstacles();
+}
+
+// compute geometry of current line once (the line tracker only needs cheap dot/cross products then)
+void Map::updateSegment(){
+  segmentTargetIdx = targetPointIdx;
+  segmentWayMode = wayMode;
+  segmentStart = lastTargetPoint;
+  segmentEnd = targetPoint;
+  float dX = targetPoint.x - lastTargetPoint.x;
+  float dY = targetPoint.y - lastTargetPoint.y;
+  segmentLength = sqrt( sq(dX) + sq(dY) );
+  segmentHeading = scalePI(atan2(dY, dX));
+  if (segmentLength < 0.01){
+    segmentDirX = 0;
+    segmentDirY = 0;
+  } else {
+    segmentDirX = dX / segmentLength;
+    segmentDirY = dY / segmentLength;
+  }
+  // turn angle to next line
+  segmentNextStraight = false;
+  if ((wayMode == WAY_MOW) && (mowPointsIdx+1 < mowPointsCount) && (segmentLength >= 0.01)) {
+    pt_t nextPt = points[mowStartIdx + mowPointsIdx+1];  
+    float nX = nextPt.x - targetPoint.x;
+    float nY = nextPt.y - targetPoint.y;
+    float nextLength = sqrt( sq(nX) + sq(nY) );
+    if (nextLength >= 0.01){
+      // cos(turn angle) = dot product of unit directions
+      float cosAngle = (segmentDirX * nX + segmentDirY * nY) / nextLength;
+      segmentNextStraight = (cosAngle > 0.9397);  // cos(20 degree)
+    }
+  }
+  if (velocityProfile) updateProfile();
+}
+
+// max. speed at mowing point (turn from line ending at point to next line)
+float Map::cornerSpeed(int mowIdx){
+  if (mowIdx <= 0 || mowIdx+1 >= mowPointsCount) return 0;   // first/last point: stop
+  pt_t prevPt = points[mowStartIdx + mowIdx-1];
+  pt_t pt = points[mowStartIdx + mowIdx];
+  pt_t nextPt = points[mowStartIdx + mowIdx+1];
+  float angle = fabs(distancePI(pointsAngle(prevPt.x, prevPt.y, pt.x, pt.y), pointsAngle(pt.x, pt.y, nextPt.x, nextPt.y)));
+  if ((smoothTransitions) && (angle > TRANSITION_MIN_ANGLE / 180.0 * PI) && (angle <= SMOOTH_TRANSITION_MAX_ANGLE / 180.0 * PI)){
+    // driven as transition curve: min. radius of curve with longest possible tangents
+    float tangent = min((float)TRANSITION_TANGENT, 0.5f * min(distance(prevPt.x, prevPt.y, pt.x, pt.y), distance(pt.x, pt.y, nextPt.x, nextPt.y)));
+    float length = tangent / transitionShape(angle, 0, NULL);
+    return min(PROFILE_MAX_SPEED, sqrt(PROFILE_LAT_ACCEL * length / (2.0 * angle)));
+  }
+  // sharp curves are turned on the spot (see angleToTargetFits in robot.cpp)
+  if (angle > ((SMOOTH_CURVES) ? 120.0 : 20.0) / 180.0 * PI) return 0;
+  if (angle < 0.01) return PROFILE_MAX_SPEED;
+  // curve radius when switching lines at target reached distance
+  float radius = ((SMOOTH_CURVES) ? 0.2 : 0.05) / tan(angle / 2);
+  return min(PROFILE_MAX_SPEED, sqrt(PROFILE_LAT_ACCEL * radius));
+}
+
+// look-ahead velocity profile: corner speeds of upcoming mowing points are cached (one new corner per
+// reached point), end speed of current line is computed backwards from the last cached corner
+// (assuming a stop there) with braking deceleration
+void Map::updateProfile(){
+  segmentEndSpeed = 0;
+  if (wayMode != WAY_MOW) {
+    profileCount = 0;
+    return;
+  }
+  if ((profileCount > 0) && (mowPointsIdx == profileStartIdx + 1)){
+    // next point reached - drop passed corner
+    for (int i=1; i < profileCount; i++){
+      profileLength[i-1] = profileLength[i];
+      profileCorner[i-1] = profileCorner[i];
+    }
+    profileCount--;
+    profileStartIdx++;
+  } else if (mowPointsIdx != profileStartIdx){
+    profileCount = 0;
+    profileStartIdx = mowPointsIdx;
+  }
+  while ((profileCount < PROFILE_LOOKAHEAD) && (profileStartIdx + profileCount < mowPointsCount)){
+    int idx = profileStartIdx + profileCount;
+    if (profileCount == 0) profileLength[0] = segmentLength;
+      else profileLength[profileCount] = distance(points[mowStartIdx + idx-1].x, points[mowStartIdx + idx-1].y, 
+                                              points[mowStartIdx + idx].x, points[mowStartIdx + idx].y);
+    profileCorner[profileCount] = cornerSpeed(idx);
+    profileCount++;
+  }
+  if (profileCount > 0) profileLength[0] = segmentLength;  // line may start at robot position (detour, resume)
+  float v = 0;
+  for (int i=profileCount-1; i >= 0; i--){
+    v = min(profileCorner[i], v);
+    segmentEndSpeed = v;
+    v = sqrt( sq(v) + 2.0 * PROFILE_DECEL * profileLength[i] );
+  }
+}
+
+float Map::profileSpeed(float targetDist){
+  return sqrt( sq(segmentEndSpeed) + 2.0 * PROFILE_DECEL * targetDist );
+}
+
+// acceleration and deceleration are limited by the jerk limit on both ends: the acceleration is also bounded 
+// by sqrt(2 * jerk * speed difference), so it can be ramped back to zero when the set speed is reached
+float Map::limitAcceleration(float lastSpeed, float speed, float dt){
+  if (dt <= 0) return lastSpeed;
+  if ((lastSpeed < 0.01) || (dt > PROFILE_MAX_DT)) profileAccel = 0;
+  dt = min(dt, (float)PROFILE_MAX_DT);
+  float diff = speed - lastSpeed;
+  float reachable = sqrt(2.0 * PROFILE_JERK * fabs(diff));
+  float accel = diff / dt;
+  accel = max(-min((float)PROFILE_BRAKE, reachable), min(accel, min((float)PROFILE_ACCEL, reachable)));
+  accel = max(profileAccel - PROFILE_JERK * dt, min(accel, profileAccel + PROFILE_JERK * dt));
+  profileAccel = accel;
+  return max(0.0f, lastSpeed + accel * dt);
+}
+
+
+// ---- lane transitions -------------------------------------------------------------
+
+// symmetric clothoid pair (curvature rises linearly, then falls: curvature-continuous to both lines)
+// with length 1 turning left by angle - returns tangent length (curve start to corner) and optionally 
+// the curve points (steps points, start point excluded) in start frame (x: start direction)
+float Map::transitionShape(float angle, int steps, pt_t *curve){
+  int n = (steps > 0) ? steps * TRANSITION_SUBSTEPS : 32;
+  float ds = 1.0 / n;
+  float maxCurvature = 2.0 * angle;
+  float x = 0;
+  float y = 0;
+  float heading = 0;
+  for (int i=0; i < n; i++){
+    float s = (i + 0.5) * ds;
+    float curvature = maxCurvature * ((s < 0.5) ? (2.0 * s) : (2.0 * (1.0 - s)));
+    float h = heading + 0.5 * curvature * ds;   // heading at step midpoint
+    x += cos(h) * ds;
+    y += sin(h) * ds;
+    heading += curvature * ds;
+    if ((curve != NULL) && ((i+1) % TRANSITION_SUBSTEPS == 0)){
+      curve->x = x;
+      curve->y = y;
+      curve++;
+    }
+  }
+  // intersection of end tangent with start line
+  return x - y * cos(angle) / sin(angle);
+}
+
+// curve replacing corner (start: previous point, end: next point), first point on incoming line
+bool Map::computeTransition(pt_t start, pt_t corner, pt_t end, float tangent){
+  float inDelta = pointsAngle(start.x, start.y, corner.x, corner.y);
+  float outDelta = pointsAngle(corner.x, corner.y, end.x, end.y);
+  float turn = distancePI(inDelta, outDelta);
+  float angle = fabs(turn);
+  float length = tangent / transitionShape(angle, 0, NULL);
+  int steps = ceil(angle / (TRANSITION_STEP_ANGLE / 180.0 * PI));
+  steps = max(2, min(MAX_TRANSITION_POINTS-1, min(steps, (int)(length / TRANSITION_MIN_STEP))));
+  transitionShape(angle, steps, &transitionPoints[1]);
+  float dirX = cos(inDelta);
+  float dirY = sin(inDelta);
+  float side = (turn > 0) ? 1 : -1;   // left or right turn
+  transitionPoints[0].x = corner.x - tangent * dirX;
+  transitionPoints[0].y = corner.y - tangent * dirY;
+  if (!isPointValid(transitionPoints[0].x, transitionPoints[0].y, -1)) return false;
+  for (int i=1; i <= steps; i++){
+    float cx = transitionPoints[i].x * length;
+    float cy = transitionPoints[i].y * length * side;
+    transitionPoints[i].x = transitionPoints[0].x + cx * dirX - cy * dirY;
+    transitionPoints[i].y = transitionPoints[0].y + cx * dirY + cy * dirX;
+    if (!isPointValid(transitionPoints[i].x, transitionPoints[i].y, -1)) return false;
+  }
+  transitionCount = steps + 1;
+  return true;
+}
+
+// lazily replace the corner at the current target mowing point by a curve (once per corner, when the
+// line to the corner starts) - curves leaving perimeter or touching exclusions/obstacles are shortened
+// and finally dropped (corner is turned on the spot)
+void Map::updateTransition(){
+  if ((wayMode != WAY_MOW) || (!shouldMow) || (detourActive) || (transitionActive)) return;
+  if (transitionCornerIdx == mowPointsIdx) return;
+  transitionCornerIdx = mowPointsIdx;
+  if (mowPointsIdx+1 >= mowPointsCount) return;
+  if (mowIndex.isMowed(mowPointsIdx+1)) return;  // next point is skipped
+  pt_t corner = points[mowStartIdx + mowPointsIdx];
+  pt_t end = points[mowStartIdx + mowPointsIdx+1];
+  float inLength = distance(lastTargetPoint.x, lastTargetPoint.y, corner.x, corner.y);
+  float outLength = distance(corner.x, corner.y, end.x, end.y);
+  if ((inLength < 0.01) || (outLength < 0.01)) return;
+  float angle = fabs(distancePI(pointsAngle(lastTargetPoint.x, lastTargetPoint.y, corner.x, corner.y),
+                                pointsAngle(corner.x, corner.y, end.x, end.y)));
+  if ((angle <= TRANSITION_MIN_ANGLE / 180.0 * PI) || (angle > SMOOTH_TRANSITION_MAX_ANGLE / 180.0 * PI)) return;
+  // incoming line is left over from the previous curve, outgoing line is shared with the next curve
+  float tangent = min((float)TRANSITION_TANGENT, min(inLength, 0.5f * outLength));
+  for (int attempt=0; attempt < 3; attempt++){
+    if (computeTransition(lastTargetPoint, corner, end, tangent)){
+      transitionPointIdx = 0;
+      transitionActive = true;
+      return;
+    }
+    tangent *= 0.5;
+  }
 }
 
 float Map::distanceToTargetPoint(float stateX, float stateY){  
@@ -141,17 +541,33 @@ float Map::distanceToLastTargetPoint(float stateX, float stateY){
   return targetDist;
 }
 
-// check if path from last target to target to next target is a curve
+// signed distance to line (https://en.wikipedia.org/wiki/Distance_from_a_point_to_a_line#Line_defined_by_two_points) 
+// as cross product with cached unit direction (0 for too short lines)
+float Map::distanceToTargetLine(float stateX, float stateY){
+  return segmentDirY * (stateX - lastTargetPoint.x) - segmentDirX * (stateY - lastTargetPoint.y);
+}
+
+// check if path from last target to target to next target is a curve (cached per line)
 bool Map::nextPointIsStraight(){
-  if (wayMode != WAY_MOW) return false;
-  if (mowPointsIdx+1 >= mowPointsCount) return false;     
-  pt_t nextPt = points[mowStartIdx + mowPointsIdx+1];  
-  float angleCurr = pointsAngle(lastTargetPoint.x, lastTargetPoint.y, targetPoint.x, targetPoint.y);
-  float angleNext = pointsAngle(targetPoint.x, targetPoint.y, nextPt.x, nextPt.y);
-  angleNext = scalePIangles(angleNext, angleCurr);                    
-  float diffDelta = distancePI(angleCurr, angleNext);                 
-  //CONSOLE.println(fabs(diffDelta)/PI*180.0);
-  return ((fabs(diffDelta)/PI*180.0) < 20);
+  return segmentNextStraight;
+}
+
+// the line to the first transition point (curve start) is tracked like any other line - the robot may 
+// still have to turn on the spot there (e.g. after a sharp corner or at mission start)
+bool Map::transitionCurveActive(){
+  return ((transitionActive) && (transitionPointIdx > 0));
+}
+
+float Map::distanceToDock(float stateX, float stateY){
+  if (dockPointsCount == 0) return 0;
+  pt_t pt = points[dockStartIdx];
+  float dist = distance(stateX, stateY, pt.x, pt.y);
+  for (int i=1; i < dockPointsCount; i++){
+    pt_t nextPt = points[dockStartIdx + i];
+    dist += distance(pt.x, pt.y, nextPt.x, nextPt.y);
+    pt = nextPt;
+  }
+  return dist;
 }
 
 void Map::setRobotStatePosToDockingPos(float &x, float &y, float &delta){
@@ -187,25 +603,66 @@ void Map::setIsDocked(bool flag){
   }  
 }
 
-void Map::startDocking(){
+void Map::startDocking(float stateX, float stateY){
   shouldDock = true;
   shouldMow = false;
+  detourPlanning = false;
+  detourActive = false;
+  transitionActive = false;
   if (dockPointsCount > 0){
     // TODO: find valid path to docking point  
-    freePointsCount = 1;
-    freePointsIdx = 0;
-    points[freeStartIdx] = points[dockStartIdx];
+    transferPath(zoneAt(stateX, stateY), -1, points[dockStartIdx]);
   }    
 }
 
-void Map::startMowing(){
+void Map::setResumePoint(float x, float y){
+  resumePoint.x = x;
+  resumePoint.y = y;
+  resumePointValid = true;
+}
+
+void Map::setResumeIndex(int mowIdx){
+  if ((mowIdx < 0) || (mowIdx >= mowPointsCount)) return;
+  mowPointsIdx = mowIdx;
+  if (wayMode == WAY_MOW) targetPointIdx = mowStartIdx + mowPointsIdx;
+  mowIndexExplicit = true;
+}
+
+void Map::startMowing(float stateX, float stateY){
   shouldDock = false;
   shouldMow = true;    
+  detourPlanning = false;
+  detourActive = false;
+  transitionActive = false;
+  transitionCornerIdx = -1;
   if (mowPointsCount > 0){
     // TODO: find valid path to mowing point
-    freePointsCount = 1;
-    freePointsIdx = 0;
-    points[freeStartIdx] = points[mowStartIdx + mowPointsIdx];
+    bool laneStart = false;
+    if ((nearestResume) && (!mowIndexExplicit) && (updateMowIndex()) && (mowIndex.mowedCount > 0)){
+      // resume: continue with unmowed point nearest to robot (docked: nearest to docking path start)
+      pt_t pos;
+      pos.x = stateX;
+      pos.y = stateY;
+      if (wayMode == WAY_DOCK) pos = points[dockStartIdx];
+      int idx = mowIndex.nearestUnmowed(pos.x, pos.y);
+      if ((idx >= 0) && (idx != mowPointsIdx)){
+        mowPointsIdx = idx;
+        if (wayMode == WAY_MOW) targetPointIdx = mowStartIdx + mowPointsIdx;
+        resumePointValid = false;
+        laneStart = (idx > 0);
+      }
+    }
+    mowIndexExplicit = false;
+    pt_t target = points[mowStartIdx + mowPointsIdx];
+    if (resumePointValid) target = resumePoint;  // lane was left at this position
+    if (laneStart) target = points[mowStartIdx + mowPointsIdx-1];  // mow whole lane to resumed point
+    resumePointValid = false;
+    int fromZone = (wayMode == WAY_DOCK) ? -1 : zoneAt(stateX, stateY);
+    if (((transferPath(fromZone, zoneIdx, target) > 1) || (laneStart)) && (wayMode != WAY_DOCK)){
+      // robot is outside active zone or away from lane - drive free points
+      wayMode = WAY_FREE;
+      targetPointIdx = freeStartIdx;
+    }
   }  
 }
 
@@ -226,17 +683,62 @@ bool Map::nextPoint(bool sim){
 
 // get next mowing point
 bool Map::nextMowPoint(bool sim){  
+  if (transitionActive){
+    if (transitionPointIdx+1 < transitionCount){
+      // next curve point
+      if (!sim) lastTargetPoint = targetPoint;
+      if (!sim) transitionPointIdx++;
+      return true;
+    }
+    // curve finished - continue from curve end to next mowing point
+    if (!sim) transitionActive = false;
+  }
   if (shouldMow){
-    if (mowPointsIdx+1 < mowPointsCount){
+    if ((nearestResume) && (updateMowIndex())){
+      // skip mowed points - at list end, continue with unmowed points left behind on resume
+      if (sim) {
+        if (mowIndex.count - mowIndex.mowedCount - ((mowIndex.isMowed(mowPointsIdx)) ? 0 : 1) > 0) return true;
+      } else {
+        mowIndex.setMowed(mowPointsIdx, true);
+        int idx = mowIndex.nextUnmowed(mowPointsIdx+1);
+        if (idx < 0) idx = mowIndex.nearestUnmowed(targetPoint.x, targetPoint.y);
+        if (idx >= 0){
+          bool jump = (idx != mowPointsIdx+1);
+          lastTargetPoint = targetPoint;
+          mowPointsIdx = idx;
+          targetPointIdx = mowStartIdx + mowPointsIdx;
+          if ((jump) && (idx > 0)){
+            // drive to lane start
+            transferPath(zoneIdx, zoneIdx, points[mowStartIdx + idx-1]);
+            targetPointIdx = freeStartIdx;
+            wayMode = WAY_FREE;
+          }
+          return true;
+        }
+      }
+    }
+    if ((!mowIndex.valid) && (mowPointsIdx+1 < mowPointsCount)){
       // next mowing point
       if (!sim) lastTargetPoint = targetPoint;
       if (!sim) mowPointsIdx++;
       if (!sim) targetPointIdx++;
       return true;
+    } else if ((zoneSequence) && (zoneIdx >= 0) && (zoneIdx+1 < zoneCount)) {
+      // zone finished - transfer to next zone
+      if (!sim) {
+        int fromZone = zoneIdx;
+        selectZone(zoneIdx + 1);
+        transferPath(fromZone, zoneIdx, points[mowStartIdx]);
+        lastTargetPoint = targetPoint;
+        targetPointIdx = freeStartIdx;
+        wayMode = WAY_FREE;
+      }
+      return true;
     } else {
       // finished mowing;
       mowPointsIdx = 0;      
       targetPointIdx = mowStartIdx;                
+      if (!sim) mowIndex.setProgress(0);
       return false;
     }         
   } else if ((shouldDock) && (dockPointsCount > 0)) {      
@@ -274,6 +776,7 @@ bool Map::nextDockPoint(bool sim){
       if (!sim) trackReverse = true;              
       if (!sim) trackSlow = true;
       if (!sim) targetPointIdx--;      
+      return true;
     } else {
       // finished undocking
       if ((shouldMow) && (mowPointsCount > 0 )){
@@ -289,6 +792,7 @@ bool Map::nextDockPoint(bool sim){
       } else return false;        
     }  
   }
+  return false;
 }
 
 // get next free point  
@@ -298,6 +802,8 @@ bool Map::nextFreePoint(bool sim){
     if (!sim) lastTargetPoint = targetPoint;
     if (!sim) freePointsIdx++;              
     if (!sim) targetPointIdx++;      
+    if (!sim) trackReverse = false;
+    return true;
   } else {
     // finished free points
     if ((shouldMow) && (mowPointsCount > 0 )){
@@ -305,7 +811,10 @@ bool Map::nextFreePoint(bool sim){
       if (!sim) lastTargetPoint = targetPoint;
       if (!sim) targetPointIdx = mowStartIdx + mowPointsIdx;              
       if (!sim) wayMode = WAY_MOW;
-      return false;       // TODO: return true
+      if (!sim) trackReverse = false;
+      // detour finished - rejoin lane
+      if (!sim) detourActive = false;
+      return true;
     } else if ((shouldDock) && (dockPointsCount > 0)){      
       // start docking
       if (!sim) lastTargetPoint = targetPoint;
@@ -322,3 +831,180 @@ void Map::setLastTargetPoint(float stateX, float stateY){
   lastTargetPoint.y = stateY;
 }
 
+
+
+// ---- obstacle layer ---------------------------------------------------------------
+
+void Map::clearObstacles(){
+  obstacleCount = 0;
+  obstacleDecayIdx = 0;
+}
+
+// add obstacle - if close to an existing obstacle, the existing obstacle is grown to enclose both
+int Map::addObstacle(float x, float y){
+  for (int i=0; i < obstacleCount; i++){
+    obstacle_t &o = obstacles[i];
+    float d = distance(o.x, o.y, x, y);
+    if (d < o.radius + OBSTACLE_MERGE_RADIUS){
+      if (d + OBSTACLE_RADIUS > o.radius){
+        // smallest circle enclosing obstacle and new trigger
+        float r = min(OBSTACLE_MAX_RADIUS, (d + o.radius + OBSTACLE_RADIUS) / 2.0);
+        float shift = (r - o.radius) / d;
+        o.x += (x - o.x) * shift;
+        o.y += (y - o.y) * shift;
+        o.radius = r;
+      }
+      o.lastSeenTime = millis();
+      return i;
+    }
+  }
+  int idx = obstacleCount;
+  if (obstacleCount < MAX_OBSTACLES) {
+    obstacleCount++;
+  } else {
+    // obstacle layer full - replace oldest obstacle
+    idx = 0;
+    for (int i=1; i < obstacleCount; i++){
+      if (obstacles[i].lastSeenTime < obstacles[idx].lastSeenTime) idx = i;
+    }
+  }
+  obstacles[idx].x = x;
+  obstacles[idx].y = y;
+  obstacles[idx].radius = OBSTACLE_RADIUS;
+  obstacles[idx].lastSeenTime = millis();
+  return idx;
+}
+
+// forget old obstacles (checks one obstacle per call)
+void Map::decayObstacles(){
+  if (obstacleCount == 0) return;
+  if (detourPlanning) return; // keep obstacle indices stable while planning
+  if (obstacleDecayIdx >= obstacleCount) obstacleDecayIdx = 0;
+  if (millis() > obstacles[obstacleDecayIdx].lastSeenTime + OBSTACLE_DECAY_TIME){
+    obstacleCount--;
+    obstacles[obstacleDecayIdx] = obstacles[obstacleCount];
+  } else obstacleDecayIdx++;
+}
+
+// ray casting point-in-polygon test
+bool Map::isPointInsidePolygon(int startIdx, int count, float x, float y){
+  bool inside = false;
+  for (int i=0, j=count-1; i < count; j = i++){
+    pt_t a = points[startIdx + i];
+    pt_t b = points[startIdx + j];
+    if ( ((a.y > y) != (b.y > y)) && (x < (b.x - a.x) * (y - a.y) / (b.y - a.y) + a.x) ) inside = !inside;
+  }
+  return inside;
+}
+
+// point inside perimeter, outside exclusions and outside (other) obstacles?
+bool Map::isPointValid(float x, float y, int ignoreObstacleIdx){
+  if (perimeterPointsCount >= 3){
+    if (!isPointInsidePolygon(perimeterStartIdx, perimeterPointsCount, x, y)) return false;
+  }
+  int idx = zoneExclusionPointIdx;
+  for (int i=zoneExclusionIdx; i < zoneExclusionIdx + zoneExclusionCount; i++){
+    if ((exclusionLength[i] >= 3) && (isPointInsidePolygon(idx, exclusionLength[i], x, y))) return false;
+    idx += exclusionLength[i];
+  }
+  for (int i=0; i < obstacleCount; i++){
+    if (i == ignoreObstacleIdx) continue;
+    if (distance(obstacles[i].x, obstacles[i].y, x, y) < obstacles[i].radius + DETOUR_CLEARANCE) return false;
+  }
+  return true;
+}
+
+// start computing detour around obstacle:
+// the detour reverses a bit, passes the obstacle on one side and rejoins the current mowing lane
+bool Map::startDetour(int obstacleIdx, float stateX, float stateY, float stateDelta){
+  if ((obstacleIdx < 0) || (obstacleIdx >= obstacleCount)) return false;
+  if (freeStartIdx + MAX_DETOUR_POINTS > MAX_POINTS) return false;
+  if (wayMode == WAY_MOW){
+    if (transitionActive){
+      // drop curve, rejoin lane at corner
+      transitionActive = false;
+      targetPoint = points[targetPointIdx];
+    }
+    // new detour for current lane
+    detourLaneStart = lastTargetPoint;
+    detourLaneEnd = targetPoint;
+    detourAttempts = 0;
+  } else if ((wayMode != WAY_FREE) || (!detourActive)) return false;
+  detourAttempts++;
+  if (detourAttempts > DETOUR_MAX_ATTEMPTS) return false;
+  detourObstacleIdx = obstacleIdx;
+  detourRobotPos.x = stateX;
+  detourRobotPos.y = stateY;
+  detourRobotDelta = stateDelta;
+  // prefer the side of the lane opposite to the obstacle
+  float laneDelta = pointsAngle(detourLaneStart.x, detourLaneStart.y, detourLaneEnd.x, detourLaneEnd.y);
+  float obstacleDelta = pointsAngle(detourLaneStart.x, detourLaneStart.y, obstacles[obstacleIdx].x, obstacles[obstacleIdx].y);
+  detourSide = (distancePI(laneDelta, obstacleDelta) > 0) ? -1 : 1;
+  detourStep = 0;
+  detourPlanning = true;
+  return true;
+}
+
+// one side is computed and verified per call, so each call fits into one control cycle
+bool Map::planDetour(){
+  if (!detourPlanning) return false;
+  float side = (detourStep == 0) ? detourSide : -detourSide;
+  detourStep++;
+  if (computeDetour(side)){
+    detourPlanning = false;
+    for (int i=0; i < detourPointsCount; i++) points[freeStartIdx + i] = detourPoints[i];
+    freePointsCount = detourPointsCount;
+    freePointsIdx = 0;
+    targetPointIdx = freeStartIdx;
+    targetPoint = points[targetPointIdx];
+    lastTargetPoint = detourRobotPos;
+    wayMode = WAY_FREE;
+    trackReverse = true;  // first detour point is behind robot
+    detourActive = true;
+    return true;
+  }
+  if (detourStep > 1) detourPlanning = false;  // no valid detour found
+  return false;
+}
+
+// compute detour points on given side (1=left, -1=right) of the lane
+bool Map::computeDetour(float side){
+  obstacle_t o = obstacles[detourObstacleIdx];
+  float dx = detourLaneEnd.x - detourLaneStart.x;
+  float dy = detourLaneEnd.y - detourLaneStart.y;
+  float len = sqrt( sq(dx) + sq(dy) );
+  if (len < 0.01){
+    dx = cos(detourRobotDelta);
+    dy = sin(detourRobotDelta);
+    len = 0;
+  } else {
+    dx /= len;
+    dy /= len;
+  }
+  float nx = -dy * side;   // normal pointing to detour side
+  float ny = dx * side;
+  float w = o.radius + DETOUR_CLEARANCE;
+  detourPointsCount = 0;
+  // back off
+  detourPoints[detourPointsCount].x = detourRobotPos.x - DETOUR_BACKOFF * cos(detourRobotDelta);
+  detourPoints[detourPointsCount].y = detourRobotPos.y - DETOUR_BACKOFF * sin(detourRobotDelta);
+  detourPointsCount++;
+  // pass obstacle
+  detourPoints[detourPointsCount].x = o.x - dx * w + nx * w;
+  detourPoints[detourPointsCount].y = o.y - dy * w + ny * w;
+  detourPointsCount++;
+  detourPoints[detourPointsCount].x = o.x + dx * w + nx * w;
+  detourPoints[detourPointsCount].y = o.y + dy * w + ny * w;
+  detourPointsCount++;
+  // rejoin lane (if obstacle is not near lane end)
+  float s = (o.x - detourLaneStart.x) * dx + (o.y - detourLaneStart.y) * dy + w + DETOUR_REJOIN;
+  if (s < len){
+    detourPoints[detourPointsCount].x = detourLaneStart.x + dx * s;
+    detourPoints[detourPointsCount].y = detourLaneStart.y + dy * s;
+    detourPointsCount++;
+  }
+  for (int i=0; i < detourPointsCount; i++){
+    if (!isPointValid(detourPoints[i].x, detourPoints[i].y, detourObstacleIdx)) return false;
+  }
+  return true;
+}
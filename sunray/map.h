@@ -10,9 +10,17 @@
 #define MAP_H
 
 #include <Arduino.h>
+#include "mowindex.h"
 
 #define MAX_POINTS 5000
 #define MAX_EXCLUSIONS 100
+#define MAX_OBSTACLES 50
+#define MAX_DETOUR_POINTS 4
+#define PROFILE_LOOKAHEAD 8   // velocity profile: cached upcoming mowing points
+#define MAX_TRANSITION_POINTS 16  // lane transition: max. curve points
+#define MAX_ZONES 10
+#define ZONE_NAME_LEN 12
+#define ZONE_ALL 255          // all zones (timetable)
 
 
 // waypoint type
@@ -28,6 +36,34 @@ struct pt_t {
 typedef struct pt_t pt_t;
 
 
+// obstacle (dynamic, detected by sonar or motion stall)
+struct obstacle_t {
+  float x;        // center (m)
+  float y;  
+  float radius;   // radius (m)
+  unsigned long lastSeenTime;  // last time obstacle was triggered (ms)
+};
+
+typedef struct obstacle_t obstacle_t;
+
+
+// zone (separate lawn) in section table - point ranges of the zone in the uploaded point blocks 
+struct zone_t {
+  short perimeterStartIdx;  // perimeter points
+  short perimeterCount;
+  short exclusionIdx;       // first exclusion (index into exclusionLength)
+  short exclusionCount;
+  short exclusionPointIdx;  // first exclusion point
+  short transitStartIdx;    // transit path (free points) from docking area to first mowing point
+  short transitCount;
+  short mowStartIdx;        // mowing points
+  short mowCount;
+  char name[ZONE_NAME_LEN];
+};
+
+typedef struct zone_t zone_t;
+
+
 // there are three types of points used as waypoints:
 // mowing points:     fixed and transfered by the phone
 // docking points:    fixed and transfered by the phone
@@ -37,6 +73,14 @@ typedef struct pt_t pt_t;
 // there are additional static points (not used as waypoints but for computing the free points):
 // exclusion points:  fixed and transfered by the phone
 // perimeter points:  fixed and transfered by the phone
+//
+// obstacles (sonar, motion stall) are stored in a separate obstacle layer (map coordinates) - they merge 
+// if close to each other and decay after some time. A detour around an obstacle is stored as free points.
+
+// multiple zones: each point block holds the zones one after the other (mowing block: transit path and 
+// mowing points of zone 0, of zone 1, ...) - the section table (zones) stores the ranges, switching zones 
+// only swaps the active ranges (perimeterStartIdx, mowStartIdx, ...). Robot moves between zones on the 
+// transit paths (via docking area), copied into the free points.
 
 // explain image:  https://wiki.ardumower.de/index.php?title=Ardumower_Sunray#What_data_is_transferred_to_the_Arduino
 
@@ -57,6 +101,14 @@ class Map
     bool useGPSfloatForDeltaEstimation;  // use GPS float solution for delta estimation?
     bool useIMU; // allow using IMU?
     
+    // geometry of current line (lastTargetPoint, targetPoint), updated once per line in run()
+    float segmentDirX;     // unit direction
+    float segmentDirY;     
+    float segmentLength;   // length (m)
+    float segmentHeading;  // heading (rad)
+    bool segmentNextStraight;  // turn angle to next line below 20 degree?
+    float segmentEndSpeed;     // velocity profile: max. speed at target point (m/s)
+    
     // keeps track of the progress in the different point types
     int mowPointsIdx;    // next mowing point in mowing point list    
     int dockPointsIdx;   // next dock point in docking point list
@@ -78,6 +130,12 @@ class Map
     short mowStartIdx; // mowing start index into points    
     short freeStartIdx;  // free points start index into points
     
+    // section table (empty: single zone map)
+    zone_t zones[MAX_ZONES];
+    int zoneCount;
+    int zoneIdx;        // active zone (-1: whole map)
+    bool zoneSequence;  // continue with next zone when active zone is finished?
+    
     // storing all points
     pt_t points[MAX_POINTS]; // points list in this order: ( perimeter, exclusions, docking, mowing, free )
     short storeIdx;  // index where to store next transferred point
@@ -85,6 +143,21 @@ class Map
     bool shouldDock;  // start docking?
     bool shouldMow;  // start mowing?
     
+    // obstacle layer
+    obstacle_t obstacles[MAX_OBSTACLES];
+    int obstacleCount;
+    bool detourPlanning; // detour computation in progress?
+    bool detourActive;   // driving a detour (free points) around an obstacle?
+    bool transitionActive;   // driving a curve (transition points) instead of a corner?
+    
+    // mowed flags and nearest unmowed point search over mowing points of active zone (NEAREST_RESUME)
+    MowIndex mowIndex;
+    
+    // features (defaults from config.h, set in begin)
+    bool nearestResume;       // NEAREST_RESUME
+    bool velocityProfile;     // VELOCITY_PROFILE
+    bool smoothTransitions;   // SMOOTH_TRANSITIONS
+    
     void begin();    
     void run();    
     // set point coordinate
@@ -93,6 +166,12 @@ class Map
     bool setWayCount(WayType type, int count);
     // set number points for exclusion 
     bool setExclusionLength(int idx, int len);
+    // set zone in section table (zones are set in order, ranges follow the previous zone)
+    bool setZone(int idx, int perimeterCount, int exclusions, int transitCount, int mowCount, const char *name);
+    // switch active zone (mowing progress restarts)
+    bool selectZone(int idx);
+    // zone with perimeter containing position (-1: none)
+    int zoneAt(float x, float y);
     // choose progress (0..100%) in mowing point list
     void setMowingPointPercent(float perc);
     // set last target point
@@ -100,20 +179,88 @@ class Map
     // distance to target waypoint
     float distanceToTargetPoint(float stateX, float stateY);    
     float distanceToLastTargetPoint(float stateX, float stateY);
+    // signed distance to current line (lastTargetPoint, targetPoint)
+    float distanceToTargetLine(float stateX, float stateY);
     // go to next waypoint
     bool nextPoint(bool sim);
     // next point is straight and not a sharp curve?   
     bool nextPointIsStraight();
+    // driving inside a transition curve (past its start point on the incoming line)?
+    bool transitionCurveActive();
+    // velocity profile: max. speed (m/s) at distance to target point (braking for upcoming curves)
+    float profileSpeed(float targetDist);
+    // velocity profile: next linear speed (m/s) towards speed with limited acceleration, deceleration and jerk
+    // (lastSpeed: current set speed, dt: time since last call in s)
+    float limitAcceleration(float lastSpeed, float speed, float dt);
+    // path length from position via docking points to docking station
+    float distanceToDock(float stateX, float stateY);
     // set robot state position to docking position
     void setRobotStatePosToDockingPos(float &x, float &y, float &delta);
     void setIsDocked(bool flag);
-    void startDocking();
-    void startMowing();
+    void startDocking(float stateX, float stateY);
+    void startMowing(float stateX, float stateY);
+    // continue mowing at position (on lane to current mowing point) with next startMowing
+    void setResumePoint(float x, float y);
+    // continue mowing with mowing point with next startMowing (no nearest unmowed point search)
+    void setResumeIndex(int mowIdx);
     void dump();
+    // add obstacle at position (merges with nearby obstacle), returns obstacle index
+    int addObstacle(float x, float y);
+    void clearObstacles();
+    // start computing a detour around obstacle (computed incrementally by planDetour)
+    bool startDetour(int obstacleIdx, float stateX, float stateY, float stateDelta);
+    // compute next detour step - returns true if detour was found and activated
+    bool planDetour();
   private:
+    int mapPerimeterPointsCount;  // uploaded counts (all zones)
+    int mapMowPointsCount;
+    int zoneExclusionIdx;         // exclusions of active zone
+    int zoneExclusionCount;
+    int zoneExclusionPointIdx;
+    void clearZones();
+    short mowIndexStartIdx;   // mowing points start index of index
+    bool mowIndexExplicit;    // start point chosen by user (no nearest point search)
+    bool updateMowIndex();
+    int transferPath(int fromZone, int toZone, pt_t target);
+    int segmentTargetIdx;
+    WayType segmentWayMode;
+    pt_t segmentStart;
+    pt_t segmentEnd;
+    void updateSegment();
+    pt_t resumePoint;
+    bool resumePointValid;
+    int transitionCornerIdx;  // mowing point index of last considered corner
+    int transitionPointIdx;   // current transition point
+    int transitionCount;
+    pt_t transitionPoints[MAX_TRANSITION_POINTS];
+    float transitionShape(float angle, int steps, pt_t *curve);
+    bool computeTransition(pt_t start, pt_t corner, pt_t end, float tangent);
+    void updateTransition();
+    int profileStartIdx;   // mowing point index of first cached corner
+    int profileCount;
+    float profileLength[PROFILE_LOOKAHEAD];  // length of line ending at corner (m)
+    float profileCorner[PROFILE_LOOKAHEAD];  // max. speed at corner (m/s)
+    float profileAccel;    // last acceleration (m/s^2)
+    float cornerSpeed(int mowIdx);
+    void updateProfile();
+    int obstacleDecayIdx;
+    int detourObstacleIdx;
+    int detourAttempts;
+    int detourStep;
+    float detourSide;
+    pt_t detourRobotPos;
+    float detourRobotDelta;
+    pt_t detourLaneStart;
+    pt_t detourLaneEnd;
+    pt_t detourPoints[MAX_DETOUR_POINTS];
+    int detourPointsCount;
     bool nextMowPoint(bool sim);
     bool nextDockPoint(bool sim);
     bool nextFreePoint(bool sim);
+    void decayObstacles();
+    bool computeDetour(float side);
+    bool isPointInsidePolygon(int startIdx, int count, float x, float y);
+    bool isPointValid(float x, float y, int ignoreObstacleIdx);
     
 };
 
@@ -0,0 +1,102 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "mission.h"
+#include "config.h"
+#include "robot.h"
+
+
+#define MISSION_RESUME_SOC        0.95     // continue mowing when charged to this state of charge
+#define MISSION_MIN_CHARGE_TIME   300000   // min. charging time (ms) before continuing
+
+
+void Mission::begin(){
+  enabled = MISSION_MANAGER;
+  state = MISSION_NONE;
+  chargeCycles = 0;
+  resumeMowIdx = 0;
+  resumePosValid = false;
+  chargeStartTime = 0;
+}
+
+void Mission::setState(MissionState newState){
+  if (state == newState) return;
+  CONSOLE.print("mission state=");
+  CONSOLE.println(newState);
+  state = newState;
+}
+
+void Mission::run(){
+  if (!enabled) return;
+  switch (state){
+    case MISSION_NONE:
+      if (stateOp == OP_MOW) {
+        // mowing started (by user)
+        chargeCycles = 0;
+        setState(MISSION_MOW);
+      }
+      break;
+    case MISSION_MOW:
+      if (stateOp != OP_MOW) {
+        // stopped by user, error, undervoltage
+        setState(MISSION_NONE);
+      } else if ((maps.dockPointsCount > 0) && (battery.shouldGoHome())){
+        // dock while remaining charge is still enough for the path home - remember progress
+        CONSOLE.print("mission: battery low - docking at ");
+        CONSOLE.print(maps.percentCompleted);
+        CONSOLE.println("%");
+        resumeMowIdx = maps.mowPointsIdx;
+        resumePosValid = ((maps.wayMode == WAY_MOW) && (!maps.detourActive));
+        resumeX = stateX;
+        resumeY = stateY;
+        setOperation(OP_DOCK);
+        if (stateOp == OP_DOCK) setState(MISSION_GO_CHARGE);
+          else setState(MISSION_NONE);
+      }
+      break;
+    case MISSION_GO_CHARGE:
+      if (stateOp == OP_CHARGE) {
+        chargeStartTime = millis();
+        chargeCycles++;
+        setState(MISSION_CHARGE);
+      } else if (stateOp != OP_DOCK) setState(MISSION_NONE);
+      break;
+    case MISSION_CHARGE:
+      if (stateOp != OP_CHARGE) {
+        // charger disconnected, user command
+        setState(MISSION_NONE);
+      } else if ((battery.stateOfCharge >= MISSION_RESUME_SOC) && (millis() > chargeStartTime + MISSION_MIN_CHARGE_TIME)){
+        // charged - undock and continue at remembered position
+        CONSOLE.println("mission: charged - continue mowing");
+        maps.setResumeIndex(resumeMowIdx);   // remembered progress wins over nearest unmowed point
+        if (resumePosValid) maps.setResumePoint(resumeX, resumeY);
+        setState(MISSION_MOW);
+        setOperation(OP_MOW);
+        if (stateOp != OP_MOW) setState(MISSION_NONE);
+      }
+      break;
+    case MISSION_FINISHED:
+      if (stateOp == OP_CHARGE) {
+        CONSOLE.print("mission: finished after charge cycles=");
+        CONSOLE.println(chargeCycles);
+        setState(MISSION_NONE);
+      } else if (stateOp != OP_DOCK) setState(MISSION_NONE);
+      break;
+  }
+}
+
+bool Mission::finished(){
+  if ((!enabled) || (state != MISSION_MOW)) return false;
+  if (maps.dockPointsCount == 0) return false;
+  CONSOLE.println("mission: all points mowed - docking");
+  setOperation(OP_DOCK);
+  if (stateOp != OP_DOCK) return false;
+  setState(MISSION_FINISHED);
+  return true;
+}
+
+void Mission::cancel(){
+  setState(MISSION_NONE);
+}
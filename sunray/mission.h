@@ -0,0 +1,48 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// mission manager (above setOperation): mows the whole map over several charge cycles
+//   mow -> battery low: remember progress, dock -> charge until resume threshold -> undock, 
+//   continue at remembered lane position -> ... -> all mowing points done: dock
+
+#ifndef MISSION_H
+#define MISSION_H
+
+#include <Arduino.h>
+
+
+enum MissionState {
+  MISSION_NONE,      // no mission (idle, error, manual operation)
+  MISSION_MOW,       // mowing
+  MISSION_GO_CHARGE, // docking for charging (mission continues)
+  MISSION_CHARGE,    // charging until resume threshold
+  MISSION_FINISHED,  // all points mowed - docking
+};
+typedef enum MissionState MissionState;
+
+
+class Mission {
+  public:
+    bool enabled;
+    MissionState state;
+    int chargeCycles;       // charge cycles of current mission
+    void begin();
+    // per control cycle
+    void run();
+    // mowing points finished - returns true if mission takes over (docks)
+    bool finished();
+    // end mission (no resume after charging) - operation is not changed
+    void cancel();
+  protected:
+    int resumeMowIdx;       // mowing point index to continue with
+    float resumeX;          // lane position to continue at
+    float resumeY;
+    bool resumePosValid;
+    unsigned long chargeStartTime;
+    void setState(MissionState newState);
+};
+
+
+#endif
@@ -0,0 +1,152 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "motion.h"
+#include "config.h"
+
+
+#define MOTION_MIN_RPM            3.0     // min. set wheel speed (rpm) to evaluate a wheel
+#define MOTION_SETPOINT_CHANGE    0.3     // relative set speed change that restarts settling
+#define MOTION_SETTLE_TIME        500     // time (ms) for motors to follow a new set speed
+#define MOTION_FILTER_TIME        100.0   // wheel ratio filter time constant (ms)
+#define MOTION_BASE_FILTER_TIME   2000.0  // current baseline filter time constant (ms)
+#define MOTION_CONFIRM_TIME       300     // time (ms) a classification must persist
+#define MOTION_STALL_RATIO        0.2     // wheel turns slower than this (of set speed): stall
+#define MOTION_OBSTACLE_RATIO     0.6     // wheel turns slower than this (of set speed): obstacle
+#define MOTION_NORMAL_RATIO       0.8     // wheel turns faster than this: learn current baseline
+#define MOTION_CURRENT_RISE       0.5     // current rise relative to baseline
+#define MOTION_CURRENT_RISE_MIN   0.3     // min. current rise (amps)
+#define MOTION_SLIP_MIN_SPEED     0.1     // min. wheel speed (m/s) for GPS slip detection
+#define MOTION_SLIP_GPS_RATIO     0.3     // GPS speed below this (of wheel speed): slip
+#define MOTION_SLIP_YAW_RATE      0.5     // max. IMU/wheel yaw rate difference (rad/s)
+#define MOTION_GPS_TIMEOUT        500     // GPS ground speed valid (ms)
+#define MOTION_IMU_TIMEOUT        500     // IMU yaw rate valid (ms)
+
+
+void MotionDetector::begin(){
+  enabled = MOTION_DETECTION;
+  detections = 0;
+  lastRunTime = 0;
+  groundSpeed = 0;
+  groundSpeedTime = 0;
+  yawRateIMU = 0;
+  yawTime = 0;
+  yawRateTime = 0;
+  baseCurrentLeft = 0;
+  baseCurrentRight = 0;
+  baseValid = false;
+  reset();
+}
+
+void MotionDetector::reset(){
+  state = MOTION_NONE;
+  candidate = MOTION_NONE;
+  candidateTime = millis();
+  settleTime = millis() + MOTION_SETTLE_TIME;
+  lastRpmSetLeft = 0;
+  lastRpmSetRight = 0;
+  wheelRatioLeft = 1.0;
+  wheelRatioRight = 1.0;
+  currentRiseLeft = 0;
+  currentRiseRight = 0;
+}
+
+void MotionDetector::addGroundSpeed(float speed){
+  groundSpeed = speed;
+  groundSpeedTime = millis();
+}
+
+void MotionDetector::addYawIMU(float deltaYaw){
+  unsigned long t = millis();
+  unsigned long dt = t - yawTime;
+  if ((yawTime != 0) && (dt > 0) && (dt < MOTION_IMU_TIMEOUT)){
+    yawRateIMU = deltaYaw / (((float)dt) / 1000.0);
+    yawRateTime = t;
+  }
+  yawTime = t;
+}
+
+const char *MotionDetector::stateName(){
+  switch (state){
+    case MOTION_SLIP: return "slip";
+    case MOTION_STALL: return "stall";
+    case MOTION_OBSTACLE: return "obstacle";
+    default: return "none";
+  }
+}
+
+// set speed changed significantly (start, stop, rotation) => motors need time to follow
+static bool setpointChanged(float rpmSet, float lastRpmSet){
+  return (fabs(rpmSet - lastRpmSet) > MOTION_SETPOINT_CHANGE * max(fabs(lastRpmSet), (float)MOTION_MIN_RPM));
+}
+
+void MotionDetector::run(float rpmSetLeft, float rpmSetRight, float rpmLeft, float rpmRight,
+                         float speedLeft, float speedRight, float wheelBase, float currentLeft, float currentRight){
+  unsigned long t = millis();
+  float dt = (float)(t - lastRunTime);
+  lastRunTime = t;
+  if (!enabled) return;
+  if (setpointChanged(rpmSetLeft, lastRpmSetLeft) || setpointChanged(rpmSetRight, lastRpmSetRight)) {
+    settleTime = t + MOTION_SETTLE_TIME;
+  }
+  lastRpmSetLeft = rpmSetLeft;
+  lastRpmSetRight = rpmSetRight;
+  if ( ((fabs(rpmSetLeft) < MOTION_MIN_RPM) && (fabs(rpmSetRight) < MOTION_MIN_RPM)) || (t < settleTime) ) {
+    // standing still or accelerating
+    candidate = MOTION_NONE;
+    wheelRatioLeft = 1.0;
+    wheelRatioRight = 1.0;
+    return;
+  }
+  // wheel speed relative to set speed (1: follows set speed, 0: stopped, <0: wrong direction)
+  float ratioLeft = (fabs(rpmSetLeft) < MOTION_MIN_RPM) ? 1.0 : rpmLeft / rpmSetLeft;
+  float ratioRight = (fabs(rpmSetRight) < MOTION_MIN_RPM) ? 1.0 : rpmRight / rpmSetRight;
+  float w = dt / (MOTION_FILTER_TIME + dt);
+  wheelRatioLeft += w * (ratioLeft - wheelRatioLeft);
+  wheelRatioRight += w * (ratioRight - wheelRatioRight);
+  // current baseline (learned while driving normally)
+  if (!baseValid){
+    baseCurrentLeft = currentLeft;
+    baseCurrentRight = currentRight;
+    baseValid = true;
+  } else if ((candidate == MOTION_NONE) && (wheelRatioLeft > MOTION_NORMAL_RATIO) && (wheelRatioRight > MOTION_NORMAL_RATIO)){
+    w = dt / (MOTION_BASE_FILTER_TIME + dt);
+    baseCurrentLeft += w * (currentLeft - baseCurrentLeft);
+    baseCurrentRight += w * (currentRight - baseCurrentRight);
+  }
+  currentRiseLeft = currentLeft - baseCurrentLeft;
+  currentRiseRight = currentRight - baseCurrentRight;
+
+  MotionState c = classify(rpmSetLeft, rpmSetRight, speedLeft, speedRight, wheelBase);
+  if (c != candidate){
+    candidate = c;
+    candidateTime = t;
+  } else if ((c != MOTION_NONE) && (state == MOTION_NONE) && (t - candidateTime >= MOTION_CONFIRM_TIME)){
+    state = c;
+    detections++;
+  }
+}
+
+MotionState MotionDetector::classify(float rpmSetLeft, float rpmSetRight, float speedLeft, float speedRight, float wheelBase){
+  bool activeLeft = (fabs(rpmSetLeft) >= MOTION_MIN_RPM);
+  bool activeRight = (fabs(rpmSetRight) >= MOTION_MIN_RPM);
+  bool riseLeft = activeLeft && (currentRiseLeft > max((float)MOTION_CURRENT_RISE_MIN, (float)MOTION_CURRENT_RISE * baseCurrentLeft));
+  bool riseRight = activeRight && (currentRiseRight > max((float)MOTION_CURRENT_RISE_MIN, (float)MOTION_CURRENT_RISE * baseCurrentRight));
+  if ( ((riseLeft) && (wheelRatioLeft < MOTION_STALL_RATIO)) || ((riseRight) && (wheelRatioRight < MOTION_STALL_RATIO)) ) 
+    return MOTION_STALL;
+  if ( ((riseLeft) && (wheelRatioLeft < MOTION_OBSTACLE_RATIO)) || ((riseRight) && (wheelRatioRight < MOTION_OBSTACLE_RATIO)) ) 
+    return MOTION_OBSTACLE;
+  if ((wheelRatioLeft < MOTION_OBSTACLE_RATIO) || (wheelRatioRight < MOTION_OBSTACLE_RATIO)) 
+    return MOTION_NONE;  // slowed down without load (e.g. PWM limit): nothing to compare
+  // wheels turn as commanded - does the robot move?
+  unsigned long t = millis();
+  float wheelSpeed = fabs(speedLeft + speedRight) / 2.0;
+  if ((t - groundSpeedTime < MOTION_GPS_TIMEOUT) && (wheelSpeed > MOTION_SLIP_MIN_SPEED)
+      && (groundSpeed < MOTION_SLIP_GPS_RATIO * wheelSpeed)) return MOTION_SLIP;
+  float wheelYawRate = (speedRight - speedLeft) / wheelBase;
+  if ((t - yawRateTime < MOTION_IMU_TIMEOUT) && (fabs(yawRateIMU - wheelYawRate) > MOTION_SLIP_YAW_RATE)) 
+    return MOTION_SLIP;
+  return MOTION_NONE;
+}
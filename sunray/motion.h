@@ -0,0 +1,68 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// slip/stall/obstacle detection by comparing wheel speeds (ticks) with the set speeds,
+// GPS ground speed (VELNED), IMU yaw rate and the motor currents over a short window:
+//   stall:    a wheel does not turn and its current rises (motor blocked)
+//   obstacle: wheels slow down and the current rises (robot pushing against something)
+//   slip:     wheels turn as commanded, but GPS speed or IMU yaw rate say the robot does not move
+// stall and obstacle trigger an obstacle (robot.cpp), slip only slows the robot down for a few seconds
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <Arduino.h>
+
+
+enum MotionState {
+  MOTION_NONE,
+  MOTION_SLIP,
+  MOTION_STALL,
+  MOTION_OBSTACLE,
+};
+typedef enum MotionState MotionState;
+
+
+class MotionDetector {
+  public:
+    bool enabled;
+    MotionState state;       // confirmed classification (until reset)
+    float wheelRatioLeft;    // measured/set wheel speed (filtered)
+    float wheelRatioRight;
+    float currentRiseLeft;   // current above baseline (amps)
+    float currentRiseRight;
+    unsigned long detections; // counter
+    void begin();
+    // start new measurement (after obstacle, detour, etc.)
+    void reset();
+    // GPS ground speed (m/s) of new solution
+    void addGroundSpeed(float speed);
+    // IMU yaw change (rad) of new IMU sample
+    void addYawIMU(float deltaYaw);
+    // per control cycle: set and measured wheel speeds (rpm), measured wheel speeds (m/s),
+    // wheel base (m) and motor currents (amps) - the wheel yaw rate is derived from the wheel speeds
+    void run(float rpmSetLeft, float rpmSetRight, float rpmLeft, float rpmRight,
+             float speedLeft, float speedRight, float wheelBase, float currentLeft, float currentRight);
+    const char *stateName();
+  protected:
+    MotionState candidate;
+    unsigned long candidateTime;
+    unsigned long lastRunTime;
+    unsigned long settleTime;  // set speed changed: wait for motors to follow
+    float lastRpmSetLeft;
+    float lastRpmSetRight;
+    float baseCurrentLeft;     // current while driving normally (amps)
+    float baseCurrentRight;
+    bool baseValid;
+    float groundSpeed;
+    unsigned long groundSpeedTime;
+    float yawRateIMU;
+    unsigned long yawTime;
+    unsigned long yawRateTime;
+    MotionState classify(float rpmSetLeft, float rpmSetRight, float speedLeft, float speedRight, float wheelBase);
+};
+
+
+#endif
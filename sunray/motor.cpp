@@ -7,11 +7,30 @@
 #include "config.h"
 #include "helper.h"
 #include "robot.h"
+#include "adcman.h"
 #include "Arduino.h"
 
 volatile uint16_t odoTicksLeft = 0;
 volatile uint16_t odoTicksRight = 0;
-
+volatile uint16_t mowTicks = 0;
+
+#define MOW_RPM_PERIOD           500    // mowing motor RPM measurement period (ms)
+#define MOW_RPM_MIN              300    // min. mowing motor no-load speed (rpm) to evaluate RPM drop
+#define MOW_RPM_NOLOAD_DECAY     0.002  // no-load speed decay per period (follows battery voltage)
+#define MOW_RPM_NOLOAD_CURRENT   (0.5 * MOW_LOAD_CURRENT)  // max. mowing motor current (amps) for no-load speed decay
+#define MOW_LOAD_RPM_DROP        0.15   // target mowing motor RPM drop (relative to no-load)
+#define MOW_SPEED_GAIN_DOWN      1.0    // speed factor change per second and load error (load too high)
+#define MOW_SPEED_GAIN_UP        0.1    // speed factor change per second and load error (load too low)
+#define MOW_SPEED_FACTOR_MIN     0.3
+#define MOW_SPEED_FACTOR_MAX     1.3
+
+#define TUNE_PWM_LOW             0.4    // step test: PWM levels (of pwmMax)
+#define TUNE_PWM_HIGH            0.8
+#define TUNE_STEP_SAMPLES        100    // samples per PWM level
+#define TUNE_SAMPLE_TIME         20     // sample time (ms)
+#define TUNE_WINDOW              5      // speed measurement window (samples)
+#define TUNE_STEADY_SAMPLES      25     // samples averaged for steady-state speed
+#define TUNE_CONTROL_TIME        0.05   // speed control period (s)
 
 
 // odometry signal change interrupt
@@ -23,6 +42,11 @@ void OdometryRightInt(){
   odoTicksRight++;
 }
 
+// mowing motor RPM sensor interrupt
+void MowRpmInt(){
+  mowTicks++;
+}
+
 
 void Motor::begin() {
   // left wheel motor
@@ -47,6 +71,11 @@ void Motor::begin() {
   pinMode(pinMotorMowEnable, OUTPUT);
   digitalWrite(pinMotorMowEnable, HIGH);
   pinMode(pinMotorMowFault, INPUT);
+  
+  // motor current sensing (background ADC sampling)
+  ADCMan.setCapture(pinMotorLeftSense);
+  ADCMan.setCapture(pinMotorRightSense);
+  ADCMan.setCapture(pinMotorMowSense);
 
   // odometry
   pinMode(pinOdometryLeft, INPUT_PULLUP);
@@ -60,6 +89,11 @@ void Motor::begin() {
 	
 	pinMan.setDebounce(pinOdometryLeft, 100);  // reject spikes shorter than usecs on pin
 	pinMan.setDebounce(pinOdometryRight, 100);  // reject spikes shorter than usecs on pin	
+
+  if (MOW_TICKS_PER_REVOLUTION > 0){
+    attachInterrupt(pinMotorMowRpm, MowRpmInt, RISING);
+    pinMan.setDebounce(pinMotorMowRpm, 100);  // reject spikes shorter than usecs on pin
+  }
 	
 	pwmMax = 255;
   pwmMaxMow = 255;
@@ -69,13 +103,11 @@ void Motor::begin() {
 	wheelBaseCm = WHEEL_BASE_CM;    // wheel-to-wheel distance (cm) 36
   wheelDiameter = WHEEL_DIAMETER; // wheel diameter (mm)
   ticksPerCm         = ((float)ticksPerRevolution) / (((float)wheelDiameter)/10.0) / 3.1415;    // computes encoder ticks per cm (do not change)  
+  odometryScaleLeft = 1.0;
+  odometryScaleRight = 1.0;
 
-  motorLeftPID.Kp       = 2.0;  
-  motorLeftPID.Ki       = 0.03; 
-  motorLeftPID.Kd       = 0.03; 
-  motorRightPID.Kp       = motorLeftPID.Kp;
-  motorRightPID.Ki       = motorLeftPID.Ki;
-  motorRightPID.Kd       = motorLeftPID.Kd;		 
+  resetTuning();
+  loadTuning();
 
   motorLeftSwapDir = false;
   motorRightSwapDir = false;
@@ -94,6 +126,12 @@ void Motor::begin() {
   motorLeftSenseLP = 0;
   motorRightSenseLP = 0;
   motorMowSenseLP = 0;
+  motorMowRpmCurr = 0;
+  motorMowRpmNoLoad = 0;
+  motorMowTicks = 0;
+  lastMowRpmTime = 0;
+  mowLoad = 0;
+  mowSpeedFactor = 1.0;
 
   linearSpeedSet = 0;
   angularSpeedSet = 0;
@@ -170,8 +208,8 @@ void Motor::setLinearAngularSpeed(float linear, float angular){
    setLinearAngularSpeedTimeoutActive = true;
    float rspeed = linear + angular * (wheelBaseCm /100.0 /2);          
    float lspeed = linear * 2.0 - rspeed;          
-   motorRightRpmSet =  rspeed / (PI*(wheelDiameter/1000.0)) * 60.0;
-   motorLeftRpmSet = lspeed / (PI*(wheelDiameter/1000.0)) * 60.0;   
+   motorRightRpmSet =  rspeed / (PI*(wheelDiameter/1000.0)) * 60.0 / odometryScaleRight;
+   motorLeftRpmSet = lspeed / (PI*(wheelDiameter/1000.0)) * 60.0 / odometryScaleLeft;   
    /*CONSOLE.print("setLinearAngularSpeed ");
    CONSOLE.print(linear);
    CONSOLE.print(",");
@@ -263,6 +301,8 @@ void Motor::run() {
   control();  
   checkFault();
   sense();        
+  senseMowRpm();
+  adaptMowSpeed(deltaControlTimeSec);
   
   if (resetMotorFault) {    
     if (millis() > nextResetMotorFaultTime){
@@ -348,9 +388,9 @@ void Motor::sense(){
   if (millis() < nextSenseTime) return;
   nextSenseTime = millis() + 20;
   float scale       = 1.905;   // ADC voltage to amp   
-  motorRightSense = ((float)ADC2voltage(analogRead(pinMotorRightSense))) *scale;
-  motorLeftSense = ((float)ADC2voltage(analogRead(pinMotorLeftSense))) *scale;
-  motorMowSense = ((float)ADC2voltage(analogRead(pinMotorMowSense))) *scale  *2;	      
+  motorRightSense = ((float)ADC2voltage(ADCMan.read(pinMotorRightSense))) *scale;
+  motorLeftSense = ((float)ADC2voltage(ADCMan.read(pinMotorLeftSense))) *scale;
+  motorMowSense = ((float)ADC2voltage(ADCMan.read(pinMotorMowSense))) *scale  *2;	      
   motorRightSenseLP = 0.95 * motorRightSenseLP + 0.05 * motorRightSense;
   motorLeftSenseLP = 0.95 * motorLeftSenseLP + 0.05 * motorLeftSense;
   motorMowSenseLP = 0.95 * motorMowSenseLP + 0.05 * motorMowSense; 
@@ -374,6 +414,98 @@ void Motor::sense(){
 }
 
 
+// measure mowing motor speed (RPM sensor ticks)
+void Motor::senseMowRpm(){
+  if (MOW_TICKS_PER_REVOLUTION == 0) return;
+  motorMowTicks += mowTicks;
+  mowTicks = 0;
+  unsigned long currTime = millis();
+  if (currTime < lastMowRpmTime + MOW_RPM_PERIOD) return;
+  float rpm = 60000.0 * ((float)motorMowTicks) / ((float)MOW_TICKS_PER_REVOLUTION) / ((float)(currTime - lastMowRpmTime));
+  motorMowTicks = 0;
+  lastMowRpmTime = currTime;
+  motorMowRpmCurr = 0.5 * motorMowRpmCurr + 0.5 * rpm;
+  if (motorMowPWMCurr == 0) return;
+  // no-load speed: highest speed seen, slowly decaying with battery voltage
+  // (decay only at low load - in thick grass the reference must not follow the dropping RPM)
+  if (motorMowRpmCurr > motorMowRpmNoLoad) motorMowRpmNoLoad = motorMowRpmCurr;
+    else if (motorMowSenseLP < MOW_RPM_NOLOAD_CURRENT) motorMowRpmNoLoad -= MOW_RPM_NOLOAD_DECAY * motorMowRpmNoLoad;
+}
+
+// mowing load (current, RPM drop) => ground speed factor (integral control towards target load)
+void Motor::adaptMowSpeed(float deltaTimeSec){
+  if ((!ADAPTIVE_SPEED) || (motorMowPWMSet == 0)){
+    mowLoad = 0;
+    mowSpeedFactor = 1.0;
+    return;
+  }
+  mowLoad = motorMowSenseLP / MOW_LOAD_CURRENT;
+  if (motorMowRpmNoLoad > MOW_RPM_MIN){
+    float drop = 1.0 - motorMowRpmCurr / motorMowRpmNoLoad;
+    mowLoad = max(mowLoad, drop / ((float)MOW_LOAD_RPM_DROP));
+  }
+  float error = 1.0 - mowLoad;
+  float gain = (error < 0) ? MOW_SPEED_GAIN_DOWN : MOW_SPEED_GAIN_UP;
+  mowSpeedFactor += gain * error * min(deltaTimeSec, 0.5);
+  mowSpeedFactor = max((float)MOW_SPEED_FACTOR_MIN, min((float)MOW_SPEED_FACTOR_MAX, mowSpeedFactor));
+}
+
+
+// default (untuned) incremental PID
+void Motor::resetTuning(){
+  feedForward = false;
+  motorLeftFFGain = 0;
+  motorLeftFFOffset = 0;
+  motorRightFFGain = 0;
+  motorRightFFOffset = 0;
+  motorLeftPID.Kp       = 2.0;  
+  motorLeftPID.Ki       = 0.03; 
+  motorLeftPID.Kd       = 0.03; 
+  motorRightPID.Kp       = motorLeftPID.Kp;
+  motorRightPID.Ki       = motorLeftPID.Ki;
+  motorRightPID.Kd       = motorLeftPID.Kd;		 
+}
+
+void Motor::loadTuning(){
+  float data[8];
+  if (!storage.load(STORAGE_ADDR_MOTOR, data, sizeof(data))) return;
+  if ((data[0] <= 0) || (data[4] <= 0)) return;  // tuning was reset
+  motorLeftFFGain = data[0];
+  motorLeftFFOffset = data[1];
+  motorLeftPID.Kp = data[2];
+  motorLeftPID.Ki = data[3];
+  motorLeftPID.Kd = 0;
+  motorRightFFGain = data[4];
+  motorRightFFOffset = data[5];
+  motorRightPID.Kp = data[6];
+  motorRightPID.Ki = data[7];
+  motorRightPID.Kd = 0;
+  feedForward = true;
+  CONSOLE.print("motor tuning loaded: Kp=");
+  CONSOLE.print(motorLeftPID.Kp);
+  CONSOLE.print(",");
+  CONSOLE.print(motorRightPID.Kp);
+  CONSOLE.print(" Ki=");
+  CONSOLE.print(motorLeftPID.Ki);
+  CONSOLE.print(",");
+  CONSOLE.println(motorRightPID.Ki);
+}
+
+void Motor::saveTuning(){
+  float data[8] = { motorLeftFFGain, motorLeftFFOffset, motorLeftPID.Kp, motorLeftPID.Ki,
+                    motorRightFFGain, motorRightFFOffset, motorRightPID.Kp, motorRightPID.Ki };
+  storage.save(STORAGE_ADDR_MOTOR, data, sizeof(data));
+}
+
+// PWM for set speed (feed-forward model)
+int Motor::feedForwardPWM(float rpmSet, float gain, float offset){
+  if (fabs(rpmSet) < 0.01) return 0;
+  float pwm = offset + fabs(rpmSet) / gain;
+  if (rpmSet < 0) pwm *= -1;
+  return (int)pwm;
+}
+
+
 void Motor::control(){  
   /*CONSOLE.print("rpm set=");
   CONSOLE.print(motorLeftRpmSet);
@@ -387,9 +519,17 @@ void Motor::control(){
   motorLeftPID.w  = motorLeftRpmSet;
   motorLeftPID.y_min = -pwmMax;
   motorLeftPID.y_max = pwmMax;
-  motorLeftPID.max_output = pwmMax;
-  motorLeftPID.compute();
-  motorLeftPWMCurr = motorLeftPWMCurr + motorLeftPID.y;
+  if (feedForward) {
+    // feed-forward + PI correction (integral limited to PWM range)
+    motorLeftPID.max_output = pwmMax / max(0.001, motorLeftPID.Ki * TUNE_CONTROL_TIME);
+    motorLeftPID.compute();
+    motorLeftPWMCurr = feedForwardPWM(motorLeftRpmSet, motorLeftFFGain, motorLeftFFOffset) + motorLeftPID.y;
+    if (fabs(motorLeftRpmSet) < 0.01) motorLeftPID.reset();  // no integral wind-up while stopped
+  } else {
+    motorLeftPID.max_output = pwmMax;
+    motorLeftPID.compute();
+    motorLeftPWMCurr = motorLeftPWMCurr + motorLeftPID.y;
+  }
   if (motorLeftRpmSet >= 0) motorLeftPWMCurr = min( max(0, (int)motorLeftPWMCurr), pwmMax); // 0.. pwmMax
   if (motorLeftRpmSet < 0) motorLeftPWMCurr = max(-pwmMax, min(0, (int)motorLeftPWMCurr));  // -pwmMax..0
   
@@ -397,9 +537,16 @@ void Motor::control(){
   motorRightPID.w = motorRightRpmSet;
   motorRightPID.y_min = -pwmMax;
   motorRightPID.y_max = pwmMax;
-  motorRightPID.max_output = pwmMax;
-  motorRightPID.compute();
-  motorRightPWMCurr = motorRightPWMCurr + motorRightPID.y;
+  if (feedForward) {
+    motorRightPID.max_output = pwmMax / max(0.001, motorRightPID.Ki * TUNE_CONTROL_TIME);
+    motorRightPID.compute();
+    motorRightPWMCurr = feedForwardPWM(motorRightRpmSet, motorRightFFGain, motorRightFFOffset) + motorRightPID.y;
+    if (fabs(motorRightRpmSet) < 0.01) motorRightPID.reset();  // no integral wind-up while stopped
+  } else {
+    motorRightPID.max_output = pwmMax;
+    motorRightPID.compute();
+    motorRightPWMCurr = motorRightPWMCurr + motorRightPID.y;
+  }
   if (motorRightRpmSet >= 0) motorRightPWMCurr = min( max(0, (int)motorRightPWMCurr), pwmMax);  // 0.. pwmMax
   if (motorRightRpmSet < 0) motorRightPWMCurr = max(-pwmMax, min(0, (int)motorRightPWMCurr));   // -pwmMax..0  
 
@@ -461,3 +608,141 @@ void Motor::test(){
   speedPWM(MOTOR_RIGHT, 0);  
   CONSOLE.println("motor test done");
 }
+
+
+// drive both wheels with constant PWM, measure speed (rpm) per sample and steady-state speed
+void Motor::tuneStep(int pwm, float *rpmLeft, float *rpmRight, float &steadyLeft, float &steadyRight){
+  uint16_t windowLeft[TUNE_WINDOW];
+  uint16_t windowRight[TUNE_WINDOW];
+  memset(windowLeft, 0, sizeof(windowLeft));
+  memset(windowRight, 0, sizeof(windowRight));
+  uint16_t sumLeft = 0;
+  uint16_t sumRight = 0;
+  steadyLeft = 0;
+  steadyRight = 0;
+  speedPWM(MOTOR_LEFT, pwm);
+  speedPWM(MOTOR_RIGHT, pwm);
+  odoTicksLeft = 0;
+  odoTicksRight = 0;
+  float scale = 60000.0 / ((float)ticksPerRevolution) / ((float)(TUNE_WINDOW * TUNE_SAMPLE_TIME));  // ticks per window => rpm
+  unsigned long nextSampleTime = millis() + TUNE_SAMPLE_TIME;
+  for (int i=0; i < TUNE_STEP_SAMPLES; i++){
+    while (millis() < nextSampleTime) delay(1);
+    nextSampleTime += TUNE_SAMPLE_TIME;
+    uint16_t ticksLeft = odoTicksLeft;
+    odoTicksLeft = 0;
+    uint16_t ticksRight = odoTicksRight;
+    odoTicksRight = 0;
+    int idx = i % TUNE_WINDOW;
+    sumLeft += ticksLeft - windowLeft[idx];
+    sumRight += ticksRight - windowRight[idx];
+    windowLeft[idx] = ticksLeft;
+    windowRight[idx] = ticksRight;
+    float left = ((float)sumLeft) * scale;
+    float right = ((float)sumRight) * scale;
+    if (rpmLeft != NULL) rpmLeft[i] = left;
+    if (rpmRight != NULL) rpmRight[i] = right;
+    if (i >= TUNE_STEP_SAMPLES - TUNE_STEADY_SAMPLES){
+      steadyLeft += left / TUNE_STEADY_SAMPLES;
+      steadyRight += right / TUNE_STEADY_SAMPLES;
+    }
+    sense();
+    watchdogReset();
+  }
+}
+
+// first order plus dead time model from step response (two-point method: 28% and 63% rise),
+// PI gains by IMC tuning, feed-forward model from steady-state speeds
+bool Motor::identify(const char *name, const float *rpm, float rpmLow, float rpmHigh, int pwmLow, int pwmHigh, 
+                     float &gain, float &offset, float &kp, float &ki){
+  CONSOLE.print("motor tuning ");
+  CONSOLE.print(name);
+  float delta = rpmHigh - rpmLow;
+  if ((rpmLow < 1.0) || (delta < 1.0)){
+    CONSOLE.println(": no speed change - check odometry!");
+    return false;
+  }
+  float t28 = -1;
+  float t63 = -1;
+  for (int i=0; i < TUNE_STEP_SAMPLES; i++){
+    // sample time minus half the measurement window (delay of windowed speed)
+    float t = ((float)((i+1) * TUNE_SAMPLE_TIME) - 0.5 * TUNE_WINDOW * TUNE_SAMPLE_TIME) / 1000.0;
+    if ((t28 < 0) && (rpm[i] >= rpmLow + 0.283 * delta)) t28 = t;
+    if ((t63 < 0) && (rpm[i] >= rpmLow + 0.632 * delta)) t63 = t;
+  }
+  if (t63 < 0){
+    CONSOLE.println(": speed does not settle");
+    return false;
+  }
+  float timeConst = max(0.02, 1.5 * (t63 - t28));
+  float deadTime = max(0.0, t63 - timeConst);
+  gain = delta / ((float)(pwmHigh - pwmLow));
+  offset = ((float)pwmLow) - rpmLow / gain;
+  // closed loop time constant: faster than open loop, but not below dead time and control period
+  float lambda = max(max(0.5 * timeConst, 2.0 * deadTime), 2.0 * TUNE_CONTROL_TIME);
+  kp = timeConst / (gain * (lambda + deadTime));
+  ki = kp / timeConst;
+  CONSOLE.print(": gain=");
+  CONSOLE.print(gain, 4);
+  CONSOLE.print(" offset=");
+  CONSOLE.print(offset);
+  CONSOLE.print(" T=");
+  CONSOLE.print(timeConst, 3);
+  CONSOLE.print(" L=");
+  CONSOLE.print(deadTime, 3);
+  CONSOLE.print(" Kp=");
+  CONSOLE.print(kp, 4);
+  CONSOLE.print(" Ki=");
+  CONSOLE.println(ki, 4);
+  return true;
+}
+
+// identify wheel motors by PWM step (wheels must be lifted), compute feed-forward model and PI gains
+bool Motor::autoTune(){
+  CONSOLE.println("motor tuning - wheels must be lifted off the ground");
+  stopImmediately(true);
+  int pwmLow = pwmMax * TUNE_PWM_LOW;
+  int pwmHigh = pwmMax * TUNE_PWM_HIGH;
+  float rpmLeft[TUNE_STEP_SAMPLES];
+  float rpmRight[TUNE_STEP_SAMPLES];
+  float lowLeft;
+  float lowRight;
+  float highLeft;
+  float highRight;
+  tuneStep(pwmLow, NULL, NULL, lowLeft, lowRight);
+  tuneStep(pwmHigh, rpmLeft, rpmRight, highLeft, highRight);
+  speedPWM(MOTOR_LEFT, 0);
+  speedPWM(MOTOR_RIGHT, 0);
+  float gainLeft;
+  float offsetLeft;
+  float gainRight;
+  float offsetRight;
+  float kpLeft;
+  float kiLeft;
+  float kpRight;
+  float kiRight;
+  bool ok = identify("left", rpmLeft, lowLeft, highLeft, pwmLow, pwmHigh, gainLeft, offsetLeft, kpLeft, kiLeft);
+  ok = identify("right", rpmRight, lowRight, highRight, pwmLow, pwmHigh, gainRight, offsetRight, kpRight, kiRight) && ok;
+  if (!ok) {
+    CONSOLE.println("motor tuning failed");
+    return false;
+  }
+  motorLeftFFGain = gainLeft;
+  motorLeftFFOffset = offsetLeft;
+  motorLeftPID.Kp = kpLeft;
+  motorLeftPID.Ki = kiLeft;
+  motorLeftPID.Kd = 0;
+  motorLeftPID.reset();
+  motorRightFFGain = gainRight;
+  motorRightFFOffset = offsetRight;
+  motorRightPID.Kp = kpRight;
+  motorRightPID.Ki = kiRight;
+  motorRightPID.Kd = 0;
+  motorRightPID.reset();
+  motorLeftPWMCurr = 0;
+  motorRightPWMCurr = 0;
+  feedForward = true;
+  saveTuning();
+  CONSOLE.println("motor tuning done");
+  return true;
+}
@@ -20,6 +20,8 @@ class Motor {
     int wheelDiameter;   // wheel diameter (mm)
     int ticksPerRevolution; // ticks per revolution
     float ticksPerCm;  // ticks per cm
+    float odometryScaleLeft;  // true/nominal wheel distance (odometry calibration)
+    float odometryScaleRight;
     bool toggleMowDir; // toggle mowing motor direction each mow motor start?    
     bool motorLeftSwapDir;
     bool motorRightSwapDir;
@@ -40,19 +42,27 @@ class Motor {
     float motorLeftSenseLP; // left motor current low-pass
     float motorRightSenseLP; // right  motor current low-pass
     float motorMowSenseLP;  // mower motor current low-pass        
+    float motorMowRpmCurr;  // mower motor speed (rpm)
+    float motorMowRpmNoLoad; // mower motor speed without load (rpm)
+    float mowLoad;          // mowing load (1: target load)
+    float mowSpeedFactor;   // ground speed factor for mowing load (ADAPTIVE_SPEED)
+    float motorLeftRpmSet; // set speed
+    float motorRightRpmSet;    
+    float motorLeftRpmCurr;  // measured speed (ticks)
+    float motorRightRpmCurr;
+    bool feedForward;       // tuned feed-forward + PI speed control (autoTune), otherwise incremental PID
     void begin();
     void run();      
     void test();
+    bool autoTune();
+    void resetTuning();
+    void saveTuning();
     void setLinearAngularSpeed(float linear, float angular);
     void setMowState(bool switchOn);
     void stopControl();
     void stopImmediately(bool includeMowerMotor);
     void resetFault();
   protected:                 
-    float motorLeftRpmSet; // set speed
-    float motorRightRpmSet;    
-    float motorLeftRpmCurr;
-    float motorRightRpmCurr;
     bool motorMowForwardSet; 
     float motorMowPWMSet; 
     float motorMowPWMCurr; 
@@ -60,6 +70,8 @@ class Motor {
     int motorRightPWMCurr;    
     unsigned long lastControlTime;    
     unsigned long nextSenseTime;            
+    unsigned long lastMowRpmTime;
+    int motorMowTicks;
     bool resetMotorFault;
     int resetMotorFaultCounter;
     unsigned long nextResetMotorFaultTime;
@@ -67,6 +79,10 @@ class Motor {
     int motorRightTicksZero;    
     PID motorLeftPID;
     PID motorRightPID;        
+    float motorLeftFFGain;    // feed-forward model: rpm per PWM above offset
+    float motorLeftFFOffset;  // feed-forward model: PWM to start turning
+    float motorRightFFGain;
+    float motorRightFFOffset;
     bool setLinearAngularSpeedTimeoutActive;
     unsigned long setLinearAngularSpeedTimeout;    
     void speedPWM ( MotorSelect motor, int speedPWM );
@@ -74,6 +90,13 @@ class Motor {
     void control();    
     void checkFault();
     void sense();
+    void senseMowRpm();
+    void adaptMowSpeed(float deltaTimeSec);
+    int feedForwardPWM(float rpmSet, float gain, float offset);
+    void tuneStep(int pwm, float *rpmLeft, float *rpmRight, float &steadyLeft, float &steadyRight);
+    bool identify(const char *name, const float *rpm, float rpmLow, float rpmHigh, int pwmLow, int pwmHigh, 
+                  float &gain, float &offset, float &kp, float &ki);
+    void loadTuning();
     
 };
 
@@ -0,0 +1,167 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "mowindex.h"
+#include "map.h"
+#include "config.h"
+
+
+#define MOW_INDEX_CELL_POINTS   8      // average points per cell
+#define MOW_INDEX_MAX_CELLS     1024
+
+
+MowIndex::MowIndex(){
+  valid = false;
+  count = 0;
+  mowedCount = 0;
+  mowed = NULL;
+  cellStart = NULL;
+  cellPoints = NULL;
+  cellUnmowed = NULL;
+}
+
+void MowIndex::clear(){
+  free(mowed);
+  free(cellStart);
+  free(cellPoints);
+  free(cellUnmowed);
+  mowed = NULL;
+  cellStart = NULL;
+  cellPoints = NULL;
+  cellUnmowed = NULL;
+  valid = false;
+  count = 0;
+  mowedCount = 0;
+}
+
+int MowIndex::cellOf(float x, float y){
+  int cx = (int)((x - minX) / cellSize);
+  int cy = (int)((y - minY) / cellSize);
+  cx = max(0, min(cellsX-1, cx));
+  cy = max(0, min(cellsY-1, cy));
+  return cy * cellsX + cx;
+}
+
+// bucket sort points into grid cells (cells roughly square, bounding box of points)
+bool MowIndex::build(const pt_t *points, int pointCount){
+  clear();
+  if (pointCount <= 0) return false;
+  pts = points;
+  minX = points[0].x;
+  minY = points[0].y;
+  float maxX = minX;
+  float maxY = minY;
+  for (int i=1; i < pointCount; i++){
+    minX = min(minX, points[i].x);
+    minY = min(minY, points[i].y);
+    maxX = max(maxX, points[i].x);
+    maxY = max(maxY, points[i].y);
+  }
+  float width = max(maxX - minX, 0.1f);
+  float height = max(maxY - minY, 0.1f);
+  int cells = max(1, min(MOW_INDEX_MAX_CELLS, pointCount / MOW_INDEX_CELL_POINTS));
+  cellSize = sqrt(width * height / cells);
+  cellSize = max(cellSize, max(width, height) / MOW_INDEX_MAX_CELLS);
+  cellsX = min(MOW_INDEX_MAX_CELLS, (int)(width / cellSize) + 1);
+  cellsY = max(1, min(MOW_INDEX_MAX_CELLS / cellsX, (int)(height / cellSize) + 1));
+  cellSize = max(cellSize, max(width / cellsX, height / cellsY) * 1.001f);
+  cells = cellsX * cellsY;
+  mowed = (uint8_t*)malloc((pointCount + 7) / 8);
+  cellStart = (short*)malloc((cells + 1) * sizeof(short));
+  cellPoints = (short*)malloc(pointCount * sizeof(short));
+  cellUnmowed = (short*)malloc(cells * sizeof(short));
+  if ((mowed == NULL) || (cellStart == NULL) || (cellPoints == NULL) || (cellUnmowed == NULL)){
+    CONSOLE.println("mowing point index: out of memory");
+    clear();
+    return false;
+  }
+  // count points per cell, prefix sums, then fill (stable: mowing order within cell)
+  memset(cellUnmowed, 0, cells * sizeof(short));
+  for (int i=0; i < pointCount; i++) cellUnmowed[cellOf(points[i].x, points[i].y)]++;
+  cellStart[0] = 0;
+  for (int c=0; c < cells; c++) cellStart[c+1] = cellStart[c] + cellUnmowed[c];
+  memset(cellUnmowed, 0, cells * sizeof(short));
+  for (int i=0; i < pointCount; i++){
+    int c = cellOf(points[i].x, points[i].y);
+    cellPoints[cellStart[c] + cellUnmowed[c]] = i;
+    cellUnmowed[c]++;
+  }
+  memset(mowed, 0, (pointCount + 7) / 8);
+  count = pointCount;
+  mowedCount = 0;
+  valid = true;
+  return true;
+}
+
+bool MowIndex::isMowed(int idx){
+  if ((!valid) || (idx < 0) || (idx >= count)) return false;
+  return (mowed[idx >> 3] & (1 << (idx & 7))) != 0;
+}
+
+void MowIndex::setMowed(int idx, bool flag){
+  if ((!valid) || (idx < 0) || (idx >= count)) return;
+  if (isMowed(idx) == flag) return;
+  int c = cellOf(pts[idx].x, pts[idx].y);
+  if (flag){
+    mowed[idx >> 3] |= (1 << (idx & 7));
+    cellUnmowed[c]--;
+    mowedCount++;
+  } else {
+    mowed[idx >> 3] &= ~(1 << (idx & 7));
+    cellUnmowed[c]++;
+    mowedCount--;
+  }
+}
+
+void MowIndex::setProgress(int idx){
+  for (int i=0; i < count; i++) setMowed(i, (i < idx));
+}
+
+int MowIndex::nextUnmowed(int idx){
+  if (!valid) return -1;
+  for (int i=max(0, idx); i < count; i++){
+    if (mowed[i >> 3] == 0xFF) {
+      i |= 7;   // skip mowed byte
+      continue;
+    }
+    if (!isMowed(i)) return i;
+  }
+  return -1;
+}
+
+// search cells in rings (Chebyshev distance r) around position cell until no closer point is possible
+int MowIndex::nearestUnmowed(float x, float y){
+  if ((!valid) || (mowedCount >= count)) return -1;
+  int c = cellOf(x, y);
+  int cx0 = c % cellsX;
+  int cy0 = c / cellsX;
+  int best = -1;
+  float bestDistSq = 0;
+  int maxRing = max(cellsX, cellsY);
+  for (int r=0; r <= maxRing; r++){
+    // cells of ring r are at least (r-1) cells away from position
+    if ((best >= 0) && (r > 1) && (sq((r-1) * cellSize) > bestDistSq)) break;
+    for (int cy=cy0-r; cy <= cy0+r; cy++){
+      if ((cy < 0) || (cy >= cellsY)) continue;
+      // only ring cells: full row on top/bottom, left/right cell otherwise
+      int step = ((cy == cy0-r) || (cy == cy0+r)) ? 1 : max(1, 2*r);
+      for (int cx=cx0-r; cx <= cx0+r; cx += step){
+        if ((cx < 0) || (cx >= cellsX)) continue;
+        int cell = cy * cellsX + cx;
+        if (cellUnmowed[cell] == 0) continue;
+        for (int k=cellStart[cell]; k < cellStart[cell+1]; k++){
+          int i = cellPoints[k];
+          if (isMowed(i)) continue;
+          float distSq = sq(pts[i].x - x) + sq(pts[i].y - y);
+          if ((best < 0) || (distSq < bestDistSq)){
+            best = i;
+            bestDistSq = distSq;
+          }
+        }
+      }
+    }
+  }
+  return best;
+}
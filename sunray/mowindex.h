@@ -0,0 +1,51 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// spatial index over the mowing points: uniform grid (points bucket-sorted into cells, about 
+// MOW_INDEX_CELL_POINTS per cell) with a mowed flag per point and an unmowed counter per cell -
+// the nearest unmowed point is found by searching the cells in rings around the position, 
+// skipping mowed-out cells
+
+#ifndef MOWINDEX_H
+#define MOWINDEX_H
+
+#include <Arduino.h>
+
+struct pt_t;
+
+
+class MowIndex {
+  public:
+    bool valid;
+    int count;          // indexed points
+    int mowedCount;
+    MowIndex();
+    // index points (all unmowed) - false if not enough memory
+    bool build(const pt_t *points, int pointCount);
+    void clear();
+    bool isMowed(int idx);
+    void setMowed(int idx, bool flag);
+    // mark points before idx mowed, others unmowed
+    void setProgress(int idx);
+    // first unmowed point from idx on (-1: none)
+    int nextUnmowed(int idx);
+    // unmowed point nearest to position (-1: none)
+    int nearestUnmowed(float x, float y);
+  protected:
+    const pt_t *pts;
+    uint8_t *mowed;       // bit per point
+    short *cellStart;     // first entry of cell in cellPoints (cellsX*cellsY+1 entries)
+    short *cellPoints;    // point indices sorted by cell
+    short *cellUnmowed;   // unmowed points per cell
+    int cellsX;
+    int cellsY;
+    float minX;
+    float minY;
+    float cellSize;
+    int cellOf(float x, float y);
+};
+
+
+#endif
@@ -0,0 +1,165 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "odometry.h"
+#include "config.h"
+#include "helper.h"
+#include "robot.h"
+#include "storage.h"
+
+
+#define ODO_SEGMENT_MIN      50.0    // min. GPS segment length (cm) 
+#define ODO_SEGMENT_MAX      150.0   // max. GPS segment length (cm), longer: position jump
+#define ODO_STRAIGHT_RATIO   0.05    // max. |dr-dl|/(dr+dl) for distance observation
+#define ODO_TURN_MIN         0.3     // min. course change (rad) to observe wheel base
+#define ODO_TURN_MAX_DIST    500.0   // max. wheel distance (cm) between straight segments
+#define ODO_VAR_DIST         4.0     // distance observation variance (cm^2)
+#define ODO_VAR_HEADING      25.0    // heading observation variance (cm^2)
+#define ODO_FORGET           0.9995  // forgetting factor
+#define ODO_MIN_UPDATES      200     // observations before estimate is applied
+#define ODO_SCALE_LIMIT      0.15    // max. scale deviation from nominal
+#define ODO_WHEELBASE_LIMIT  0.2     // max. wheel base deviation from nominal
+
+
+void OdometryCalibration::begin(){
+  enabled = ODOMETRY_CALIBRATION;
+  scaleLeft = 1.0;
+  scaleRight = 1.0;
+  wheelBaseCm = WHEEL_BASE_CM;
+  updates = 0;
+  changed = false;
+  if (enabled) load();
+  theta[0] = scaleLeft;
+  theta[1] = scaleRight;
+  theta[2] = wheelBaseCm;
+  memset(P, 0, sizeof(P));
+  P[0][0] = 1e-3;
+  P[1][1] = 1e-3;
+  P[2][2] = 10.0;
+  reset();
+}
+
+void OdometryCalibration::reset(){
+  havePos = false;
+  haveSegment = false;
+  betweenLeft = 0;
+  betweenRight = 0;
+}
+
+void OdometryCalibration::addOdometry(float distLeft, float distRight){
+  accLeft += distLeft;
+  accRight += distRight;
+}
+
+// RLS update with observation y = h' * theta (variance r)
+void OdometryCalibration::update(const float h[3], float y, float r){
+  float Ph[3];
+  for (int i=0; i < 3; i++) Ph[i] = P[i][0]*h[0] + P[i][1]*h[1] + P[i][2]*h[2];
+  float s = ODO_FORGET * r + h[0]*Ph[0] + h[1]*Ph[1] + h[2]*Ph[2];
+  if (s <= 0) return;
+  float err = y - (h[0]*theta[0] + h[1]*theta[1] + h[2]*theta[2]);
+  for (int i=0; i < 3; i++) theta[i] += Ph[i] / s * err;
+  for (int i=0; i < 3; i++){
+    for (int j=0; j < 3; j++) P[i][j] = (P[i][j] - Ph[i] * Ph[j] / s) / ODO_FORGET;
+  }
+  // keep estimate plausible
+  theta[0] = constrain(theta[0], 1.0 - ODO_SCALE_LIMIT, 1.0 + ODO_SCALE_LIMIT);
+  theta[1] = constrain(theta[1], 1.0 - ODO_SCALE_LIMIT, 1.0 + ODO_SCALE_LIMIT);
+  theta[2] = constrain(theta[2], WHEEL_BASE_CM * (1.0 - ODO_WHEELBASE_LIMIT), WHEEL_BASE_CM * (1.0 + ODO_WHEELBASE_LIMIT));
+  updates++;
+}
+
+void OdometryCalibration::addPosition(float x, float y){
+  if (!enabled) return;
+  if (!havePos){
+    havePos = true;
+    lastX = x;
+    lastY = y;
+    accLeft = 0;
+    accRight = 0;
+    return;
+  }
+  float dX = (x - lastX) * 100.0;
+  float dY = (y - lastY) * 100.0;
+  float d = sqrt( sq(dX) + sq(dY) );
+  if (d < ODO_SEGMENT_MIN) return;
+  if (d > ODO_SEGMENT_MAX) {
+    reset();
+    addPosition(x, y);
+    return;
+  }
+  float course = atan2(dY, dX);
+  if (accLeft + accRight < 0){
+    // driving reverse: heading is opposite to GPS course
+    course = scalePI(course + PI);
+    d = -d;
+  }
+  // straight segment (heading constant, chord = arc)? 
+  float trueLeft = theta[0] * accLeft;
+  float trueRight = theta[1] * accRight;
+  if (fabs(trueRight - trueLeft) < ODO_STRAIGHT_RATIO * fabs(trueRight + trueLeft)){
+    // distance observation
+    float h[3] = { 0.5f * accLeft, 0.5f * accRight, 0 };
+    update(h, d, ODO_VAR_DIST);
+    // heading observation: course change between midpoints of straight segments
+    if (haveSegment){
+      float dl = prevLeft + betweenLeft + 0.5 * accLeft;
+      float dr = prevRight + betweenRight + 0.5 * accRight;
+      // GPS course change is known modulo 2*PI only (e.g. 180 degree lane turn), use odometry turn to unwrap it
+      float dTheta = distancePI(prevCourse, course);
+      float dThetaOdo = (theta[1] * dr - theta[0] * dl) / theta[2];
+      dTheta += 2*PI * round((dThetaOdo - dTheta) / (2*PI));
+      if (fabs(dTheta) >= ODO_TURN_MIN){
+        float h[3] = { -dl, dr, -dTheta };
+        update(h, 0, ODO_VAR_HEADING);
+      } else if (fabs(dl - dr) < ODO_STRAIGHT_RATIO * fabs(dl + dr)) {
+        // small course change: wheel base is not observable (noise), use estimate
+        float h[3] = { -dl, dr, 0 };
+        update(h, dTheta * theta[2], ODO_VAR_HEADING);
+      }
+    }
+    haveSegment = true;
+    prevCourse = course;
+    prevLeft = 0.5 * accLeft;
+    prevRight = 0.5 * accRight;
+    betweenLeft = 0;
+    betweenRight = 0;
+  } else {
+    betweenLeft += accLeft;
+    betweenRight += accRight;
+    if (fabs(betweenLeft) + fabs(betweenRight) > ODO_TURN_MAX_DIST) haveSegment = false;
+  }
+  lastX = x;
+  lastY = y;
+  accLeft = 0;
+  accRight = 0;
+  if (updates >= ODO_MIN_UPDATES){
+    scaleLeft = theta[0];
+    scaleRight = theta[1];
+    wheelBaseCm = theta[2];
+    changed = true;
+  }
+}
+
+void OdometryCalibration::load(){
+  float data[3];
+  if (!storage.load(STORAGE_ADDR_ODOMETRY, data, sizeof(data))) return;
+  scaleLeft = data[0];
+  scaleRight = data[1];
+  wheelBaseCm = data[2];
+  CONSOLE.print("odometry calibration loaded: scaleLeft=");
+  CONSOLE.print(scaleLeft, 4);
+  CONSOLE.print(" scaleRight=");
+  CONSOLE.print(scaleRight, 4);
+  CONSOLE.print(" wheelBaseCm=");
+  CONSOLE.println(wheelBaseCm);
+}
+
+void OdometryCalibration::save(){
+  if (!changed) return;
+  float data[3] = { scaleLeft, scaleRight, wheelBaseCm };
+  if (storage.save(STORAGE_ADDR_ODOMETRY, data, sizeof(data))) changed = false;
+}
+
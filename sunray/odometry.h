@@ -0,0 +1,55 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// online odometry calibration (left/right wheel scale, wheel base) by recursive least squares
+// using GPS fix positions on straight segments (constant heading, chord = arc):
+//   segment length:                       d  = 0.5 * (sL * dl + sR * dr)
+//   course change to last straight segment: 0  = -sL * dl + sR * dr - dTheta * B
+// (d: GPS distance, dl/dr: nominal wheel distances, dTheta: GPS course change, all linear in sL, sR, B)
+// the wheel distances between two straight segments include point turns and reverse driving, so
+// the wheel base is observed on lane turns as well (dTheta is unwrapped by the odometry estimate)
+
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <Arduino.h>
+
+
+class OdometryCalibration {
+  public:
+    bool enabled;
+    float scaleLeft;     // true/nominal left wheel distance
+    float scaleRight;    // true/nominal right wheel distance
+    float wheelBaseCm;   // effective wheel base (cm)
+    unsigned long updates;  // RLS observations
+    bool changed;        // unsaved estimate?
+    void begin();
+    // nominal wheel distances (cm) since last call
+    void addOdometry(float distLeft, float distRight);
+    // GPS fix position (m)
+    void addPosition(float x, float y);
+    // no fix: start new segment chain
+    void reset();
+    void load();
+    void save();
+  protected:
+    float theta[3];      // sL, sR, B
+    float P[3][3];       // covariance
+    bool havePos;
+    bool haveSegment;
+    float lastX;
+    float lastY;
+    float accLeft;       // wheel distances of current segment (cm)
+    float accRight;
+    float prevCourse;    // last straight segment
+    float prevLeft;      // wheel distances from its midpoint (cm)
+    float prevRight;
+    float betweenLeft;   // wheel distances of segments after it (cm)
+    float betweenRight;
+    void update(const float h[3], float y, float r);
+};
+
+
+#endif
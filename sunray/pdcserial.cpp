@@ -0,0 +1,112 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "pdcserial.h"
+#include "config.h"
+
+
+#define PDC_RX_HALF   (PDC_RX_BUFFER_SIZE/2)
+
+
+PdcSerial::PdcSerial(USARTClass &serial, Usart *usart){
+  this->serial = &serial;
+  this->usart = usart;
+  enabled = false;
+  overruns = 0;
+  frameErrors = 0;
+  maxFill = 0;
+}
+
+void PdcSerial::begin(unsigned long baud){
+  enabled = GPS_DMA;
+  serial->begin(baud);
+  if (!enabled) return;
+  // bytes are taken by the PDC, errors are polled (see service)
+  usart->US_IDR = US_IDR_RXRDY | US_IDR_OVRE | US_IDR_FRAME;
+  usart->US_PTCR = US_PTCR_RXTDIS;
+  usart->US_RPR = (uint32_t)(uintptr_t)&rxBuffer[0];
+  usart->US_RCR = PDC_RX_HALF;
+  usart->US_RNPR = (uint32_t)(uintptr_t)&rxBuffer[PDC_RX_HALF];
+  usart->US_RNCR = PDC_RX_HALF;
+  queuedTotal = PDC_RX_BUFFER_SIZE;
+  readTotal = 0;
+  usart->US_CR = US_CR_RSTSTA;
+  usart->US_PTCR = US_PTCR_RXTEN;
+}
+
+void PdcSerial::end(){
+  if (enabled) usart->US_PTCR = US_PTCR_RXTDIS;
+  serial->end();
+}
+
+// bytes received by PDC (total) - counters are read again if PDC switched to next transfer in between
+uint32_t PdcSerial::received(){
+  uint32_t rcr;
+  uint32_t rncr;
+  do {
+    rncr = usart->US_RNCR;
+    rcr = usart->US_RCR;
+  } while (rncr != usart->US_RNCR);
+  return queuedTotal - rcr - rncr;
+}
+
+// count errors, queue next half of ring once the reader has left it
+void PdcSerial::service(){
+  uint32_t status = usart->US_CSR;
+  if ((status & (US_CSR_OVRE | US_CSR_FRAME)) != 0){
+    if (status & US_CSR_OVRE) overruns++;
+    if (status & US_CSR_FRAME) frameErrors++;
+    usart->US_CR = US_CR_RSTSTA;
+  }
+  if (usart->US_RNCR != 0) return;   // next transfer still queued
+  if (queuedTotal + PDC_RX_HALF - readTotal > PDC_RX_BUFFER_SIZE) return;  // unread data in that half
+  uint32_t addr = (uint32_t)(uintptr_t)&rxBuffer[queuedTotal & (PDC_RX_BUFFER_SIZE-1)];
+  // PDC is paused while reprogramming: if the current transfer completed between checking RCR and 
+  // writing RNCR, the PDC would stay stopped (a byte arriving meanwhile waits in RHR, the pause is far
+  // shorter than one character)
+  noInterrupts();
+  usart->US_PTCR = US_PTCR_RXTDIS;
+  if (usart->US_RCR == 0){
+    // PDC stopped (ring was full) - restart
+    usart->US_RPR = addr;
+    usart->US_RCR = PDC_RX_HALF;
+  } else {
+    usart->US_RNPR = addr;
+    usart->US_RNCR = PDC_RX_HALF;
+  }
+  usart->US_PTCR = US_PTCR_RXTEN;
+  interrupts();
+  queuedTotal += PDC_RX_HALF;
+}
+
+int PdcSerial::available(){
+  if (!enabled) return serial->available();
+  service();
+  uint32_t fill = received() - readTotal;
+  if (fill > maxFill) maxFill = fill;
+  return fill;
+}
+
+int PdcSerial::peek(){
+  if (!enabled) return serial->peek();
+  if (received() == readTotal) return -1;
+  return rxBuffer[readTotal & (PDC_RX_BUFFER_SIZE-1)];
+}
+
+int PdcSerial::read(){
+  if (!enabled) return serial->read();
+  if (received() == readTotal) return -1;
+  uint8_t data = rxBuffer[readTotal & (PDC_RX_BUFFER_SIZE-1)];
+  readTotal++;
+  return data;
+}
+
+void PdcSerial::flush(){
+  serial->flush();
+}
+
+size_t PdcSerial::write(uint8_t data){
+  return serial->write(data);
+}
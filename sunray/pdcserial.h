@@ -0,0 +1,55 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  PDC (DMA) serial receive (Arduino Due USART) - used for the GPS port (GPS_DMA)
+  
+  The PDC writes received bytes directly into a ring buffer, the two halves of the ring are queued 
+  alternately (current + next transfer). The next half is queued as soon as the reader has left it,
+  so after each read the PDC can receive at least half a ring (2 KB: ~180 ms at 115200 baud) without
+  any CPU help. The USART interrupt belongs to the Arduino core (USART3_Handler etc.), so queueing is 
+  done by the reader (available) and receive interrupts are disabled. Transmit uses the Arduino core.
+  
+  The core's USARTClass::IrqHandler still runs on transmit interrupts (e.g. UBX configuration writes):
+  it reads RHR if RXRDY is set and clears OVRE/FRAME (RSTSTA), so while transmitting a byte may be 
+  taken into the core's receive buffer and overruns/frameErrors are lower bounds only.
+*/
+
+#ifndef PDCSERIAL_H
+#define PDCSERIAL_H
+
+#include <Arduino.h>
+
+#define PDC_RX_BUFFER_SIZE  4096    // receive ring (bytes, power of 2)
+
+
+class PdcSerial : public HardwareSerial {
+  public:
+    bool enabled;                // PDC receive (otherwise Arduino serial buffer)
+    unsigned long overruns;      // USART overruns (ring full, PDC stopped) - lower bound (see above)
+    unsigned long frameErrors;   // USART framing errors - lower bound (see above)
+    unsigned long maxFill;       // max. bytes waiting in ring
+    PdcSerial(USARTClass &serial, Usart *usart);
+    void begin(unsigned long baud);
+    void end();
+    int available();
+    int peek();
+    int read();
+    void flush();
+    size_t write(uint8_t data);
+    using Print::write;
+    operator bool() { return true; }
+  protected:
+    USARTClass *serial;
+    Usart *usart;
+    volatile uint8_t rxBuffer[PDC_RX_BUFFER_SIZE];
+    uint32_t queuedTotal;   // bytes of ring queued to PDC (total)
+    uint32_t readTotal;     // bytes read (total)
+    uint32_t received();
+    void service();
+};
+
+
+#endif
@@ -19,22 +19,40 @@
 #include "helper.h"
 #include "pid.h"
 #include "i2c.h"
-#include <NewPing.h>
+#include "sonar.h"
+#include "adcman.h"
+#include "fixmath.h"
+#include "storage.h"
+#include "odometry.h"
 #include <Arduino.h>
 
 // #define I2C_SPEED  10000
 #define _BV(x) (1 << (x))
 
 #define NO_ECHO 0
+#define SONAR_OFFSET 0.3        // sonar distance to robot center (m)
+#define SONAR_SIDE_ANGLE 0.5    // left/right sonar angle relative to robot heading (rad)
+#define PROFILE_MIN_SPEED 0.1   // velocity profile: min. speed approaching a waypoint (m/s)
+#define SLIP_SPEED 0.1          // max. speed after wheel slip was detected (m/s)
+#define SLIP_SLOW_TIME 3000     // drive slowly for this time after wheel slip (ms)
 
 MPU9250_DMP imu;
 Motor motor;
 Battery battery;
 PinManager pinMan;
-UBLOX gps(GPS,GPS_BAUDRATE);
+PdcSerial gpsSerial(GPS,GPS_USART);
+UBLOX gps(gpsSerial,GPS_BAUDRATE);
+Storage storage;
+OdometryCalibration odometryCalibration;
+MotionDetector motionDetector;
+LineTracker lineTracker;
+Mission mission;
+Timetable timetable;
+MapValidator mapValidator;
 BLEConfig bleConfig;
 Buzzer buzzer;
 Map maps;
+Sonar sonar;
 HTU21D myHumidity;
 PID pidLine(0.2, 0.01, 0); // not used
 PID pidAngle(2, 0.1, 0);  // not used
@@ -42,6 +60,7 @@ PID pidAngle(2, 0.1, 0);  // not used
 OperationType stateOp = OP_IDLE; // operation-mode
 Sensor stateSensor = SENS_NONE; // last triggered sensor
 unsigned long controlLoops = 0;
+unsigned long controlDuration = 0; // accumulated line tracking duration (us)
 float stateX = 0;  // position-east (m)
 float stateY = 0;  // position-north (m)
 float stateDelta = 0;  // direction (rad)
@@ -60,12 +79,18 @@ int fixTimeout = 0;
 bool absolutePosSource = false;
 double absolutePosSourceLon = 0;
 double absolutePosSourceLat = 0;
+int64_t absolutePosSourceLonE9 = 0;
+int64_t absolutePosSourceLatE9 = 0;
+float absolutePosSourceMetersPerLonE9 = 0;  // local tangent plane projection (meters per 1e-9 deg)
+float absolutePosSourceMetersPerLatE9 = 0;
 bool finishAndRestart = false;
 bool resetLastPos = true;
 bool rotateLeft = false;
 bool rotateRight = false;
 bool angleToTargetFits = false;
 bool targetReached = false;
+bool transitionAligned = false; // heading aligned with transition curve (no rotation needed)?
+unsigned long slipSlowTime = 0; // drive slowly until this time (wheel slip)
 bool stateChargerConnected = false;
 float rollChange = 0;
 float pitchChange = 0;
@@ -111,7 +136,8 @@ bool foundDockSignal = true;
 float dockAngularSpeed = 0.1;
 
 
-unsigned long nextSonarTime=0;
+unsigned long lastSonarMeasurements = 0;
+unsigned long profileTime = 0; // velocity profile: time of last speed update
 unsigned int sonarDistCenter;
 unsigned int sonarDistRight;
 unsigned int sonarDistLeft;
@@ -271,8 +297,11 @@ void readIMU(){
   //CONSOLE.print("duration:");
   //CONSOLE.println(duration);  
   if (duration > 10){
-    CONSOLE.print("ERROR IMU timeout: ");
-    CONSOLE.println(duration);          
+    if (binLog.enabled) binLog.log(LOG_IMU_TIMEOUT, duration);
+    else {
+      CONSOLE.print("ERROR IMU timeout: ");
+      CONSOLE.println(duration);          
+    }
     motor.stopImmediately(true);    
     startIMU(true); // restart I2C bus
     statImuRecoveries++;
@@ -299,17 +328,21 @@ void readIMU(){
         //CONSOLE.println(pitchChange/PI*180.0);
         if ( (fabs(scalePI(imu.roll)) > 60.0/180.0*PI) || (fabs(scalePI(imu.pitch)) > 100.0/180.0*PI)
              || (fabs(rollChange) > 30.0/180.0*PI) || (fabs(pitchChange) > 60.0/180.0*PI)   )  {
-          CONSOLE.println("ERROR IMU tilt");
-          CONSOLE.print("imu ypr=");
-          CONSOLE.print(imu.yaw/PI*180.0);
-          CONSOLE.print(",");
-          CONSOLE.print(imu.pitch/PI*180.0);
-          CONSOLE.print(",");
-          CONSOLE.print(imu.roll/PI*180.0);
-          CONSOLE.print(" rollChange=");
-          CONSOLE.print(rollChange/PI*180.0);
-          CONSOLE.print(" pitchChange=");
-          CONSOLE.println(pitchChange/PI*180.0);
+          if (binLog.enabled) binLog.log(LOG_IMU_TILT, (float)(imu.yaw/PI*180.0), (float)(imu.pitch/PI*180.0), 
+                   (float)(imu.roll/PI*180.0), (float)(rollChange/PI*180.0), (float)(pitchChange/PI*180.0));
+          else {
+            CONSOLE.println("ERROR IMU tilt");
+            CONSOLE.print("imu ypr=");
+            CONSOLE.print(imu.yaw/PI*180.0);
+            CONSOLE.print(",");
+            CONSOLE.print(imu.pitch/PI*180.0);
+            CONSOLE.print(",");
+            CONSOLE.print(imu.roll/PI*180.0);
+            CONSOLE.print(" rollChange=");
+            CONSOLE.print(rollChange/PI*180.0);
+            CONSOLE.print(" pitchChange=");
+            CONSOLE.println(pitchChange/PI*180.0);
+          }
           stateSensor = SENS_IMU_TILT;
           setOperation(OP_ERROR);
         }           
@@ -318,6 +351,7 @@ void readIMU(){
       lastIMUYaw = scalePI(lastIMUYaw);
       lastIMUYaw = scalePIangles(lastIMUYaw, imu.yaw);
       stateDeltaIMU = scalePI ( distancePI(imu.yaw, lastIMUYaw) );  
+      motionDetector.addYawIMU(stateDeltaIMU);
       //CONSOLE.print(imu.yaw);
       //CONSOLE.print(",");
       //CONSOLE.print(stateDeltaIMU/PI*180.0);
@@ -356,10 +390,6 @@ bool checkAT24C32() {
   return (r == 1);
 }
 
-NewPing NewSonarLeft(pinSonarLeftTrigger, pinSonarLeftEcho, 110);
-NewPing NewSonarRight(pinSonarRightTrigger, pinSonarRightEcho, 110);
-NewPing NewSonarCenter(pinSonarCenterTrigger, pinSonarCenterEcho, 110);
-
 // robot start routine
 void start(){  
   pinMan.begin();       
@@ -369,6 +399,7 @@ void start(){
   digitalWrite(pinBatterySwitch, HIGH);       
   buzzer.begin();      
   CONSOLE.begin(CONSOLE_BAUDRATE);  
+  binLog.begin();
   Wire.begin();      
   unsigned long timeout = millis() + 2000;
   while (millis() < timeout){
@@ -383,12 +414,20 @@ void start(){
   }  
   delay(1500);
   CONSOLE.println(VER);          
+  ADCMan.begin();
   battery.begin();      
   
   bleConfig.run();   
   BLE.println(VER);  
     
   motor.begin();
+  odometryCalibration.begin();
+  motionDetector.begin();
+  lineTracker.begin();
+  mission.begin();
+  timetable.begin();
+  mapValidator.begin();
+  sonar.begin();
   gps.begin();   
   maps.begin();
   
@@ -422,6 +461,7 @@ void calcStats(){
           lastSolution = gps.solution;
         } 
         statMowMaxDgpsAge = max(statMowMaxDgpsAge, (millis() - gps.dgpsAge)/1000.0);        
+        battery.dockDistance = maps.distanceToDock(stateX, stateY);
         break;
       case OP_CHARGE:
         statChargeDuration++;
@@ -431,6 +471,16 @@ void calcStats(){
 }
 
 
+// compute local tangent plane projection at absolute position source (once, when source is set)
+// uses same sphere radius as distanceLL, so positions match the previous relativeLL conversion
+void updateAbsolutePosSource(){
+  absolutePosSourceLonE9 = (int64_t)(absolutePosSourceLon * 1e9 + ((absolutePosSourceLon >= 0) ? 0.5 : -0.5));
+  absolutePosSourceLatE9 = (int64_t)(absolutePosSourceLat * 1e9 + ((absolutePosSourceLat >= 0) ? 0.5 : -0.5));
+  double metersPerLatE9 = 6372795.0 * PI / 180.0 * 1e-9; 
+  absolutePosSourceMetersPerLatE9 = metersPerLatE9;
+  absolutePosSourceMetersPerLonE9 = metersPerLatE9 * cos(deg2rad(absolutePosSourceLat));
+}
+
 // compute robot state (x,y,delta)
 // uses complementary filter ( https://gunjanpatel.wordpress.com/2016/07/07/complementary-filter-design/ )
 // to fusion GPS heading (long-term) and IMU heading (short-term)
@@ -444,13 +494,21 @@ void computeRobotState(){
     
   float distLeft = ((float)leftDelta) / ((float)motor.ticksPerCm);
   float distRight = ((float)rightDelta) / ((float)motor.ticksPerCm);  
+  // apply odometry calibration
+  odometryCalibration.addOdometry(distLeft, distRight);
+  distLeft *= odometryCalibration.scaleLeft;
+  distRight *= odometryCalibration.scaleRight;
+  motor.odometryScaleLeft = odometryCalibration.scaleLeft;
+  motor.odometryScaleRight = odometryCalibration.scaleRight;
+  motor.wheelBaseCm = odometryCalibration.wheelBaseCm;
   float distOdometry = (distLeft + distRight) / 2.0;
   float deltaOdometry = -(distLeft - distRight) / motor.wheelBaseCm;    
   
   float posN = 0;
   float posE = 0;
   if (absolutePosSource){
-    relativeLL(absolutePosSourceLat, absolutePosSourceLon, gps.lat, gps.lon, posN, posE);    
+    posN = ((float)(gps.latE9 - absolutePosSourceLatE9)) * absolutePosSourceMetersPerLatE9;
+    posE = ((float)(gps.lonE9 - absolutePosSourceLonE9)) * absolutePosSourceMetersPerLonE9;
   } else {
     posN = gps.relPosN;  
     posE = gps.relPosE;     
@@ -460,11 +518,18 @@ void computeRobotState(){
     resetLastPos = true;
   }
   
+  // odometry calibration: segment chain continues through stops, point turns and reverse, restarts on loss of FIX
+  if (gps.solutionAvail){
+    if (gps.solution == UBLOX::SOL_FIXED) odometryCalibration.addPosition(posE, posN);
+      else odometryCalibration.reset();
+  }
+  
   if ((gps.solutionAvail) 
       && ((gps.solution == UBLOX::SOL_FIXED) || (gps.solution == UBLOX::SOL_FLOAT))  )
   {
     gps.solutionAvail = false;        
     stateGroundSpeed = 0.9 * stateGroundSpeed + 0.1 * gps.groundSpeed;    
+    motionDetector.addGroundSpeed(gps.groundSpeed);
     //CONSOLE.println(stateGroundSpeed);
     float distGPS = sqrt( sq(posN-lastPosN)+sq(posE-lastPosE) );
     if ((distGPS > 0.3) || (resetLastPos)){
@@ -473,7 +538,7 @@ void computeRobotState(){
       lastPosE = posE;
     } else if (distGPS > 0.1) {       
       if ( (fabs(motor.linearSpeedSet) > 0) && (fabs(motor.angularSpeedSet) /PI *180.0 < 45) ) {  
-        stateDeltaGPS = scalePI(atan2(posN-lastPosN, posE-lastPosE));    
+        stateDeltaGPS = pointsAngle(lastPosE, lastPosN, posE, posN);    
         if (motor.linearSpeedSet < 0) stateDeltaGPS = scalePI(stateDeltaGPS + PI); // consider if driving reverse
         //stateDeltaGPS = scalePI(2*PI-gps.heading+PI/2);
         float diffDelta = distancePI(stateDelta, stateDeltaGPS);                 
@@ -508,8 +573,16 @@ void computeRobotState(){
   } 
   
   // odometry
-  stateX += distOdometry/100.0 * cos(stateDelta);
-  stateY += distOdometry/100.0 * sin(stateDelta);        
+  #if FIXED_POINT_MATH
+    float sinDelta;
+    float cosDelta;
+    fixSinCosf(stateDelta, sinDelta, cosDelta);
+    stateX += distOdometry/100.0 * cosDelta;
+    stateY += distOdometry/100.0 * sinDelta;        
+  #else
+    stateX += distOdometry/100.0 * cos(stateDelta);
+    stateY += distOdometry/100.0 * sin(stateDelta);        
+  #endif
   if (stateOp == OP_MOW) statMowDistanceTraveled += distOdometry/100.0;
   
   if ((imuFound) && (maps.useIMU)) {
@@ -523,20 +596,55 @@ void computeRobotState(){
 }
 
 
+// obstacle detected at distance (m) and angle (rad) relative to robot heading:
+// record it in the obstacle map and try to drive a detour around it (instead of stopping)
+void triggerObstacle(float dist, float angle){
+  float obstacleX = stateX + dist * cos(stateDelta + angle);
+  float obstacleY = stateY + dist * sin(stateDelta + angle);
+  int idx = maps.addObstacle(obstacleX, obstacleY);
+  motionDetector.reset();
+  if ((OBSTACLE_AVOIDANCE) && (stateOp == OP_MOW)){
+    if (maps.startDetour(idx, stateX, stateY, stateDelta)){
+      CONSOLE.println("obstacle avoidance: computing detour");
+      motor.setLinearAngularSpeed(0,0);
+      resetMotionMeasurement();
+      return;
+    }
+  }
+  stateSensor = SENS_OBSTACLE;
+  setOperation(OP_ERROR);
+  buzzer.sound(SND_STUCK, true);        
+}
+
+
+// filtered sonar distance (cm), NO_ECHO if nothing in range
 int readSensor(char type) {
   switch(type) {
-      CONSOLE.print("Sensor=");
-      CONSOLE.println(type);
-      case SEN_SONAR_CENTER: return(NewSonarCenter.ping_cm()); break;
-      case SEN_SONAR_LEFT: return(NewSonarLeft.ping_cm()); break;
-      case SEN_SONAR_RIGHT: return(NewSonarRight.ping_cm()); break;
+      case SEN_SONAR_CENTER: return(sonar.distanceCenter); break;
+      case SEN_SONAR_LEFT: return(sonar.distanceLeft); break;
+      case SEN_SONAR_RIGHT: return(sonar.distanceRight); break;
   }
+  return NO_ECHO;
 }
 // control robot velocity (linear,angular) to track line to next waypoint (target)
 // uses a stanley controller for line tracking
 // https://wiki.ardumower.de/index.php?title=Ardumower_Sunray#How_the_line_tracking_works
 // https://medium.com/@dingyan7361/three-methods-of-vehicle-lateral-control-pure-pursuit-stanley-and-mpc-db8cc1d32081
 void controlRobotVelocity(){  
+  if (maps.detourPlanning){
+    // stand still while detour is computed (one step per control cycle)
+    motor.setLinearAngularSpeed(0,0);
+    if (maps.planDetour()){
+      CONSOLE.println("obstacle avoidance: driving detour");
+      resetMotionMeasurement();
+    } else if (!maps.detourPlanning){
+      CONSOLE.println("obstacle avoidance: no detour found!");
+      stateSensor = SENS_OBSTACLE;
+      setOperation(OP_ERROR);
+      buzzer.sound(SND_STUCK, true);        
+    }
+    return;
+  }
   pt_t target = maps.targetPoint;
   pt_t lastTarget = maps.lastTargetPoint;
   float linear = 1.0;  
@@ -545,10 +653,13 @@ void controlRobotVelocity(){
   if (maps.trackReverse) targetDelta = scalePI(targetDelta + PI);
   targetDelta = scalePIangles(targetDelta, stateDelta);
   float diffDelta = distancePI(stateDelta, targetDelta);                         
-  float lateralError = distanceLine(stateX, stateY, lastTarget.x, lastTarget.y, target.x, target.y);        
+  float lateralError = maps.distanceToTargetLine(stateX, stateY);        
   float targetDist = maps.distanceToTargetPoint(stateX, stateY);
-  float lastTargetDist = maps.distanceToLastTargetPoint(stateX, stateY);  
-  if (SMOOTH_CURVES)
+  float lastTargetDistSq = sq(lastTarget.x - stateX) + sq(lastTarget.y - stateY);  
+  float targetAlong = maps.segmentDirX * (target.x - stateX) + maps.segmentDirY * (target.y - stateY);  // distance along line
+  if (maps.transitionActive)
+    targetReached = ((targetDist < 0.1) || (targetAlong <= 0));   // curve point reached or passed
+  else if (SMOOTH_CURVES)
     targetReached = (targetDist < 0.2);    
   else 
     targetReached = (targetDist < 0.05);    
@@ -584,9 +695,16 @@ void controlRobotVelocity(){
    }
   }
     
+  // transition curve: wider angle window and no steering restriction only inside the curve and once the 
+  // heading is aligned (a sharp corner before the curve or the mission start may still need a rotation)
+  bool curve = maps.transitionCurveActive();
+  if (!curve) transitionAligned = false;
+    else if (fabs(diffDelta)/PI*180.0 < 20) transitionAligned = true;
+  curve = (curve) && (transitionAligned);
+
   // allow rotations only near last or next waypoint
-  if ((targetDist < 0.5) || (lastTargetDist < 0.5)) {
-    if (SMOOTH_CURVES)
+  if ((targetDist < 0.5) || (lastTargetDistSq < 0.5*0.5)) {
+    if ((SMOOTH_CURVES) || (curve))
       angleToTargetFits = (fabs(diffDelta)/PI*180.0 < 120);          
     else     
       angleToTargetFits = (fabs(diffDelta)/PI*180.0 < 20);   
@@ -614,7 +732,15 @@ void controlRobotVelocity(){
     if (maps.trackSlow) {
       // planner forces slow tracking (e.g. docking etc)
       linear = 0.1;           
-    } else if (     ((setSpeed > 0.2) && (maps.distanceToTargetPoint(stateX, stateY) < 0.3) && (!straight))   // approaching
+    } else if (maps.velocityProfile) {
+      linear = setSpeed * motor.mowSpeedFactor;
+      if (gps.solution == UBLOX::SOL_FLOAT) linear = min(linear, 0.1f); // reduce speed for float solution
+      // brake for upcoming curves (look-ahead profile), accelerate smoothly
+      linear = min(linear, max((float)PROFILE_MIN_SPEED, maps.profileSpeed(targetDist)));
+      unsigned long t = millis();
+      linear = maps.limitAcceleration(fabs(motor.linearSpeedSet), linear, ((float)(t - profileTime)) / 1000.0);
+      profileTime = t;
+    } else if (     ((setSpeed > 0.2) && (targetDist < 0.3) && (!straight))   // approaching
           || ((linearMotionStartTime != 0) && (millis() < linearMotionStartTime + 3000))                      // leaving  
        ) 
     {
@@ -624,12 +750,18 @@ void controlRobotVelocity(){
       if (gps.solution == UBLOX::SOL_FLOAT)        
         linear = min(setSpeed, 0.1); // reduce speed for float solution
       else
-        linear = setSpeed;         // desired speed
+        linear = setSpeed * motor.mowSpeedFactor;  // desired speed (adapted to mowing load)
     }      
     //angular = 3.0 * diffDelta + 3.0 * lateralError;       // correct for path errors 
-    float k = 0.5;
-    if (maps.trackSlow) k = 0.1;
-    angular = diffDelta + atan2(k * lateralError, (0.001 + fabs(motor.linearSpeedSet)));       // correct for path errors           
+    track_t track;
+    track.lateralError = lateralError;
+    track.headingError = distancePI(stateDelta, (maps.trackReverse) ? scalePI(maps.segmentHeading + PI) : maps.segmentHeading);
+    track.targetError = diffDelta;
+    track.targetDist = targetAlong;
+    track.speed = fabs(motor.linearSpeedSet);
+    track.slow = maps.trackSlow;
+    track.reverse = maps.trackReverse;
+    angular = lineTracker.angular(track);       // correct for path errors           
     /*pidLine.w = 0;              
     pidLine.x = lateralError;
     pidLine.max_output = PI;
@@ -641,7 +773,7 @@ void controlRobotVelocity(){
     //CONSOLE.print(",");        
     //CONSOLE.println(angular/PI*180.0);            
     if (maps.trackReverse) linear *= -1;   // reverse line tracking needs negative speed
-    if (!SMOOTH_CURVES) angular = max(-PI/16, min(PI/16, angular)); // restrict steering angle for stanley
+    if ((!SMOOTH_CURVES) && (!curve)) angular = max(-PI/16, min(PI/16, angular)); // restrict steering angle for stanley
   }
   if (fixTimeout != 0){
     if (millis() > lastFixTime + fixTimeout * 1000.0){
@@ -654,53 +786,54 @@ void controlRobotVelocity(){
       if (stateSensor == SENS_GPS_FIX_TIMEOUT) stateSensor = SENS_NONE; // clear fix timeout
     }       
   }     
+  if (millis() < slipSlowTime) linear = max(-SLIP_SPEED, min(SLIP_SPEED, linear));
   motor.setLinearAngularSpeed(linear, angular);    
+  float wheelSpeedScale = PI * (motor.wheelDiameter/1000.0) / 60.0;  // rpm => m/s
+  motionDetector.run(motor.motorLeftRpmSet, motor.motorRightRpmSet, motor.motorLeftRpmCurr, motor.motorRightRpmCurr,
+        motor.motorLeftRpmCurr * wheelSpeedScale * motor.odometryScaleLeft, motor.motorRightRpmCurr * wheelSpeedScale * motor.odometryScaleRight,
+        motor.wheelBaseCm / 100.0, motor.motorLeftSenseLP, motor.motorRightSenseLP);
+  if (motionDetector.state == MOTION_SLIP){
+    // wheels spin on wet grass or slope: no obstacle ahead, slow down and keep tracking
+    CONSOLE.println("slip!");
+    slipSlowTime = millis() + SLIP_SLOW_TIME;
+    motionDetector.reset();
+  } else if (motionDetector.state != MOTION_NONE){
+    CONSOLE.print("obstacle (");
+    CONSOLE.print(motionDetector.stateName());
+    CONSOLE.println(")!");
+    if (maps.trackReverse) triggerObstacle(0.3, PI);
+      else triggerObstacle(0.3, 0);
+    return;
+  }
   if ((gps.solution == UBLOX::SOL_FIXED) || (gps.solution == UBLOX::SOL_FLOAT)){        
     if (linear > 0.06) {
       if ((millis() > linearMotionStartTime + 5000) && (stateGroundSpeed < 0.03)){
         // if in linear motion and not enough ground speed => obstacle
         CONSOLE.println("obstacle!");
-        stateSensor = SENS_OBSTACLE;
-        setOperation(OP_ERROR);
-        buzzer.sound(SND_STUCK, true);        
+        if (maps.trackReverse) triggerObstacle(0.3, PI);
+          else triggerObstacle(0.3, 0);
       }
     } else {
       resetMotionMeasurement();
     }  
   }     
-  if ((sonarUse)){
-   static char senSonarTurn = SEN_SONAR_CENTER;
-   if (millis() > nextSonarTime) {
-     nextSonarTime = millis() + 500;
-     switch(senSonarTurn) {
-       case SEN_SONAR_RIGHT:
-         if (sonarRightUse) sonarDistRight = readSensor(SEN_SONAR_RIGHT);
-         senSonarTurn = SEN_SONAR_LEFT;
-         break;
-       case SEN_SONAR_LEFT:
-         if (sonarLeftUse) sonarDistLeft = readSensor(SEN_SONAR_LEFT);
-         senSonarTurn = SEN_SONAR_CENTER;
-         break;
-       case SEN_SONAR_CENTER:
-         if (sonarCenterUse) sonarDistCenter = readSensor(SEN_SONAR_CENTER);
-         senSonarTurn = SEN_SONAR_RIGHT;
-         break;
-       default:
-         senSonarTurn = SEN_SONAR_CENTER;
-         break;
-      }
-      if (sonarDistCenter < 11 || sonarDistCenter > 100) sonarDistCenter = NO_ECHO; // Objekt ist zu nah am Sensor Wert ist unbrauchbar
-      if (sonarDistRight < 11 || sonarDistRight > 100) sonarDistRight = NO_ECHO; // Object is too close to the sensor. Sensor value is useless
-      if (sonarDistLeft < 11 || sonarDistLeft  > 100) sonarDistLeft = NO_ECHO; // Filters spiks under the possible detection limit
-
-      if ((sonarDistLeft != NO_ECHO && sonarDistLeft < sonarTriggerBelow) 
-       || (sonarDistCenter != NO_ECHO && sonarDistCenter < sonarTriggerBelow)
-       || (sonarDistRight != NO_ECHO && sonarDistRight < sonarTriggerBelow)) {
-        
-        CONSOLE.println("obstacle by ultrasonic!");
-        stateSensor = SENS_OBSTACLE;
-        setOperation(OP_ERROR);
-        buzzer.sound(SND_STUCK, true);
+  if ((sonarUse) && (!maps.trackReverse) && (!maps.detourPlanning)){
+   // sonar measurements are done in background (sonar.run), evaluate new measurements only
+   if (sonar.measurements != lastSonarMeasurements) {
+      lastSonarMeasurements = sonar.measurements;
+      sonarDistCenter = readSensor(SEN_SONAR_CENTER);
+      sonarDistLeft = readSensor(SEN_SONAR_LEFT);
+      sonarDistRight = readSensor(SEN_SONAR_RIGHT);
+      
+      if (sonarDistCenter != NO_ECHO && sonarDistCenter < sonarTriggerBelow) {
+        CONSOLE.println("obstacle by ultrasonic (center)!");
+        triggerObstacle(SONAR_OFFSET + sonarDistCenter/100.0, 0);
+      } else if (sonarDistLeft != NO_ECHO && sonarDistLeft < sonarTriggerBelow) {
+        CONSOLE.println("obstacle by ultrasonic (left)!");
+        triggerObstacle(SONAR_OFFSET + sonarDistLeft/100.0, SONAR_SIDE_ANGLE);
+      } else if (sonarDistRight != NO_ECHO && sonarDistRight < sonarTriggerBelow) {
+        CONSOLE.println("obstacle by ultrasonic (right)!");
+        triggerObstacle(SONAR_OFFSET + sonarDistRight/100.0, -SONAR_SIDE_ANGLE);
       }
       /*CONSOLE.print("sonarTriggerBelow=");
       CONSOLE.println(sonarTriggerBelow);
@@ -715,7 +848,7 @@ void controlRobotVelocity(){
    }
   }
    
-  if (targetReached){
+  if ((targetReached) && (!maps.detourPlanning)){
     bool straight = maps.nextPointIsStraight();
     if (!maps.nextPoint(false)){
       // finish        
@@ -725,7 +858,7 @@ void controlRobotVelocity(){
       } else {
         CONSOLE.println("mowing finished!");
         if (!finishAndRestart){             
-          setOperation(OP_IDLE); 
+          if (!mission.finished()) setOperation(OP_IDLE);   // mission docks
           //setOperation(OP_DOCK);             
         }                   
       }
@@ -766,6 +899,7 @@ void run(){
   buzzer.run();
   battery.run();
   motor.run();
+  sonar.run();
   maps.run();  
   
   // temp
@@ -818,13 +952,20 @@ void run(){
       }
     }
     if ((stateOp == OP_MOW) ||  (stateOp == OP_DOCK)) {      
+      unsigned long controlStartTime = micros();
       if (stateOp == OP_DOCK){
         //docking();
         controlRobotVelocity();       
       } else {
         controlRobotVelocity();       
       }      
+      controlDuration += micros() - controlStartTime;
       battery.resetIdle();
+      if ((stateOp == OP_MOW) && (!mission.enabled) && (maps.dockPointsCount > 0) && (battery.shouldGoHome())){
+        // dock while remaining charge is still enough for the path home
+        CONSOLE.println("battery low - docking");
+        setOperation(OP_DOCK);
+      }
       if (battery.underVoltage()){
         stateSensor = SENS_BAT_UNDERVOLTAGE;
         setOperation(OP_IDLE);
@@ -836,13 +977,18 @@ void run(){
         setOperation(OP_IDLE);        
       }
     }
+    mission.run();
+    timetable.run();
+    mapValidator.run();
   }    
     
   // ----- read serial input (BT/console) -------------
   processConsole();     
   processBLE();     
   processWifi();
-  outputConsole();       
+  outputConsole();
+  binLog.run();       
+  if (ENABLE_UDP) udpSerial.run((stateOp == OP_IDLE) || (stateOp == OP_CHARGE) || (stateOp == OP_ERROR));
   watchdogReset();     
 }
 
@@ -850,8 +996,11 @@ void run(){
 // set new robot operation
 void setOperation(OperationType op){  
   if (stateOp == op) return;  
-  CONSOLE.print("setOperation op=");
-  CONSOLE.println(op);
+  if (binLog.enabled) binLog.log(LOG_OPERATION, (uint8_t)op);
+  else {
+    CONSOLE.print("setOperation op=");
+    CONSOLE.println(op);
+  }
   switch (op){
     case OP_IDLE:
       motor.setLinearAngularSpeed(0,0);
@@ -860,7 +1009,7 @@ void setOperation(OperationType op){
     case OP_DOCK:
       motor.setLinearAngularSpeed(0,0);
       motor.setMowState(false);                
-      maps.startDocking();
+      maps.startDocking(stateX, stateY);
       if (maps.nextPoint(true)) {
         resetMotionMeasurement();                
         maps.setLastTargetPoint(stateX, stateY);        
@@ -873,7 +1022,7 @@ void setOperation(OperationType op){
       break;
     case OP_MOW:      
       motor.setLinearAngularSpeed(0,0);
-      maps.startMowing();
+      maps.startMowing(stateX, stateY);
       if (maps.nextPoint(true)) {
         resetMotionMeasurement();                
         maps.setLastTargetPoint(stateX, stateY);        
@@ -893,5 +1042,6 @@ void setOperation(OperationType op){
       motor.setMowState(false);
       break;
   }
+  if ((stateOp == OP_MOW) && (op != OP_MOW)) odometryCalibration.save();
   stateOp = op;  
 }
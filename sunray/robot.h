@@ -13,6 +13,16 @@
 #include "buzzer.h"
 #include "map.h"
 #include "ublox.h"
+#include "pdcserial.h"
+#include "sonar.h"
+#include "storage.h"
+#include "odometry.h"
+#include "motion.h"
+#include "linetracker.h"
+#include "mission.h"
+#include "timetable.h"
+#include "validator.h"
+#include "binlog.h"
 #include "WiFiEsp.h"
 
 
@@ -42,7 +52,6 @@ enum Sensor {
 };
 
 //sonar
-extern unsigned long nextSonarTime;
 extern unsigned int sonarDistCenter;
 extern unsigned int sonarDistRight;
 extern unsigned int sonarDistLeft;
@@ -77,6 +86,7 @@ extern WiFiEspClient client;
 extern WiFiEspServer server;
 
 extern unsigned long controlLoops;
+extern unsigned long controlDuration;
 extern bool wifiFound;
 
 extern "C" char* sbrk(int incr);
@@ -87,12 +97,22 @@ extern BLEConfig bleConfig;
 extern Buzzer buzzer;
 extern PinManager pinMan;
 extern Map maps;
+extern Sonar sonar;
 extern UBLOX gps;
+extern PdcSerial gpsSerial;
+extern Storage storage;
+extern OdometryCalibration odometryCalibration;
+extern MotionDetector motionDetector;
+extern LineTracker lineTracker;
+extern Mission mission;
+extern Timetable timetable;
+extern MapValidator mapValidator;
 
 extern int freeMemory();
 extern void start();
 extern void run();
 extern void setOperation(OperationType op);
+extern void updateAbsolutePosSource();
 
 
 #endif
@@ -0,0 +1,132 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "sonar.h"
+#include "config.h"
+#include <Arduino.h>
+
+
+#define SONAR_SLOT_TIME 16     // time slot per sensor (ms) - 3 sensors => ~20 Hz per sensor 
+#define US_ROUNDTRIP_CM 57     // echo duration per cm distance (us)
+
+const int sonarTriggerPins[SONAR_COUNT] = {pinSonarLeftTrigger, pinSonarCenterTrigger, pinSonarRightTrigger};
+const int sonarEchoPins[SONAR_COUNT] = {pinSonarLeftEcho, pinSonarCenterEcho, pinSonarRightEcho};
+
+volatile unsigned long sonarEchoStartTime[SONAR_COUNT] = {0, 0, 0};
+volatile unsigned long sonarEchoDuration[SONAR_COUNT] = {0, 0, 0};
+volatile bool sonarEchoAvail[SONAR_COUNT] = {false, false, false};
+
+
+// echo pin change interrupt: measure echo pulse width
+void sonarEcho(int idx){
+  if (digitalRead(sonarEchoPins[idx]) == HIGH){
+    sonarEchoStartTime[idx] = micros();
+  } else if (sonarEchoStartTime[idx] != 0) {
+    sonarEchoDuration[idx] = micros() - sonarEchoStartTime[idx];
+    sonarEchoStartTime[idx] = 0;
+    sonarEchoAvail[idx] = true;
+  }
+}
+
+void sonarEchoLeftInt(){
+  sonarEcho(SONAR_LEFT);
+}
+
+void sonarEchoCenterInt(){
+  sonarEcho(SONAR_CENTER);
+}
+
+void sonarEchoRightInt(){
+  sonarEcho(SONAR_RIGHT);
+}
+
+
+void Sonar::begin(){
+  enabled = sonarUse;
+  leftUse = sonarLeftUse;
+  centerUse = sonarCenterUse;
+  rightUse = sonarRightUse;
+  minDistance = 11;
+  maxDistance = 100;
+  distanceLeft = 0;
+  distanceCenter = 0;
+  distanceRight = 0;
+  measurements = 0;
+  sonarIdx = 0;
+  nextTriggerTime = 0;
+  for (int i=0; i < SONAR_COUNT; i++){
+    pinMode(sonarTriggerPins[i], OUTPUT);
+    digitalWrite(sonarTriggerPins[i], LOW);
+    pinMode(sonarEchoPins[i], INPUT);
+    filter[i].clear();
+  }
+  if (!enabled) return;
+  attachInterrupt(pinSonarLeftEcho, sonarEchoLeftInt, CHANGE);
+  attachInterrupt(pinSonarCenterEcho, sonarEchoCenterInt, CHANGE);
+  attachInterrupt(pinSonarRightEcho, sonarEchoRightInt, CHANGE);
+}
+
+bool Sonar::isUsed(int idx){
+  switch (idx){
+    case SONAR_LEFT: return leftUse;
+    case SONAR_CENTER: return centerUse;
+    case SONAR_RIGHT: return rightUse;
+  }
+  return false;
+}
+
+unsigned int Sonar::distance(SonarSelect idx){
+  switch (idx){
+    case SONAR_LEFT: return distanceLeft;
+    case SONAR_CENTER: return distanceCenter;
+    case SONAR_RIGHT: return distanceRight;
+  }
+  return 0;
+}
+
+// start measurement (10us trigger pulse)
+void Sonar::trigger(int idx){
+  sonarEchoStartTime[idx] = 0;
+  sonarEchoAvail[idx] = false;
+  digitalWrite(sonarTriggerPins[idx], HIGH);
+  delayMicroseconds(10);
+  digitalWrite(sonarTriggerPins[idx], LOW);
+}
+
+// add echo (0 = no echo) to median filter and compute filtered distance 
+void Sonar::addEcho(int idx, unsigned long echoDuration){
+  unsigned int dist = echoDuration / US_ROUNDTRIP_CM;
+  // no echo, and echos too near or too far (spikes), count as 'nothing seen'
+  if ((dist < minDistance) || (dist > maxDistance)) dist = maxDistance + 1;   
+  filter[idx].add(dist);
+  unsigned int median = 0;
+  filter[idx].getMedian(median);
+  if (median > maxDistance) median = 0;
+  switch (idx){
+    case SONAR_LEFT: distanceLeft = median; break;
+    case SONAR_CENTER: distanceCenter = median; break;
+    case SONAR_RIGHT: distanceRight = median; break;
+  }
+  measurements++;
+}
+
+void Sonar::run(){
+  if (!enabled) return;
+  if (millis() < nextTriggerTime) return;
+  nextTriggerTime = millis() + SONAR_SLOT_TIME;
+  // evaluate last time slot  
+  if (isUsed(sonarIdx)){
+    if (sonarEchoAvail[sonarIdx]) addEcho(sonarIdx, sonarEchoDuration[sonarIdx]);
+      else addEcho(sonarIdx, 0);   // no echo within time slot
+  }
+  // trigger next sensor
+  for (int i=0; i < SONAR_COUNT; i++){
+    sonarIdx = (sonarIdx + 1) % SONAR_COUNT;
+    if (isUsed(sonarIdx)) {
+      trigger(sonarIdx);
+      break;
+    }
+  }
+}
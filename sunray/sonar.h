@@ -0,0 +1,54 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  ultrasonic sensors (HC-SR04) - non-blocking ranging
+  
+  The sensors are triggered one after the other (staggered, so they do not hear each other's echo)
+  and the echo pulse width is captured by pin change interrupts (no busy-waiting for the echo).
+  Each sensor distance is median filtered.
+*/
+
+#ifndef SONAR_H
+#define SONAR_H
+
+#include <Arduino.h>
+#include "RunningMedian.h"
+
+#define SONAR_COUNT 3
+#define SONAR_MEDIAN 5   // median filter length (samples)
+
+enum SonarSelect {SONAR_LEFT, SONAR_CENTER, SONAR_RIGHT};
+typedef enum SonarSelect SonarSelect;
+
+
+class Sonar {
+  public:
+    bool enabled;
+    bool leftUse;
+    bool centerUse;
+    bool rightUse;
+    unsigned int minDistance;  // echos nearer than this are ignored (cm)
+    unsigned int maxDistance;  // echos farther than this are ignored (cm) 
+    unsigned int distanceLeft;   // filtered distance (cm), 0 = no echo
+    unsigned int distanceCenter;
+    unsigned int distanceRight;
+    unsigned long measurements;  // number of measurements (all sensors)
+    void begin();
+    void run();    
+    // filtered distance (cm), 0 = no echo
+    unsigned int distance(SonarSelect idx);
+  protected:
+    int sonarIdx;   // currently triggered sensor
+    unsigned long nextTriggerTime;
+    RunningMedian<unsigned int, SONAR_MEDIAN> filter[SONAR_COUNT];
+    bool isUsed(int idx);
+    void trigger(int idx);
+    void addEcho(int idx, unsigned long echoDuration);
+};
+
+
+
+#endif
@@ -0,0 +1,80 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "storage.h"
+#include "config.h"
+#include <Wire.h>
+
+
+#define STORAGE_MAGIC       0x53
+#define STORAGE_SIZE        4096    // AT24C32: 4 KB
+#define STORAGE_PAGE_SIZE   32      // write page
+#define STORAGE_CHUNK_SIZE  16      // I2C transfer (Wire buffer minus address bytes)
+#define STORAGE_WRITE_TIME  5       // write cycle time (ms)
+
+
+uint8_t Storage::checksum(const uint8_t *data, int len){
+  uint8_t sum = 0;
+  for (int i=0; i < len; i++) sum = (sum << 1 | sum >> 7) ^ data[i];
+  return sum;
+}
+
+bool Storage::readBytes(int address, uint8_t *data, int len){
+  while (len > 0){
+    int chunk = min(len, STORAGE_CHUNK_SIZE);
+    Wire.beginTransmission(AT24C32_ADDRESS);
+    Wire.write(address >> 8);
+    Wire.write(address & 0xFF);
+    if (Wire.endTransmission() != 0) return false;
+    if (Wire.requestFrom(AT24C32_ADDRESS, chunk) != chunk) return false;
+    for (int i=0; i < chunk; i++) data[i] = Wire.read();
+    address += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+bool Storage::writeBytes(int address, const uint8_t *data, int len){
+  while (len > 0){
+    // writes must not cross page boundary
+    int chunk = min(len, STORAGE_CHUNK_SIZE);
+    chunk = min(chunk, STORAGE_PAGE_SIZE - (address % STORAGE_PAGE_SIZE));
+    uint8_t curr[STORAGE_CHUNK_SIZE];
+    if ((!readBytes(address, curr, chunk)) || (memcmp(curr, data, chunk) != 0)) {
+      Wire.beginTransmission(AT24C32_ADDRESS);
+      Wire.write(address >> 8);
+      Wire.write(address & 0xFF);
+      for (int i=0; i < chunk; i++) Wire.write(data[i]);
+      if (Wire.endTransmission() != 0) return false;
+      delay(STORAGE_WRITE_TIME);
+    }
+    address += chunk;
+    data += chunk;
+    len -= chunk;
+  }
+  return true;
+}
+
+bool Storage::load(int address, void *data, int len){
+  uint8_t header[2];
+  uint8_t sum;
+  if ((len > 255) || (address + len + 3 > STORAGE_SIZE)) return false;
+  if (!readBytes(address, header, 2)) return false;
+  if ((header[0] != STORAGE_MAGIC) || (header[1] != len)) return false;
+  if (!readBytes(address + 2, (uint8_t*)data, len)) return false;
+  if (!readBytes(address + 2 + len, &sum, 1)) return false;
+  return (sum == checksum((uint8_t*)data, len));
+}
+
+bool Storage::save(int address, const void *data, int len){
+  if ((len > 255) || (address + len + 3 > STORAGE_SIZE)) return false;
+  uint8_t header[2] = { STORAGE_MAGIC, (uint8_t)len };
+  uint8_t sum = checksum((const uint8_t*)data, len);
+  if (!writeBytes(address, header, 2)) return false;
+  if (!writeBytes(address + 2, (const uint8_t*)data, len)) return false;
+  return writeBytes(address + 2 + len, &sum, 1);
+}
+
@@ -0,0 +1,33 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// persistent settings in AT24C32 EEPROM (RTC module, I2C)
+
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <Arduino.h>
+
+
+// record addresses (each record: magic, length, data, checksum)
+#define STORAGE_ADDR_ODOMETRY   0x0000    // odometry calibration
+#define STORAGE_ADDR_MOTOR      0x0040    // motor speed control tuning
+#define STORAGE_ADDR_TIMETABLE  0x0080    // mowing timetable
+
+
+class Storage {
+  public:
+    // read record (false if missing, different length or checksum error)
+    bool load(int address, void *data, int len);
+    // write record (only changed bytes are written)
+    bool save(int address, const void *data, int len);
+  protected:
+    bool readBytes(int address, uint8_t *data, int len);
+    bool writeBytes(int address, const uint8_t *data, int len);
+    uint8_t checksum(const uint8_t *data, int len);
+};
+
+
+#endif
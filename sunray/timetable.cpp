@@ -0,0 +1,217 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "timetable.h"
+#include "config.h"
+#include "robot.h"
+#include "storage.h"
+#include <Wire.h>
+
+
+#define TIMETABLE_RTC_INTERVAL   3600000   // RTC synchronization interval (ms)
+#define TIMETABLE_EVAL_INTERVAL  60000     // timetable evaluation interval (ms)
+#define TIMETABLE_RAIN_INTERVAL  1000      // rain sensor sample interval (ms)
+#define TIMETABLE_RAIN_SAMPLES   5         // consecutive wet samples for rain
+#define TIMETABLE_RAIN_LOCKOUT   7200000   // no mowing until this time (ms) after last rain
+
+
+static uint8_t bcdToDec(uint8_t v){
+  return (v >> 4) * 10 + (v & 0x0F);
+}
+
+static uint8_t decToBcd(uint8_t v){
+  return ((v / 10) << 4) | (v % 10);
+}
+
+
+void Timetable::begin(){
+  enabled = TIMETABLE;
+  rainSensor = RAIN_SENSOR;
+  if (rainSensor) pinMode(pinRain, INPUT_PULLUP);   // sensor pulls to GND when wet
+  raining = false;
+  mowingStarted = false;
+  activeEntry = -1;
+  startedEntry = -1;
+  rainCounter = 0;
+  lastRainTime = 0;
+  nextRainTime = 0;
+  nextEvalTime = 0;
+  memset(entries, 0, sizeof(entries));
+  memset(&rtcTime, 0, sizeof(rtcTime));
+  rtcReadTime = millis();
+  nextRtcTime = millis() + TIMETABLE_RTC_INTERVAL;
+  rtcFound = readRTC();
+  if (!rtcFound) CONSOLE.println("timetable: RTC not found");
+  load();
+}
+
+bool Timetable::readRTC(){
+  Wire.beginTransmission(DS1307_ADDRESS);
+  Wire.write(0x00);
+  if (Wire.endTransmission() != 0) return false;
+  if (Wire.requestFrom(DS1307_ADDRESS, 7) != 7) return false;
+  uint8_t reg[7];
+  for (int i=0; i < 7; i++) reg[i] = Wire.read();
+  if (reg[0] & 0x80) return false;   // clock halted (not set)
+  rtcTime.second = bcdToDec(reg[0] & 0x7F);
+  rtcTime.minute = bcdToDec(reg[1]);
+  rtcTime.hour = bcdToDec(reg[2] & 0x3F);
+  rtcTime.weekday = (reg[3] - 1) % 7;
+  rtcTime.day = bcdToDec(reg[4]);
+  rtcTime.month = bcdToDec(reg[5]);
+  rtcTime.year = 2000 + bcdToDec(reg[6]);
+  rtcReadTime = millis();
+  return true;
+}
+
+bool Timetable::setDateTime(const datetime_t &dt){
+  Wire.beginTransmission(DS1307_ADDRESS);
+  Wire.write(0x00);
+  Wire.write(decToBcd(dt.second));   // clock halt bit cleared: oscillator runs
+  Wire.write(decToBcd(dt.minute));
+  Wire.write(decToBcd(dt.hour));     // 24 hour mode
+  Wire.write(dt.weekday + 1);
+  Wire.write(decToBcd(dt.day));
+  Wire.write(decToBcd(dt.month));
+  Wire.write(decToBcd(dt.year % 100));
+  if (Wire.endTransmission() != 0) return false;
+  rtcFound = readRTC();
+  nextEvalTime = 0;
+  return rtcFound;
+}
+
+// RTC reading advanced by elapsed time (date is kept, only time of day and weekday advance)
+void Timetable::getDateTime(datetime_t &dt){
+  dt = rtcTime;
+  unsigned long elapsed = (millis() - rtcReadTime) / 1000;
+  unsigned long seconds = ((unsigned long)dt.hour * 60 + dt.minute) * 60 + dt.second + elapsed;
+  unsigned long days = seconds / 86400;
+  seconds = seconds % 86400;
+  dt.hour = seconds / 3600;
+  dt.minute = (seconds / 60) % 60;
+  dt.second = seconds % 60;
+  dt.weekday = (dt.weekday + days) % 7;
+}
+
+bool Timetable::setEntry(int idx, uint8_t days, uint16_t startMinute, uint16_t endMinute, uint8_t zone){
+  if ((idx < 0) || (idx >= TIMETABLE_ENTRIES)) return false;
+  if ((startMinute >= 1440) || (endMinute > 1440)) return false;
+  if ((days != 0) && (startMinute == endMinute)) return false;
+  entries[idx].days = days & 0x7F;
+  entries[idx].zone = zone;
+  entries[idx].startMinute = startMinute;
+  entries[idx].endMinute = endMinute;
+  save();
+  nextEvalTime = 0;
+  return true;
+}
+
+void Timetable::load(){
+  timetable_entry_t data[TIMETABLE_ENTRIES];
+  if (!storage.load(STORAGE_ADDR_TIMETABLE, data, sizeof(data))) return;
+  memcpy(entries, data, sizeof(entries));
+  int count = 0;
+  for (int i=0; i < TIMETABLE_ENTRIES; i++) if (entries[i].days != 0) count++;
+  CONSOLE.print("timetable loaded: entries=");
+  CONSOLE.println(count);
+}
+
+void Timetable::save(){
+  storage.save(STORAGE_ADDR_TIMETABLE, entries, sizeof(entries));
+}
+
+// window containing time (-1: none) - an overnight window belongs to the weekday it starts on
+int Timetable::findEntry(const datetime_t &dt){
+  uint16_t minute = ((uint16_t)dt.hour) * 60 + dt.minute;
+  uint8_t today = 1 << dt.weekday;
+  uint8_t yesterday = 1 << ((dt.weekday + 6) % 7);
+  for (int i=0; i < TIMETABLE_ENTRIES; i++){
+    const timetable_entry_t &e = entries[i];
+    if (e.startMinute == e.endMinute) continue;
+    if (e.startMinute < e.endMinute){
+      if ((e.days & today) && (minute >= e.startMinute) && (minute < e.endMinute)) return i;
+    } else {
+      if ((e.days & today) && (minute >= e.startMinute)) return i;
+      if ((e.days & yesterday) && (minute < e.endMinute)) return i;
+    }
+  }
+  return -1;
+}
+
+// debounced rain sensor (wet: LOW)
+void Timetable::checkRain(){
+  if (!rainSensor) return;
+  if (millis() < nextRainTime) return;
+  nextRainTime = millis() + TIMETABLE_RAIN_INTERVAL;
+  if (digitalRead(pinRain) == LOW){
+    if (rainCounter < TIMETABLE_RAIN_SAMPLES) rainCounter++;
+  } else rainCounter = 0;
+  bool rain = (rainCounter >= TIMETABLE_RAIN_SAMPLES);
+  if (rain) lastRainTime = millis();
+  if (rain != raining){
+    raining = rain;
+    CONSOLE.print("rain=");
+    CONSOLE.println(raining);
+  }
+  if ((raining) && ((stateOp == OP_MOW) || (mission.state != MISSION_NONE))) stopMowing("rain");
+}
+
+// end mowing (and a mission waiting for charge) - dock if possible
+void Timetable::stopMowing(const char *reason){
+  CONSOLE.print("timetable: ");
+  CONSOLE.print(reason);
+  CONSOLE.println(" - stop mowing");
+  mowingStarted = false;
+  mission.cancel();
+  if (stateOp == OP_MOW){
+    if (maps.dockPointsCount > 0) setOperation(OP_DOCK);
+      else setOperation(OP_IDLE);
+  }
+}
+
+void Timetable::evaluate(){
+  datetime_t dt;
+  getDateTime(dt);
+  activeEntry = findEntry(dt);
+  if ((mowingStarted) && (stateOp != OP_MOW) && (mission.state == MISSION_NONE)){
+    // mowing stopped (user, error, finished) - do not restart within this window
+    mowingStarted = false;
+  }
+  if (activeEntry < 0){
+    startedEntry = -1;
+    if (mowingStarted) stopMowing("window closed");
+    return;
+  }
+  if (activeEntry == startedEntry) return;   // already started for this window
+  bool lockout = (raining) || ((lastRainTime != 0) && (millis() < lastRainTime + TIMETABLE_RAIN_LOCKOUT));
+  if (lockout) return;
+  if ((stateOp != OP_IDLE) && (stateOp != OP_CHARGE)) return;
+  if ((stateOp == OP_CHARGE) && (battery.shouldGoHome())) return;   // not charged enough
+  CONSOLE.print("timetable: window ");
+  CONSOLE.print(activeEntry);
+  CONSOLE.println(" opened - start mowing");
+  startedEntry = activeEntry;
+  uint8_t zone = entries[activeEntry].zone;
+  if (maps.zoneCount > 0){
+    // single zone, or all zones one after the other
+    maps.zoneSequence = (zone == ZONE_ALL);
+    if (!maps.selectZone((zone == ZONE_ALL) ? 0 : zone)) return;
+  }
+  setOperation(OP_MOW);
+  mowingStarted = (stateOp == OP_MOW);
+}
+
+void Timetable::run(){
+  if (!enabled) return;
+  checkRain();
+  if (!rtcFound) return;
+  if (millis() > nextRtcTime){
+    nextRtcTime = millis() + TIMETABLE_RTC_INTERVAL;
+    readRTC();
+  }
+  if (millis() < nextEvalTime) return;
+  nextEvalTime = millis() + TIMETABLE_EVAL_INTERVAL;
+  evaluate();
+}
@@ -0,0 +1,82 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// weekly mowing timetable (DS1307 real-time clock on RTC module)
+//   - time windows (weekdays, start/end time, zone) are stored in the RTC module EEPROM, a window with
+//     end before start runs overnight (weekday is the day the window starts)
+//   - the RTC is read at startup and once per hour, in between the time advances with millis()
+//   - the timetable is evaluated once per minute: mowing starts when a window opens, the robot docks
+//     when the window closes
+//   - rain sensor (RAIN_SENSOR, pinRain low when wet) stops/prevents mowing until no rain was detected for 
+//     TIMETABLE_RAIN_LOCKOUT (rain also stops mowing without RTC)
+
+#ifndef TIMETABLE_H
+#define TIMETABLE_H
+
+#include <Arduino.h>
+
+#define TIMETABLE_ENTRIES 14
+
+
+struct timetable_entry_t {
+  uint8_t days;          // weekday mask (bit 0: monday ... bit 6: sunday), 0: unused
+  uint8_t zone;          // zone to mow (ZONE_ALL: all zones)
+  uint16_t startMinute;  // window start (minute of day)
+  uint16_t endMinute;    // window end (minute of day, before start: next day)
+} __attribute__((packed));
+
+typedef struct timetable_entry_t timetable_entry_t;
+
+
+struct datetime_t {
+  uint8_t second;
+  uint8_t minute;
+  uint8_t hour;
+  uint8_t weekday;     // 0: monday ... 6: sunday
+  uint8_t day;
+  uint8_t month;
+  uint16_t year;
+};
+
+typedef struct datetime_t datetime_t;
+
+
+class Timetable {
+  public:
+    bool enabled;
+    bool rainSensor;          // rain sensor connected (RAIN_SENSOR)?
+    bool rtcFound;
+    bool raining;             // rain detected (debounced)
+    bool mowingStarted;       // mowing was started by timetable
+    int activeEntry;          // open window (-1: none)
+    timetable_entry_t entries[TIMETABLE_ENTRIES];
+    void begin();
+    // non-blocking, call in main loop
+    void run();
+    // current time (RTC synchronized, advanced by millis)
+    void getDateTime(datetime_t &dt);
+    bool setDateTime(const datetime_t &dt);
+    // false: invalid index or time, empty window (start = end)
+    bool setEntry(int idx, uint8_t days, uint16_t startMinute, uint16_t endMinute, uint8_t zone);
+  protected:
+    datetime_t rtcTime;       // last RTC reading
+    unsigned long rtcReadTime;  // millis at last RTC reading
+    unsigned long nextRtcTime;
+    unsigned long nextEvalTime;
+    unsigned long nextRainTime;
+    unsigned long lastRainTime;
+    int rainCounter;
+    int startedEntry;         // window mowing was started for (-1: none)
+    bool readRTC();
+    void checkRain();
+    void stopMowing(const char *reason);
+    void evaluate();
+    int findEntry(const datetime_t &dt);
+    void load();
+    void save();
+};
+
+
+#endif
@@ -6,6 +6,25 @@
 #include "Arduino.h"
 #include "ublox.h"
 #include "config.h"
+#include "ubloxcfg.h"
+#include "binlog.h"
+
+
+#define CFG_TX_BUFFER     128     // serial TX buffer of the Due core (SERIAL_BUFFER_SIZE)
+// configuration items per VALGET/VALSET: a VALSET frame (8 bytes framing, 4 bytes header, up to 12 bytes 
+// per item) must fit into the TX buffer, otherwise write() spins until the buffer drains
+#define CFG_CHUNK_ITEMS   ((CFG_TX_BUFFER - 12) / 12)
+#define CFG_TIMEOUT       1000    // ACK/NAK timeout (ms)
+#define CFG_RETRIES       3       // retries per chunk
+#define CFG_LAYERS        0x07    // VALSET layers: RAM, BBR, flash
+#define CFG_BAUD_DELAY    100     // wait for baudrate change to be sent (ms)
+
+#define CFG_KEY_RATE_MEAS       0x30210001
+#define CFG_KEY_UART1_BAUDRATE  0x40520001
+
+// baudrates tried to contact receiver (configured, default, F9P factory default)
+static const uint32_t configBaudrates[] = { GPS_CONFIG_BAUDRATE, GPS_BAUDRATE, 38400 };
+#define CFG_BAUDRATES (sizeof(configBaudrates) / sizeof(uint32_t))
 
 /* uBlox object, input the serial bus and baud rate */
 UBLOX::UBLOX(HardwareSerial& bus,uint32_t baud)
@@ -21,31 +40,169 @@ void UBLOX::begin()
   this->msgclass = -1;
   this->msgid    = -1;
   this->msglen   = -1;
-  this->chka     = -1;
-  this->chkb     = -1;
+  this->msgdef   = -1;
+  this->chka     = 0;
+  this->chkb     = 0;
   this->count    = 0;
   this->dgpsAge  = 0;
   this->solutionAvail = false;
   this->numSV    = 0;
   this->accuracy  =0;  
+  this->fixType  = 0;
+  this->carrSoln = SOL_INVALID;
+  this->sigEpochs = 0;
+  this->sigWindowIdx = 0;
+  this->solution = SOL_INVALID;
+  this->configChanged = 0;
+  this->configErrors = 0;
+  this->droppedFrames = 0;
+  this->configDetected = false;
+  this->configBaudIdx = 0;
+  this->configPos = 0;
+  this->configRetries = 0;
+  this->configState = CFG_NONE;
+  if (GPS_CONFIG){
+    this->configState = CFG_GET;
+    _baud = configBaudrates[0];
+  }
 	// begin the serial port for uBlox	
   _bus->begin(_baud);
 }
 
 
 
+// decoded UBX messages (fixed part, variable messages are followed by blocks of blockLen)
+typedef struct {
+  uint8_t msgClass;
+  uint8_t msgId;
+  uint16_t len;
+  uint16_t blockLen;
+} ubx_msg_def_t;
+
+static const ubx_msg_def_t ubxMessages[] = {
+  { UBX_CLASS_NAV, UBX_NAV_PVT,       sizeof(ubx_nav_pvt_t),       0 },
+  { UBX_CLASS_NAV, UBX_NAV_VELNED,    sizeof(ubx_nav_velned_t),    0 },
+  { UBX_CLASS_NAV, UBX_NAV_HPPOSLLH,  sizeof(ubx_nav_hpposllh_t),  0 },
+  { UBX_CLASS_NAV, UBX_NAV_RELPOSNED, sizeof(ubx_nav_relposned_t), 0 },
+  { UBX_CLASS_NAV, UBX_NAV_SIG,       sizeof(ubx_nav_sig_t),       sizeof(ubx_nav_sig_block_t) },
+  { UBX_CLASS_RXM, UBX_RXM_RTCM,      sizeof(ubx_rxm_rtcm_t),      0 },
+  { UBX_CLASS_ACK, UBX_ACK_ACK,       sizeof(ubx_ack_t),           0 },
+  { UBX_CLASS_ACK, UBX_ACK_NAK,       sizeof(ubx_ack_t),           0 },
+  { UBX_CLASS_CFG, UBX_CFG_VALGET,    sizeof(ubx_cfg_valget_t),    1 },    // items are compared byte by byte
+};
+
+#define UBX_MESSAGES (sizeof(ubxMessages) / sizeof(ubx_msg_def_t))
+
+static_assert(sizeof(ubx_nav_pvt_t) == 92, "UBX-NAV-PVT size");
+static_assert(sizeof(ubx_nav_velned_t) == 36, "UBX-NAV-VELNED size");
+static_assert(sizeof(ubx_nav_hpposllh_t) == 36, "UBX-NAV-HPPOSLLH size");
+static_assert(sizeof(ubx_nav_relposned_t) == 64, "UBX-NAV-RELPOSNED size");
+static_assert(sizeof(ubx_nav_sig_t) == 8, "UBX-NAV-SIG size");
+static_assert(sizeof(ubx_nav_sig_block_t) == 16, "UBX-NAV-SIG block size");
+static_assert(sizeof(ubx_rxm_rtcm_t) == 8, "UBX-RXM-RTCM size");
+static_assert(sizeof(ubx_ack_t) == 2, "UBX-ACK size");
+static_assert(sizeof(ubx_cfg_valget_t) == 4, "UBX-CFG-VALGET size");
+static_assert(sizeof(ubx_nav_sig_t) + sizeof(ubx_nav_sig_block_t) <= UBX_PAYLOAD_SIZE, "UBX payload buffer");
+
+
+// find message in table and validate its length (-1: not decoded)
+int UBLOX::findMessage(int msgClass, int msgId, int len){
+  for (unsigned int i=0; i < UBX_MESSAGES; i++){
+    const ubx_msg_def_t &def = ubxMessages[i];
+    if ((def.msgClass != msgClass) || (def.msgId != msgId)) continue;
+    if (def.blockLen == 0){
+      if (len == def.len) return i;
+    } else {
+      if ((len >= def.len) && ((len - def.len) % def.blockLen == 0)) return i;
+    }
+    return -1;
+  }
+  return -1;
+}
+
+// store payload byte, blocks of variable messages are decoded as soon as they are complete
+void UBLOX::storePayload(int b){
+  const ubx_msg_def_t &def = ubxMessages[this->msgdef];
+  if (this->count < def.len){
+    this->payload.bytes[this->count] = b;
+    if (this->count == 0){
+      if ((this->msgclass == UBX_CLASS_NAV) && (this->msgid == UBX_NAV_SIG)){
+        sigCount = 0;
+        memset(sigPending, 0, sizeof(sigPending));
+      } else if ((this->msgclass == UBX_CLASS_CFG) && (this->msgid == UBX_CFG_VALGET)){
+        configPendingDiffer = 0;
+        configItemLen = 0;
+      }
+    }
+    return;
+  }
+  int idx = (this->count - def.len) % def.blockLen;
+  this->payload.bytes[def.len + idx] = b;
+  if (idx != def.blockLen-1) return;
+  // block complete
+  if (this->msgclass == UBX_CLASS_CFG){
+    if (configItemLen < sizeof(configItem)) configItem[configItemLen++] = b;
+    compareConfigItem();
+  } else if (this->msgid == UBX_NAV_SIG){
+    const ubx_nav_sig_block_t *sig = (const ubx_nav_sig_block_t*)(this->payload.bytes + def.len);
+    sigCount++;
+    // signal health ok (bits 0-1) and pseudorange used (prUsed, bit 3)?
+    if ((sig->gnssId < UBX_GNSS_COUNT) && ((sig->sigFlags & 3) == 1) && ((sig->sigFlags & 8) != 0)){
+      ubx_sig_stat_t &stat = sigPending[sig->gnssId];
+      uint16_t res = (sig->prRes < 0) ? -sig->prRes : sig->prRes;
+      stat.signals++;
+      stat.cnoSum += sig->cno;
+      stat.resSum += res;
+      if (res > stat.resMax) stat.resMax = res;
+    }
+  }
+}
+
+bool UBLOX::signalQuality(int gnssId, float &signals, float &cno, float &resAvg, float &resMax){
+  signals = 0;
+  cno = 0;
+  resAvg = 0;
+  resMax = 0;
+  if ((gnssId < 0) || (gnssId >= UBX_GNSS_COUNT) || (sigEpochs == 0)) return false;
+  unsigned long signalSum = 0;
+  unsigned long cnoSum = 0;
+  unsigned long resSum = 0;
+  int resMaxSum = 0;
+  for (int i=0; i < sigEpochs; i++){
+    const ubx_sig_stat_t &stat = sigWindow[i][gnssId];
+    signalSum += stat.signals;
+    cnoSum += stat.cnoSum;
+    resSum += stat.resSum;
+    resMaxSum = max(resMaxSum, (int)stat.resMax);
+  }
+  signals = ((float)signalSum) / ((float)sigEpochs);
+  if (signalSum > 0){
+    cno = ((float)cnoSum) / ((float)signalSum);
+    resAvg = ((float)resSum) / ((float)signalSum) * 0.1;
+  }
+  resMax = ((float)resMaxSum) * 0.1;
+  return true;
+}
+
 void UBLOX::parse(int b)
 {
-  if (b == 0xB5) {
+  if ((this->state == GOT_NONE) || (this->state == GOT_SYNC1)) {
+    // only look for sync outside of messages (payload may contain 0xB5)
+    if (b == 0xB5) {
 
-      this->state = GOT_SYNC1;
-  }
+        this->state = GOT_SYNC1;
+    }
 
-  else if (b == 0x62 && this->state == GOT_SYNC1) {
+    else if (b == 0x62 && this->state == GOT_SYNC1) {
+
+        this->state = GOT_SYNC2;
+        this->chka = 0;
+        this->chkb = 0;
+    }
 
-      this->state = GOT_SYNC2;
-      this->chka = 0;
-      this->chkb = 0;
+    else {
+        this->state = GOT_NONE;
+    }
   }
 
   else if (this->state == GOT_SYNC2) {
@@ -75,13 +232,17 @@ void UBLOX::parse(int b)
       this->msglen += (b << 8);
       this->count = 0;
       this->addchk(b);
+      this->msgdef = this->findMessage(this->msgclass, this->msgid, this->msglen);
+      if (this->msglen == 0) {
+          this->state = GOT_PAYLOAD;
+      }
   }
 
   else if (this->state == GOT_LENGTH2) {
 
       this->addchk(b);
-      if (this->count < sizeof(this->payload)){
-        this->payload[this->count] = b; 
+      if (this->msgdef >= 0){
+        this->storePayload(b);
       }        
       this->count += 1;
 
@@ -94,17 +255,17 @@ void UBLOX::parse(int b)
   else if (this->state == GOT_PAYLOAD) {
 
       this->state = (b == this->chka) ? GOT_CHKA : GOT_NONE;
+      if (this->state == GOT_NONE) this->droppedFrames++;
   }
 
   else if (this->state == GOT_CHKA) {
 
-      if (b == this->chkb) {
+      if (b != this->chkb) {
+          this->droppedFrames++;
+      } else if (this->msgdef >= 0) {
           this->dispatchMessage();
       }
-
-      else {
-          this->state = GOT_NONE;
-      }
+      this->state = GOT_NONE;
   }
 }
 
@@ -117,150 +278,315 @@ void UBLOX::addchk(int b) {
 
 void UBLOX::dispatchMessage() {
     switch (this->msgclass){
-      case 0x01:
+      case UBX_CLASS_NAV:
         switch (this->msgid) {
-          case 0x07:
-            { // UBX-NAV-PVT
-              iTOW = (unsigned long)this->unpack_int32(0);
-              numSV = this->unpack_int8(23);               
+          case UBX_NAV_PVT:
+            { 
+              const ubx_nav_pvt_t *pvt = (const ubx_nav_pvt_t*)this->payload.bytes;
+              iTOW = pvt->iTOW;
+              numSV = pvt->numSV;
+              fixType = pvt->fixType;
+              carrSoln = (UBLOX::SolType)((pvt->flags >> 6) & 3);
+              hAccuracy = ((float)pvt->hAcc) / 1000.0;
+              groundSpeed = ((float)pvt->gSpeed) / 1000.0;
+              heading = ((float)pvt->headMot) * 1e-5 / 180.0 * PI;
             }
             break;
-          case 0x12:
-            { // UBX-NAV-VELNED
-              iTOW = (unsigned long)this->unpack_int32(0);
-              groundSpeed = ((double)((unsigned long)this->unpack_int32(20))) / 100.0;
-              heading = ((double)this->unpack_int32(24)) * 1e-5 / 180.0 * PI;
+          case UBX_NAV_VELNED:
+            { 
+              const ubx_nav_velned_t *velned = (const ubx_nav_velned_t*)this->payload.bytes;
+              iTOW = velned->iTOW;
+              groundSpeed = ((float)velned->gSpeed) / 100.0;
+              heading = ((float)velned->heading) * 1e-5 / 180.0 * PI;
               //CONSOLE.print("heading:");
               //CONSOLE.println(heading);
             }
             break;
-          case 0x14: 
-            { // UBX-NAV-HPPOSLLH
-              iTOW = (unsigned long)this->unpack_int32(4);
-              lon = (1e-7  * (this->unpack_int32(8)   +  (this->unpack_int8(24) * 1e-2)));
-              lat = (1e-7  * (this->unpack_int32(12)  +  (this->unpack_int8(25) * 1e-2)));
-              height = (1e-3 * (this->unpack_int32(16) +  (this->unpack_int8(26) * 1e-2))); // HAE (WGS84 height)
-              //height = (1e-3 * (this->unpack_int32(20) +  (this->unpack_int8(27) * 1e-2))); // MSL height
-              hAccuracy = ((double)((unsigned long)this->unpack_int32(28))) * 0.1 / 1000.0;
-              vAccuracy = ((double)((unsigned long)this->unpack_int32(32))) * 0.1 / 1000.0;
+          case UBX_NAV_HPPOSLLH: 
+            { 
+              const ubx_nav_hpposllh_t *hpposllh = (const ubx_nav_hpposllh_t*)this->payload.bytes;
+              iTOW = hpposllh->iTOW;
+              lonE9 = ((int64_t)hpposllh->lon) * 100 + hpposllh->lonHp;
+              latE9 = ((int64_t)hpposllh->lat) * 100 + hpposllh->latHp;
+              lon = 1e-9 * lonE9;
+              lat = 1e-9 * latE9;
+              height = (1e-3 * (hpposllh->height +  (hpposllh->heightHp * 1e-1))); // HAE (WGS84 height)
+              //height = (1e-3 * (hpposllh->hMSL +  (hpposllh->hMSLHp * 1e-1))); // MSL height
+              hAccuracy = ((float)hpposllh->hAcc) * 0.1 / 1000.0;
+              vAccuracy = ((float)hpposllh->vAcc) * 0.1 / 1000.0;
               accuracy = sqrt(sq(hAccuracy) + sq(vAccuracy));
-              // long hMSL = this->unpack_int32(16);
-              //unsigned long hAcc = (unsigned long)this->unpack_int32(20);
-              //unsigned long vAcc = (unsigned long)this->unpack_int32(24);                            
             }
             break;            
-          case 0x43:
-            { // UBX-NAV-SIG
-              iTOW = (unsigned long)this->unpack_int32(0);
-              int numSigs = this->unpack_int8(5);
-              float ravg = 0;
-              float rmax = 0;
-              float rmin = 9999;
-              float rsum = 0;    
-              int crcnt = 0;
-              for (int i=0; i < numSigs; i++){                
-                float prRes = ((float)((short)this->unpack_int16(12+16*i))) * 0.1;
-                float cno = ((float)this->unpack_int8(14+16*i));
-                int qualityInd = this->unpack_int8(15+16*i);                                
-                int sigFlags = (unsigned short)this->unpack_int16(18+16*i);                                
-                if ((sigFlags & 3) == 1){
-                  if ((sigFlags & 128) != 0){
-                    /*CONSOLE.print(sigFlags);
-                    CONSOLE.print(",");                                
-                    CONSOLE.print(qualityInd);
-                    CONSOLE.print(",");                                
-                    CONSOLE.print(prRes);
-                    CONSOLE.print(",");
-                    CONSOLE.println(cno); */
-                    rsum += fabs(prRes);
-                    rmax = max(rmax, fabs(prRes));
-                    rmin = min(rmin, fabs(prRes));
-                    crcnt++;
-                  }                    
-                }                
-              }
-              ravg = rsum/((float)numSigs);
-              CONSOLE.print("sol=");
-              CONSOLE.print(solution);              
-              CONSOLE.print("\t");
-              CONSOLE.print("hAcc=");
-              CONSOLE.print(hAccuracy);
-              CONSOLE.print("\tvAcc=");
-              CONSOLE.print(vAccuracy);
-              CONSOLE.print("\t#");
-              CONSOLE.print(crcnt);
-              CONSOLE.print("/");
-              CONSOLE.print(numSigs);
-              CONSOLE.print("\t");
-              CONSOLE.print("rsum=");
-              CONSOLE.print(rsum);
-              CONSOLE.print("\t");
-              CONSOLE.print("ravg=");
-              CONSOLE.print(ravg);
-              CONSOLE.print("\t");
-              CONSOLE.print("rmin=");
-              CONSOLE.print(rmin);
-              CONSOLE.print("\t");
-              CONSOLE.print("rmax=");
-              CONSOLE.println(rmax);
+          case UBX_NAV_SIG:
+            { // signal statistics were accumulated per signal block (see storePayload)
+              const ubx_nav_sig_t *navsig = (const ubx_nav_sig_t*)this->payload.bytes;
+              iTOW = navsig->iTOW;
+              if (sigCount != navsig->numSigs) break;              
+              memcpy(sigWindow[sigWindowIdx], sigPending, sizeof(sigPending));
+              sigWindowIdx = (sigWindowIdx + 1) % UBX_SIG_WINDOW;
+              if (sigEpochs < UBX_SIG_WINDOW) sigEpochs++;
             }
             break;
-          case 0x3C: 
-            { // UBX-NAV-RELPOSNED              
-              iTOW = (unsigned long)this->unpack_int32(4);
-              relPosN = ((float)this->unpack_int32(8))/100.0;
-              relPosE = ((float)this->unpack_int32(12))/100.0;
-              relPosD = ((float)this->unpack_int32(16))/100.0;              
-              solution = (UBLOX::SolType)((this->unpack_int32(60) >> 3) & 3);              
+          case UBX_NAV_RELPOSNED: 
+            { 
+              const ubx_nav_relposned_t *relposned = (const ubx_nav_relposned_t*)this->payload.bytes;
+              iTOW = relposned->iTOW;
+              relPosN = ((float)relposned->relPosN)/100.0;
+              relPosE = ((float)relposned->relPosE)/100.0;
+              relPosD = ((float)relposned->relPosD)/100.0;              
+              solution = (UBLOX::SolType)((relposned->flags >> 3) & 3);              
               solutionAvail = true;
             }
             break;            
         }
         break;      
-      case 0x02:
+      case UBX_CLASS_RXM:
         switch (this->msgid) {
-          case 0x32: 
-            { // UBX-RXM-RTCM              
+          case UBX_RXM_RTCM: 
+            { 
               dgpsAge = millis();
             }
             break;            
         }
         break;
+      case UBX_CLASS_ACK:
+        { 
+          const ubx_ack_t *ack = (const ubx_ack_t*)this->payload.bytes;
+          if (ack->clsID == UBX_CLASS_CFG){
+            configDetected = true;
+            configAck = (this->msgid == UBX_ACK_ACK) ? 1 : -1;
+          }
+        }
+        break;
+      case UBX_CLASS_CFG:
+        switch (this->msgid) {
+          case UBX_CFG_VALGET:
+            { // items were compared while receiving (see compareConfigItem)
+              configDiffer = configPendingDiffer;
+              configReply = true;
+            }
+            break;
+        }
+        break;
     }    
 }
 
-long UBLOX::unpack_int32(int offset) {
+void UBLOX::send(int msgClass, int msgId, const uint8_t *data, int len){
+  uint8_t header[6] = { 0xB5, 0x62, (uint8_t)msgClass, (uint8_t)msgId, (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+  uint8_t ckA = 0;
+  uint8_t ckB = 0;
+  for (int i=2; i < 6; i++){
+    ckA += header[i];
+    ckB += ckA;
+  }
+  for (int i=0; i < len; i++){
+    ckA += data[i];
+    ckB += ckA;
+  }
+  _bus->write(header, 6);
+  _bus->write(data, len);
+  _bus->write(ckA);
+  _bus->write(ckB);
+}
 
-    return this->unpack(offset, 4);
+// read configuration item at table position (value size is encoded in key), returns item length
+int UBLOX::configValue(int pos, uint32_t &key, uint8_t *value){
+  key = ((uint32_t)ubloxConfig[pos]) | (((uint32_t)ubloxConfig[pos+1]) << 8) 
+    | (((uint32_t)ubloxConfig[pos+2]) << 16) | (((uint32_t)ubloxConfig[pos+3]) << 24);
+  static const uint8_t sizes[8] = { 0, 1, 1, 2, 4, 8, 0, 0 };
+  unsigned int size = sizes[(key >> 28) & 7];
+  memcpy(value, ubloxConfig + pos + 4, size);
+  if ((GPS_CONFIG_RATE_MS > 0) && (key == CFG_KEY_RATE_MEAS)){
+    value[0] = GPS_CONFIG_RATE_MS & 0xFF;
+    value[1] = GPS_CONFIG_RATE_MS >> 8;
+  }
+  return 4 + size;
 }
 
-long UBLOX::unpack_int16(int offset) {
+// compare received VALGET item with configuration chunk
+void UBLOX::compareConfigItem(){
+  static const uint8_t sizes[8] = { 0, 1, 1, 2, 4, 8, 0, 0 };
+  if (configItemLen < 4) return;
+  uint32_t key = ((uint32_t)configItem[0]) | (((uint32_t)configItem[1]) << 8) 
+    | (((uint32_t)configItem[2]) << 16) | (((uint32_t)configItem[3]) << 24);
+  unsigned int size = sizes[(key >> 28) & 7];
+  if (configItemLen < 4 + size) return;
+  configItemLen = 0;
+  int pos = configPos;
+  for (int i=0; i < configChunkItems; i++){
+    uint32_t itemKey;
+    uint8_t value[8];
+    pos += configValue(pos, itemKey, value);
+    if (itemKey == key){
+      if (memcmp(value, configItem + 4, size) != 0) configPendingDiffer |= (1UL << i);
+      return;
+    }
+  }
+}
 
-    return this->unpack(offset, 2);
+void UBLOX::sendConfigGet(){
+  uint8_t data[sizeof(ubx_cfg_valget_t) + CFG_CHUNK_ITEMS * 4];
+  memset(data, 0, sizeof(ubx_cfg_valget_t));  // version 0, layer RAM
+  int len = sizeof(ubx_cfg_valget_t);
+  unsigned int pos = configPos;
+  configChunkItems = 0;
+  while ((configChunkItems < CFG_CHUNK_ITEMS) && (pos < sizeof(ubloxConfig))){
+    uint32_t key;
+    uint8_t value[8];
+    int itemLen = configValue(pos, key, value);
+    memcpy(data + len, ubloxConfig + pos, 4);
+    len += 4;
+    pos += itemLen;
+    configChunkItems++;
+  }
+  configChunkLen = pos - configPos;
+  send(UBX_CLASS_CFG, UBX_CFG_VALGET, data, len);
 }
 
-long UBLOX::unpack_int8(int offset) {
+void UBLOX::sendConfigSet(){
+  uint8_t data[4 + CFG_CHUNK_ITEMS * 12];
+  data[0] = 0;  // version
+  data[1] = CFG_LAYERS;
+  data[2] = 0;
+  data[3] = 0;
+  int len = 4;
+  int pos = configPos;
+  for (int i=0; i < configChunkItems; i++){
+    uint32_t key;
+    uint8_t value[8];
+    int itemLen = configValue(pos, key, value);
+    if ((configDiffer & (1UL << i)) != 0){
+      memcpy(data + len, ubloxConfig + pos, 4);
+      memcpy(data + len + 4, value, itemLen - 4);
+      len += itemLen;
+    }
+    pos += itemLen;
+  }
+  send(UBX_CLASS_CFG, UBX_CFG_VALSET, data, len);
+}
 
-    return this->unpack(offset, 1);
+void UBLOX::sendConfigBaud(){
+  uint32_t baud = GPS_CONFIG_BAUDRATE;
+  uint8_t data[12] = { 0, CFG_LAYERS, 0, 0, 
+    CFG_KEY_UART1_BAUDRATE & 0xFF, (CFG_KEY_UART1_BAUDRATE >> 8) & 0xFF, (CFG_KEY_UART1_BAUDRATE >> 16) & 0xFF, CFG_KEY_UART1_BAUDRATE >> 24, 
+    (uint8_t)(baud & 0xFF), (uint8_t)((baud >> 8) & 0xFF), (uint8_t)((baud >> 16) & 0xFF), (uint8_t)(baud >> 24) };
+  send(UBX_CLASS_CFG, UBX_CFG_VALSET, data, sizeof(data));
 }
 
-long UBLOX::unpack(int offset, int size) {
+void UBLOX::nextConfigChunk(){
+  configPos += configChunkLen;
+  configRetries = 0;
+  configState = CFG_GET;
+}
 
-    long value = 0; // four bytes on most Arduinos
+void UBLOX::reportConfig(){
+  if (binLog.enabled) binLog.log(LOG_GPS_CONFIG, configChanged, configErrors);
+  else {
+    CONSOLE.print("GPS config: changed=");
+    CONSOLE.print(configChanged);
+    CONSOLE.print(" errors=");
+    CONSOLE.print(configErrors);
+    if (!configDetected) CONSOLE.print(" (no answer)");
+    CONSOLE.println();
+  }
+}
 
-    for (int k=0; k<size; ++k) {
-        value <<= 8;
-        value |= (0xFF & this->payload[offset+size-k-1]);
-    }
+// non-blocking receiver configuration: compare configuration table chunk by chunk (VALGET) 
+// and write differing items (VALSET), ACK/NAK are tracked by parse()
+// (a request is only sent after the previous one was answered, so each frame goes into an 
+// empty TX buffer and write() returns without waiting)
+void UBLOX::runConfig(){
+  switch (configState){
+    case CFG_GET:
+      if (configPos >= sizeof(ubloxConfig)) {
+        configState = CFG_BAUD;
+        break;
+      }
+      configAck = 0;
+      configReply = false;
+      sendConfigGet();
+      configTimeout = millis() + CFG_TIMEOUT;
+      configState = CFG_WAIT_GET;
+      break;
+    case CFG_WAIT_GET:
+      if ((configAck > 0) && (configReply)){
+        if (configDiffer != 0) configState = CFG_SET;
+          else nextConfigChunk();
+      } else if (configAck < 0){
+        // unknown key in chunk (receiver firmware?)
+        configErrors++;
+        nextConfigChunk();
+      } else if (millis() > configTimeout){
+        if (!configDetected){
+          configBaudIdx++;
+          if (configBaudIdx >= (int)CFG_BAUDRATES){
+            // no answer at any baudrate (UBX input disabled, other baudrate): skip configuration
+            _baud = GPS_BAUDRATE;
+            _bus->begin(_baud);
+            configErrors++;
+            reportConfig();
+            configState = CFG_DONE;
+            break;
+          }
+          // no answer: try next baudrate
+          _baud = configBaudrates[configBaudIdx];
+          _bus->begin(_baud);
+          configState = CFG_GET;
+        } else if (++configRetries > CFG_RETRIES){
+          configErrors++;
+          nextConfigChunk();
+        } else configState = CFG_GET;
+      }
+      break;
+    case CFG_SET:
+      configAck = 0;
+      sendConfigSet();
+      configTimeout = millis() + CFG_TIMEOUT;
+      configState = CFG_WAIT_SET;
+      break;
+    case CFG_WAIT_SET:
+      if (configAck > 0){
+        for (int i=0; i < configChunkItems; i++){
+          if ((configDiffer & (1UL << i)) != 0) configChanged++;
+        }
+        nextConfigChunk();
+      } else if (configAck < 0){
+        configErrors++;
+        nextConfigChunk();
+      } else if (millis() > configTimeout){
+        if (++configRetries > CFG_RETRIES){
+          configErrors++;
+          nextConfigChunk();
+        } else configState = CFG_SET;
+      }
+      break;
+    case CFG_BAUD:
+      reportConfig();
+      if (_baud == GPS_CONFIG_BAUDRATE){
+        configState = CFG_DONE;
+        break;
+      }
+      sendConfigBaud();
+      configTimeout = millis() + CFG_BAUD_DELAY;
+      configState = CFG_WAIT_BAUD;
+      break;
+    case CFG_WAIT_BAUD:
+      if (millis() > configTimeout){
+        _baud = GPS_CONFIG_BAUDRATE;
+        _bus->begin(_baud);
+        configChanged++;
+        configState = CFG_DONE;
+      }
+      break;
+    default:
+      break;
+  }
+}
 
-    return value;
- }
-    
-  
-  
 /* parse the uBlox data */
 void UBLOX::run()
 {
+  runConfig();
 	// read a byte from the serial port	  
   if (!_bus->available()) return;
   while (_bus->available()) {		
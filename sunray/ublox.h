@@ -20,6 +20,168 @@
 
 #include "Arduino.h"				
 
+
+#define UBX_CLASS_NAV     0x01
+#define UBX_CLASS_RXM     0x02
+#define UBX_NAV_PVT       0x07
+#define UBX_NAV_VELNED    0x12
+#define UBX_NAV_HPPOSLLH  0x14
+#define UBX_NAV_RELPOSNED 0x3C
+#define UBX_NAV_SIG       0x43
+#define UBX_RXM_RTCM      0x32
+#define UBX_CLASS_ACK     0x05
+#define UBX_CLASS_CFG     0x06
+#define UBX_ACK_NAK       0x00
+#define UBX_ACK_ACK       0x01
+#define UBX_CFG_VALSET    0x8A
+#define UBX_CFG_VALGET    0x8B
+
+// UBX payloads (little-endian like the Due, decoded in place from the receive buffer)
+
+typedef struct __attribute__((packed)) {
+  uint32_t iTOW;
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t min;
+  uint8_t sec;
+  uint8_t valid;
+  uint32_t tAcc;
+  int32_t nano;
+  uint8_t fixType;   // 0=no fix, 2=2D, 3=3D, 4=GNSS+dead reckoning, 5=time only
+  uint8_t flags;     // bits 6..7: carrSoln
+  uint8_t flags2;
+  uint8_t numSV;
+  int32_t lon;       // deg * 1e-7
+  int32_t lat;       // deg * 1e-7
+  int32_t height;    // mm
+  int32_t hMSL;      // mm
+  uint32_t hAcc;     // mm
+  uint32_t vAcc;     // mm
+  int32_t velN;      // mm/s
+  int32_t velE;      // mm/s
+  int32_t velD;      // mm/s
+  int32_t gSpeed;    // mm/s
+  int32_t headMot;   // deg * 1e-5
+  uint32_t sAcc;
+  uint32_t headAcc;
+  uint16_t pDOP;
+  uint8_t flags3;
+  uint8_t reserved1[5];
+  int32_t headVeh;
+  int16_t magDec;
+  uint16_t magAcc;
+} ubx_nav_pvt_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t iTOW;
+  int32_t velN;      // cm/s
+  int32_t velE;      // cm/s
+  int32_t velD;      // cm/s
+  uint32_t speed;    // cm/s
+  uint32_t gSpeed;   // cm/s
+  int32_t heading;   // deg * 1e-5
+  uint32_t sAcc;
+  uint32_t cAcc;
+} ubx_nav_velned_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  uint8_t reserved1[2];
+  uint8_t invalidLlh;
+  uint32_t iTOW;
+  int32_t lon;       // deg * 1e-7
+  int32_t lat;       // deg * 1e-7
+  int32_t height;    // mm
+  int32_t hMSL;      // mm
+  int8_t lonHp;      // deg * 1e-9
+  int8_t latHp;      // deg * 1e-9
+  int8_t heightHp;   // mm * 0.1
+  int8_t hMSLHp;     // mm * 0.1
+  uint32_t hAcc;     // mm * 0.1
+  uint32_t vAcc;     // mm * 0.1
+} ubx_nav_hpposllh_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  uint8_t reserved1;
+  uint16_t refStationId;
+  uint32_t iTOW;
+  int32_t relPosN;   // cm
+  int32_t relPosE;   // cm
+  int32_t relPosD;   // cm
+  int32_t relPosLength;
+  int32_t relPosHeading;
+  uint8_t reserved2[4];
+  int8_t relPosHPN;  // mm * 0.1
+  int8_t relPosHPE;
+  int8_t relPosHPD;
+  int8_t relPosHPLength;
+  uint32_t accN;
+  uint32_t accE;
+  uint32_t accD;
+  uint32_t accLength;
+  uint32_t accHeading;
+  uint8_t reserved3[4];
+  uint32_t flags;    // bits 3..4: carrSoln
+} ubx_nav_relposned_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t iTOW;
+  uint8_t version;
+  uint8_t numSigs;
+  uint8_t reserved1[2];
+} ubx_nav_sig_t;     // followed by numSigs ubx_nav_sig_block_t
+
+typedef struct __attribute__((packed)) {
+  uint8_t gnssId;
+  uint8_t svId;
+  uint8_t sigId;
+  uint8_t freqId;
+  int16_t prRes;     // m * 0.1
+  uint8_t cno;       // dBHz
+  uint8_t qualityInd;
+  uint8_t corrSource;
+  uint8_t ionoModel;
+  uint16_t sigFlags;
+  uint8_t reserved2[4];
+} ubx_nav_sig_block_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t clsID;
+  uint8_t msgID;
+} ubx_ack_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  uint8_t layer;
+  uint16_t position;
+} ubx_cfg_valget_t;  // followed by key/value items
+
+typedef struct __attribute__((packed)) {
+  uint8_t version;
+  uint8_t flags;
+  uint16_t subType;
+  uint16_t refStation;
+  uint16_t msgType;
+} ubx_rxm_rtcm_t;
+
+// NAV-SIG signal statistics of one epoch and constellation
+typedef struct {
+  uint8_t signals;   // signals used in navigation solution
+  uint16_t cnoSum;   // dBHz
+  uint16_t resSum;   // |pseudorange residual| (m * 0.1)
+  uint16_t resMax;   // m * 0.1
+} ubx_sig_stat_t;
+
+#define UBX_GNSS_COUNT  7    // gnssId: 0=GPS, 1=SBAS, 2=Galileo, 3=BeiDou, 4=IMES, 5=QZSS, 6=GLONASS
+#define UBX_SIG_WINDOW  10   // NAV-SIG epochs in sliding window
+
+// receive buffer fits the largest fixed-size message (NAV-SIG blocks are decoded while receiving)
+#define UBX_PAYLOAD_SIZE  sizeof(ubx_nav_pvt_t)
+
+
 class UBLOX{
   public:
     enum SolType {
@@ -41,11 +203,24 @@ class UBLOX{
 
     } state_t;    
     
+    typedef enum {
+        CFG_NONE,       // configuration disabled
+        CFG_GET,        // request next chunk of configuration (VALGET)
+        CFG_WAIT_GET,   
+        CFG_SET,        // write differing items of chunk (VALSET)
+        CFG_WAIT_SET,
+        CFG_BAUD,       // raise baudrate
+        CFG_WAIT_BAUD,
+        CFG_DONE
+    } config_state_t;
+    
     unsigned long iTOW;
     int numSV;         // #satellites used in navigation solution
     double lon;        // deg
     double lat;        // deg
     double height;     // m
+    int64_t lonE9;     // deg * 1e9 (full HPPOSLLH resolution)
+    int64_t latE9;     // deg * 1e9
     float relPosN;     // m
     float relPosE;     // m
     float relPosD;     // m
@@ -54,13 +229,24 @@ class UBLOX{
     float accuracy;    // m
     float hAccuracy;   // m
     float vAccuracy;   // m
+    int fixType;       // 0=no fix, 2=2D, 3=3D, 4=GNSS+dead reckoning, 5=time only (NAV-PVT)
+    SolType carrSoln;  // carrier phase solution (NAV-PVT)
     SolType solution;    
     bool solutionAvail;
     unsigned long dgpsAge;
     
+    int sigEpochs;     // NAV-SIG epochs in signal quality window
+    config_state_t configState;
+    int configChanged; // configuration items written to receiver
+    int configErrors;  // chunks rejected (NAK) or not answered, receiver not answering at any baudrate
+    unsigned long droppedFrames; // frames with checksum error (e.g. receive bytes lost)
+    
     UBLOX(HardwareSerial& bus,uint32_t baud);
     void begin();
     void run();
+    // signal quality of constellation (gnssId) over last UBX_SIG_WINDOW NAV-SIG epochs (false if no data)
+    // signals: average signals used per epoch, cno: average C/N0 (dBHz), resAvg/resMax: pseudorange residual (m)
+    bool signalQuality(int gnssId, float &signals, float &cno, float &resAvg, float &resMax);
   private:
     uint32_t _baud;  	
     HardwareSerial* _bus;
@@ -68,17 +254,48 @@ class UBLOX{
     int msgid;
     int msgclass;
     int msglen;
-    char chka;
-    char chkb;
+    int msgdef;   // index into message table (-1: not decoded)
+    uint8_t chka;
+    uint8_t chkb;
     int count;
-    char payload[1000];                                      
+    union {
+      uint8_t bytes[UBX_PAYLOAD_SIZE];
+      uint32_t align;
+    } payload;
+    // NAV-SIG statistics (accumulated per signal block while receiving, committed on valid checksum)
+    int sigCount;
+    ubx_sig_stat_t sigPending[UBX_GNSS_COUNT];
+    ubx_sig_stat_t sigWindow[UBX_SIG_WINDOW][UBX_GNSS_COUNT];
+    int sigWindowIdx;
+    
+    // receiver configuration (see runConfig)
+    bool configDetected;   // receiver answered at current baudrate?
+    int configBaudIdx;     
+    unsigned int configPos;  // position of current chunk in configuration table
+    int configChunkItems;  
+    int configChunkLen;    
+    int configRetries;
+    int configAck;         // 1: ACK, -1: NAK, 0: none
+    bool configReply;      // VALGET reply received?
+    uint32_t configDiffer;         // differing items of chunk (bit mask)
+    uint32_t configPendingDiffer;  // (accumulated while receiving, committed on valid checksum)
+    uint8_t configItem[12];
+    unsigned int configItemLen;
+    unsigned long configTimeout;
     
+    void runConfig();
+    void nextConfigChunk();
+    void reportConfig();
+    int configValue(int pos, uint32_t &key, uint8_t *value);
+    void compareConfigItem();
+    void sendConfigGet();
+    void sendConfigSet();
+    void sendConfigBaud();
+    void send(int msgClass, int msgId, const uint8_t *data, int len);
     void addchk(int b);
+    int findMessage(int msgClass, int msgId, int len);
+    void storePayload(int b);
     void dispatchMessage();
-    long unpack_int32(int offset);
-    long unpack_int16(int offset);
-    long unpack_int8(int offset);
-    long unpack(int offset, int size);
     void parse(int b);	  	    
 };
 
@@ -16,10 +16,16 @@ unsigned int localPort = 4211;  // local port
 unsigned int remotePort = 4210;  // remote port to connect to
 IPAddress remoteIP(REMOTE_IP);
 
+#define UDP_HEADER_SIZE   10      // 'S', 'R', sequence number, millis
+#define UDP_PAYLOAD_SIZE  1024    // console bytes per datagram (below 1472 bytes Ethernet MTU payload, one AT+CIPSEND)
+#define UDP_FLUSH_TIME    200     // max. time (ms) console bytes wait for a datagram (robot standing still)
+
 
 WiFiEspUDP Udp;
-char packetBuffer[100];          // buffer to packet
+uint8_t packetBuffer[UDP_HEADER_SIZE + UDP_PAYLOAD_SIZE];          // buffer to packet
 int idx = 0;
+unsigned long packetSequence = 0;
+unsigned long packetStartTime = 0;
 bool udpStarted = false;
 bool udpActive = false;
 
@@ -30,26 +36,51 @@ void UdpSerial::begin(unsigned long baud){
 
 void UdpSerial::beginUDP(){  
   Udp.begin(localPort);  
-  Udp.beginPacket(remoteIP, remotePort);
-  // Udp.endPacket();
+  idx = 0;
+  packets = 0;
+  sendErrors = 0;
+  overflows = 0;
   udpStarted = true;  
 }
 
+// send buffered bytes as one datagram
+// (WiFiEsp debug output while sending comes back to write() - udpActive prevents recursion)
+void UdpSerial::sendPacket(){
+  if (idx == 0) return;
+  udpActive = true;
+  packetBuffer[0] = 'S';
+  packetBuffer[1] = 'R';
+  memcpy(&packetBuffer[2], &packetSequence, 4);
+  memcpy(&packetBuffer[6], &packetStartTime, 4);
+  size_t len = UDP_HEADER_SIZE + idx;
+  bool ok = (Udp.beginPacket(remoteIP, remotePort) == 1);
+  if (ok) ok = (Udp.write(packetBuffer, len) == len);
+  if (ok) ok = (Udp.endPacket() == 1);
+  if (ok) packets++;
+    else sendErrors++;
+  packetSequence++;
+  idx = 0;
+  udpActive = false;
+}
+
 size_t UdpSerial::write(uint8_t data){
-  if ((udpStarted) && (!udpActive)) {
-    udpActive = true;
-    packetBuffer[idx] = char(data);
-    idx++;
-    if (idx == 99){
-      packetBuffer[idx] = '\0';      
-      Udp.write(packetBuffer);              
-      idx = 0;            
+  if (udpStarted) {
+    if (udpActive) overflows++;
+    else {
+      if (idx == 0) packetStartTime = millis();
+      packetBuffer[UDP_HEADER_SIZE + idx] = data;
+      idx++;
+      if (idx == UDP_PAYLOAD_SIZE) sendPacket();
     }
-    udpActive = false;
   }  
   SerialUSB.write(data);
   return 1; 
 }
+
+void UdpSerial::run(bool idle){
+  if ((!udpStarted) || (udpActive) || (idx == 0) || (!idle)) return;
+  if (millis() - packetStartTime >= UDP_FLUSH_TIME) sendPacket();
+}
   
   
 int UdpSerial::available(){
@@ -67,8 +98,8 @@ int UdpSerial::peek(){
 }
 
 void UdpSerial::flush(){  
+  if ((udpStarted) && (!udpActive)) sendPacket();
   SerialUSB.flush();    
 }
 
 
-
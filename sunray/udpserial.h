@@ -4,7 +4,14 @@
 // or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
 
 /*
-  UDP serial
+  UDP serial (console copy to UDP logger, logger/logger.py)
+    console bytes are batched into datagrams (flushed when full, or after UDP_FLUSH_TIME while the robot 
+    stands still), each datagram starts with a header: 'S', 'R', sequence number (uint32), millis of 
+    first byte (uint32) - the logger detects lost datagrams by sequence gaps
+    sending blocks the main loop: EspDrv::sendDataUdp transfers the datagram at WIFI_BAUDRATE (1 KB: 
+    about 90 ms at 115200) and waits up to 1 s for the '>' prompt and up to 2 s for SEND OK, i.e. a
+    worst-case stall of about 3 s per datagram (ESP not answering) - while driving, datagrams are only 
+    sent when full
 */
 
 #ifndef UDPSERIAL_H
@@ -24,6 +31,13 @@ class UdpSerial: public Stream{
     virtual int read();
     virtual int peek();    
     virtual void flush();
+    // send pending data after UDP_FLUSH_TIME (call in loop, idle: robot stands still)
+    void run(bool idle);
+    unsigned long packets;     // datagrams sent
+    unsigned long sendErrors;  // datagrams failed (sequence number is skipped)
+    unsigned long overflows;   // bytes not sent (written while sending)
+  protected:
+    void sendPacket();
 };
 
 extern UdpSerial udpSerial; // Making it available as udpSerial
@@ -0,0 +1,356 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+#include "validator.h"
+#include "config.h"
+#include "robot.h"
+
+
+#define VALIDATION_DELAY   1000    // validate when map was not changed for this time (ms)
+
+// sweep event kinds (same position: insert edges, then answer queries, then remove edges)
+#define EV_INSERT  0
+#define EV_QUERY   1
+#define EV_REMOVE  2
+
+
+static MapValidator *sortValidator = NULL;
+
+static int compareEventsQsort(const void *a, const void *b){
+  return sortValidator->compareEvents(*((const uint16_t*)a), *((const uint16_t*)b));
+}
+
+static bool pointLess(pt_t a, pt_t b){
+  return (a.x < b.x) || ((a.x == b.x) && (a.y < b.y));
+}
+
+static float cross(pt_t o, pt_t a, pt_t b){
+  return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+// collinear point p within bounding box of a,b?
+static bool onSegment(pt_t a, pt_t b, pt_t p){
+  return (p.x >= min(a.x, b.x)) && (p.x <= max(a.x, b.x)) && (p.y >= min(a.y, b.y)) && (p.y <= max(a.y, b.y));
+}
+
+
+void MapValidator::begin(){
+  validated = false;
+  pending = false;
+  issueCount = 0;
+  duration = 0;
+  events = NULL;
+  status = NULL;
+}
+
+void MapValidator::request(){
+  pending = true;
+  validated = false;
+  requestTime = millis();
+}
+
+bool MapValidator::canValidate(){
+  return ((stateOp == OP_IDLE) || (stateOp == OP_CHARGE) || (stateOp == OP_ERROR));
+}
+
+void MapValidator::run(){
+  if (!pending) return;
+  if (millis() < requestTime + VALIDATION_DELAY) return;
+  if (!canValidate()) return;   // deferred until robot stops
+  validate();
+}
+
+void MapValidator::addIssue(MapIssue type, int idx){
+  if (issueCount < MAX_VALIDATION_ISSUES){
+    issues[issueCount].type = type;
+    issues[issueCount].idx = idx;
+  }
+  issueCount++;
+}
+
+void MapValidator::addRing(int startIdx, int count, bool perimeter){
+  if (count == 0) return;
+  if (count < 3){
+    addIssue(MAP_ISSUE_POLYGON, startIdx);
+    return;
+  }
+  if (ringCount >= MAX_VALIDATION_RINGS) return;
+  ring_t &r = rings[ringCount];
+  r.startIdx = startIdx;
+  r.count = count;
+  r.perimeter = perimeter;
+  // orientation (shoelace area)
+  float area = 0;
+  for (int i=0, j=count-1; i < count; j = i++){
+    pt_t a = maps.points[startIdx + j];
+    pt_t b = maps.points[startIdx + i];
+    area += a.x * b.y - b.x * a.y;
+  }
+  r.ccw = (area > 0);
+  ringCount++;
+}
+
+// ring containing point (rings are ordered by start index)
+int MapValidator::ringOf(int pointIdx){
+  int lo = 0;
+  int hi = ringCount - 1;
+  while (lo < hi){
+    int mid = (lo + hi + 1) / 2;
+    if (rings[mid].startIdx <= pointIdx) lo = mid;
+      else hi = mid - 1;
+  }
+  if ((ringCount == 0) || (pointIdx < rings[lo].startIdx) || (pointIdx >= rings[lo].startIdx + rings[lo].count)) return -1;
+  return lo;
+}
+
+// next point in ring (edge end)
+int MapValidator::nextPoint(int pointIdx){
+  ring_t &r = rings[ringOf(pointIdx)];
+  if (pointIdx + 1 < r.startIdx + r.count) return pointIdx + 1;
+  return r.startIdx;
+}
+
+pt_t MapValidator::eventPoint(uint16_t ev){
+  int idx = ev >> 2;
+  int kind = ev & 3;
+  pt_t a = maps.points[idx];
+  if (kind == EV_QUERY) return a;
+  pt_t b = maps.points[nextPoint(idx)];
+  if (pointLess(a, b) == (kind == EV_INSERT)) return a;
+  return b;
+}
+
+int MapValidator::compareEvents(uint16_t a, uint16_t b){
+  pt_t pa = eventPoint(a);
+  pt_t pb = eventPoint(b);
+  if (pa.x != pb.x) return (pa.x < pb.x) ? -1 : 1;
+  if (pa.y != pb.y) return (pa.y < pb.y) ? -1 : 1;
+  return (int)(a & 3) - (int)(b & 3);
+}
+
+// edge height at sweep position (vertical edge: lower end)
+float MapValidator::edgeY(int edge, float x){
+  pt_t a = maps.points[edge];
+  pt_t b = maps.points[nextPoint(edge)];
+  if (a.x == b.x) return min(a.y, b.y);
+  float t = (x - a.x) / (b.x - a.x);
+  t = max(0.0f, min(1.0f, t));
+  return a.y + t * (b.y - a.y);
+}
+
+// order on sweep line (same height: by slope right of sweep line)
+bool MapValidator::edgeBelow(int edge1, int edge2){
+  float y1 = edgeY(edge1, sweepX);
+  float y2 = edgeY(edge2, sweepX);
+  if (y1 != y2) return (y1 < y2);
+  pt_t a1 = maps.points[edge1];
+  pt_t b1 = maps.points[nextPoint(edge1)];
+  pt_t a2 = maps.points[edge2];
+  pt_t b2 = maps.points[nextPoint(edge2)];
+  if (pointLess(b1, a1)) { pt_t t = a1; a1 = b1; b1 = t; }
+  if (pointLess(b2, a2)) { pt_t t = a2; a2 = b2; b2 = t; }
+  // slope1 < slope2 without division (dx >= 0)
+  return (b1.y - a1.y) * (b2.x - a2.x) < (b2.y - a2.y) * (b1.x - a1.x);
+}
+
+// neighbour edges of same polygon (sharing a point) may touch
+bool MapValidator::adjacent(int edge1, int edge2){
+  if (ringOf(edge1) != ringOf(edge2)) return false;
+  pt_t a1 = maps.points[edge1];
+  pt_t b1 = maps.points[nextPoint(edge1)];
+  pt_t a2 = maps.points[edge2];
+  pt_t b2 = maps.points[nextPoint(edge2)];
+  return ((b1.x == a2.x) && (b1.y == a2.y)) || ((b2.x == a1.x) && (b2.y == a1.y));
+}
+
+// edges cross or touch?
+bool MapValidator::intersect(int edge1, int edge2){
+  pt_t a1 = maps.points[edge1];
+  pt_t b1 = maps.points[nextPoint(edge1)];
+  pt_t a2 = maps.points[edge2];
+  pt_t b2 = maps.points[nextPoint(edge2)];
+  float d1 = cross(a2, b2, a1);
+  float d2 = cross(a2, b2, b1);
+  float d3 = cross(a1, b1, a2);
+  float d4 = cross(a1, b1, b2);
+  if ((((d1 > 0) && (d2 < 0)) || ((d1 < 0) && (d2 > 0))) && (((d3 > 0) && (d4 < 0)) || ((d3 < 0) && (d4 > 0)))) return true;
+  if ((d1 == 0) && (onSegment(a2, b2, a1))) return true;
+  if ((d2 == 0) && (onSegment(a2, b2, b1))) return true;
+  if ((d3 == 0) && (onSegment(a1, b1, a2))) return true;
+  if ((d4 == 0) && (onSegment(a1, b1, b2))) return true;
+  return false;
+}
+
+// check edges at status positions - false on intersection
+bool MapValidator::checkPair(int pos1, int pos2){
+  if ((pos1 < 0) || (pos2 >= statusCount)) return true;
+  int edge1 = status[pos1];
+  int edge2 = status[pos2];
+  if (adjacent(edge1, edge2)) return true;
+  if (!intersect(edge1, edge2)) return true;
+  addIssue(MAP_ISSUE_INTERSECTION, min(edge1, edge2));
+  return false;
+}
+
+bool MapValidator::insertEdge(int edge){
+  int lo = 0;
+  int hi = statusCount;
+  while (lo < hi){
+    int mid = (lo + hi) / 2;
+    if (edgeBelow(status[mid], edge)) lo = mid + 1;
+      else hi = mid;
+  }
+  memmove(&status[lo+1], &status[lo], (statusCount - lo) * sizeof(short));
+  status[lo] = edge;
+  statusCount++;
+  return (checkPair(lo-1, lo) && checkPair(lo, lo+1));
+}
+
+bool MapValidator::removeEdge(int edge){
+  float y = edgeY(edge, sweepX);
+  int lo = 0;
+  int hi = statusCount;
+  while (lo < hi){
+    int mid = (lo + hi) / 2;
+    if (edgeY(status[mid], sweepX) < y) lo = mid + 1;
+      else hi = mid;
+  }
+  // edges at same height: search around position
+  int pos = -1;
+  for (int i=lo; i < statusCount; i++) if (status[i] == edge) { pos = i; break; }
+  if (pos < 0) for (int i=lo-1; i >= 0; i--) if (status[i] == edge) { pos = i; break; }
+  if (pos < 0) return true;
+  memmove(&status[pos], &status[pos+1], (statusCount - pos - 1) * sizeof(short));
+  statusCount--;
+  return checkPair(pos-1, pos);
+}
+
+// point inside allowed area? decided by the nearest edge above the point: interior below a perimeter 
+// edge, exterior below an exclusion edge (exclusion points: first point of exclusion, inside perimeter?)
+void MapValidator::query(int pointIdx){
+  bool exclusion = (pointIdx < boundaryCount);
+  int ignoreRing = (exclusion) ? ringOf(pointIdx) : -1;
+  pt_t p = maps.points[pointIdx];
+  int lo = 0;
+  int hi = statusCount;
+  while (lo < hi){
+    int mid = (lo + hi) / 2;
+    if (edgeY(status[mid], p.x) < p.y) lo = mid + 1;
+      else hi = mid;
+  }
+  bool inside = false;
+  bool perimeterFound = false;
+  for (int i=0; i < ringCount; i++) if (rings[i].perimeter) perimeterFound = true;
+  if (!perimeterFound) inside = true;  // no perimeter: only exclusions restrict
+  for (int i=lo; i < statusCount; i++){
+    int edge = status[i];
+    int ring = ringOf(edge);
+    if (ring == ignoreRing) continue;
+    pt_t a = maps.points[edge];
+    pt_t b = maps.points[nextPoint(edge)];
+    if (a.x == b.x) continue;   // vertical edge
+    if (fabs(edgeY(edge, p.x) - p.y) < 0.001) {
+      inside = true;   // on polygon edge
+      break;
+    }
+    bool interiorBelow = (rings[ring].ccw) ? (b.x < a.x) : (b.x > a.x);
+    inside = (rings[ring].perimeter) ? interiorBelow : !interiorBelow;
+    break;
+  }
+  if (!inside) addIssue((exclusion) ? MAP_ISSUE_EXCLUSION_OUTSIDE : MAP_ISSUE_MOW_OUTSIDE, pointIdx);
+}
+
+void MapValidator::sweep(){
+  sortValidator = this;
+  qsort(events, eventCount, sizeof(uint16_t), compareEventsQsort);
+  statusCount = 0;
+  for (int i=0; i < eventCount; i++){
+    uint16_t ev = events[i];
+    int idx = ev >> 2;
+    sweepX = eventPoint(ev).x;
+    switch (ev & 3){
+      case EV_INSERT:
+        if (!insertEdge(idx)) return;  // sweep order invalid after intersection
+        break;
+      case EV_QUERY:
+        query(idx);
+        break;
+      case EV_REMOVE:
+        if (!removeEdge(idx)) return;
+        break;
+    }
+  }
+}
+
+bool MapValidator::validate(){
+  unsigned long startTime = millis();
+  pending = false;
+  issueCount = 0;
+  ringCount = 0;
+  boundaryCount = maps.dockStartIdx;
+  int mowBlockIdx = maps.dockStartIdx + maps.dockPointsCount;
+  // counts
+  if (maps.freeStartIdx > maps.storeIdx + 1) addIssue(MAP_ISSUE_COUNT, maps.storeIdx + 1);
+  int exclusionPoints = 0;
+  for (int i=0; i < maps.exclusionCount; i++) exclusionPoints += maps.exclusionLength[i];
+  if (exclusionPoints != maps.exclusionPointsCount) addIssue(MAP_ISSUE_EXCLUSION, maps.exclusionCount);
+  if (issueCount == 0){
+    // polygons
+    if (maps.zoneCount > 0){
+      for (int i=0; i < maps.zoneCount; i++) addRing(maps.zones[i].perimeterStartIdx, maps.zones[i].perimeterCount, true);
+    } else addRing(0, boundaryCount - maps.exclusionPointsCount, true);
+    for (int i=0; i < maps.exclusionCount; i++) addRing(maps.exclusionStartIdx[i], maps.exclusionLength[i], false);
+    // sweep events: edges (insert, remove), exclusion and mowing points (query)
+    int edgeCount = 0;
+    for (int i=0; i < ringCount; i++) edgeCount += rings[i].count;
+    int queryCount = ringCount;
+    if (maps.zoneCount > 0){
+      for (int i=0; i < maps.zoneCount; i++) queryCount += maps.zones[i].mowCount;
+    } else queryCount += maps.freeStartIdx - mowBlockIdx;
+    events = (uint16_t*)malloc((2 * edgeCount + queryCount) * sizeof(uint16_t));
+    status = (short*)malloc((edgeCount + 1) * sizeof(short));
+    if ((events == NULL) || (status == NULL)) {
+      addIssue(MAP_ISSUE_MEMORY, 0);
+    } else {
+      eventCount = 0;
+      for (int i=0; i < ringCount; i++){
+        ring_t &r = rings[i];
+        for (int j=r.startIdx; j < r.startIdx + r.count; j++){
+          pt_t a = maps.points[j];
+          pt_t b = maps.points[nextPoint(j)];
+          if ((a.x == b.x) && (a.y == b.y)) continue;   // duplicate point
+          events[eventCount++] = (j << 2) | EV_INSERT;
+          events[eventCount++] = (j << 2) | EV_REMOVE;
+        }
+        if (!r.perimeter) events[eventCount++] = (r.startIdx << 2) | EV_QUERY;
+      }
+      if (maps.zoneCount > 0){
+        for (int i=0; i < maps.zoneCount; i++){
+          for (int j=0; j < maps.zones[i].mowCount; j++) events[eventCount++] = ((maps.zones[i].mowStartIdx + j) << 2) | EV_QUERY;
+        }
+      } else {
+        for (int j=mowBlockIdx; j < maps.freeStartIdx; j++) events[eventCount++] = (j << 2) | EV_QUERY;
+      }
+      sweep();
+    }
+    free(events);
+    free(status);
+    events = NULL;
+    status = NULL;
+  }
+  duration = millis() - startTime;
+  validated = true;
+  CONSOLE.print("map validation: issues=");
+  CONSOLE.print(issueCount);
+  CONSOLE.print(" duration=");
+  CONSOLE.println(duration);
+  for (int i=0; i < min(issueCount, MAX_VALIDATION_ISSUES); i++){
+    CONSOLE.print("  issue ");
+    CONSOLE.print(issues[i].type);
+    CONSOLE.print(" at point ");
+    CONSOLE.println(issues[i].idx);
+  }
+  return (issueCount == 0);
+}
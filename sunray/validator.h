@@ -0,0 +1,106 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+/*
+  map validation (after map transfer, result: AT+A):
+    - point counts, exclusion lengths and zone ranges match the transferred points
+    - perimeters and exclusions are simple polygons not crossing each other: sweep-line over the 
+      polygon edges (Shamos-Hoey), O(n log n)
+    - exclusions lie inside a perimeter, mowing points inside a perimeter and outside exclusions:
+      answered in the same sweep by the polygon edge directly above the point
+  the sweep buffers are only allocated while validating: 2 bytes per sweep event (2 per edge, 1 per
+  queried point) and 2 bytes per edge, e.g. about 14 KB for a 5000-point map
+  validation runs synchronously in the main loop, so it is only started while the robot stands still 
+  (idle, charging, error) - duration is printed (AT+A, console); tests/validator_test measures 3-4 ms 
+  on a PC for 5000 points, on the Due (84 MHz, soft-float) expect some 100 ms
+*/
+
+#ifndef VALIDATOR_H
+#define VALIDATOR_H
+
+#include <Arduino.h>
+#include "map.h"
+
+#define MAX_VALIDATION_ISSUES 8
+#define MAX_VALIDATION_RINGS (MAX_ZONES + MAX_EXCLUSIONS)
+
+
+enum MapIssue {
+  MAP_ISSUE_COUNT = 1,          // point counts exceed transferred points
+  MAP_ISSUE_EXCLUSION,          // exclusion lengths do not match exclusion points
+  MAP_ISSUE_POLYGON,            // perimeter/exclusion with less than 3 points
+  MAP_ISSUE_INTERSECTION,       // polygon edges cross or touch (idx: edge start point)
+  MAP_ISSUE_EXCLUSION_OUTSIDE,  // exclusion outside perimeter (idx: first exclusion point)
+  MAP_ISSUE_MOW_OUTSIDE,        // mowing point outside perimeter or inside exclusion
+  MAP_ISSUE_MEMORY,             // not enough memory for validation
+};
+typedef enum MapIssue MapIssue;
+
+
+struct map_issue_t {
+  uint8_t type;  // MapIssue
+  short idx;     // point index
+};
+
+typedef struct map_issue_t map_issue_t;
+
+
+// polygon (perimeter or exclusion) in points
+struct ring_t {
+  short startIdx;
+  short count;
+  bool perimeter;
+  bool ccw;        // counter-clockwise (interior left of edges)
+};
+
+typedef struct ring_t ring_t;
+
+
+class MapValidator {
+  public:
+    bool validated;       // result available (no map change since validation)
+    int issueCount;       // all found issues (first MAX_VALIDATION_ISSUES are stored)
+    map_issue_t issues[MAX_VALIDATION_ISSUES];
+    unsigned long duration;  // validation time (ms)
+    void begin();
+    // map changed - validate when transfer is complete
+    void request();
+    // validate pending map transfer (robot standing still only)
+    void run();
+    // robot stands still (validation may block the main loop)?
+    bool canValidate();
+    // returns true if no issues
+    bool validate();
+    // sweep event order (qsort)
+    int compareEvents(uint16_t a, uint16_t b);
+  protected:
+    bool pending;
+    unsigned long requestTime;
+    ring_t rings[MAX_VALIDATION_RINGS];
+    int ringCount;
+    int boundaryCount;    // perimeter and exclusion points (edges)
+    uint16_t *events;     // sorted sweep events: point index << 2 | event kind
+    int eventCount;
+    short *status;        // edges crossing sweep line, ordered bottom to top
+    int statusCount;
+    float sweepX;
+    void addIssue(MapIssue type, int idx);
+    void addRing(int startIdx, int count, bool perimeter);
+    int ringOf(int pointIdx);
+    int nextPoint(int pointIdx);
+    pt_t eventPoint(uint16_t ev);
+    float edgeY(int edge, float x);
+    bool edgeBelow(int edge1, int edge2);
+    bool adjacent(int edge1, int edge2);
+    bool intersect(int edge1, int edge2);
+    bool checkPair(int pos1, int pos2);
+    bool insertEdge(int edge);
+    bool removeEdge(int edge);
+    void query(int pointIdx);
+    void sweep();
+};
+
+
+#endif
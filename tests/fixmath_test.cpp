@@ -0,0 +1,100 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// Q16.16 fixed-point math (fixmath.h): accuracy against the float reference on the inputs of the control 
+// path (headings, odometry angles, squared distances of small and large maps) and host timings
+// (the host has an FPU - on the Due the float functions are soft-float library calls)
+
+#include "test.h"
+#include <random>
+#include "fixmath.h"
+#include "helper.h"
+
+volatile float sink;
+
+void testAtan2(std::mt19937 &rng){
+  std::uniform_real_distribution<float> angle(-PI, PI);
+  std::uniform_real_distribution<float> logLen(-3, 3);
+  float maxErr = 0;
+  for (int i=0; i < 100000; i++){
+    float a = angle(rng);
+    float len = pow(10, logLen(rng));
+    float x = len * cos(a);
+    float y = len * sin(a);
+    maxErr = max(maxErr, (float)fabs(distancePI(atan2f(y, x), fixAtan2f(y, x))));
+  }
+  printf("atan2:   max error %.2e rad (vector length 0.001..1000)\n", maxErr);
+  CHECK(maxErr < 1e-4);
+  CHECK_NEAR(fabs(fixAtan2f(0, -1)), PI, 1e-4);
+  CHECK_NEAR(fixAtan2f(0, 0), 0, 0);
+}
+
+void testSinCos(std::mt19937 &rng){
+  std::uniform_real_distribution<float> angle(-20, 20);
+  float maxErr = 0;
+  for (int i=0; i < 100000; i++){
+    float a = angle(rng);
+    float s;
+    float c;
+    fixSinCosf(a, s, c);
+    maxErr = max(maxErr, (float)max(fabs(s - sinf(a)), fabs(c - cosf(a))));
+  }
+  printf("sin/cos: max error %.2e (angle -20..20 rad)\n", maxErr);
+  CHECK(maxErr < 1e-4);
+}
+
+void testSqrt(std::mt19937 &rng){
+  std::uniform_real_distribution<float> logV(-3, 7);
+  float maxRelErr = 0;
+  for (int i=0; i < 100000; i++){
+    float v = pow(10, logV(rng));
+    float ref = sqrtf(v);
+    maxRelErr = max(maxRelErr, (float)(fabs(fixSqrtf(v) - ref) / ref));
+  }
+  printf("sqrt:    max relative error %.2e (0.001..1e7)\n", maxRelErr);
+  CHECK(maxRelErr < 1e-4);
+  // distances of long lines (squared distance beyond Q16.16 range)
+  for (float len = 100; len <= 3000; len += 50) CHECK_NEAR(fixSqrtf(sq(len)), len, len * 1e-4);
+  CHECK(fixSqrtf(-1) == 0);
+}
+
+void testRange(){
+  CHECK(floatToFix(40000) == INT32_MAX);
+  CHECK(floatToFix(-40000) == -INT32_MAX);
+  CHECK(floatToFix(1.5) == 98304);
+  CHECK_NEAR(fixToFloat(fixScalePI(floatToFix(3 * PI))), PI, 1e-4);
+  CHECK_NEAR(fixToFloat(fixMul(floatToFix(-2.5), floatToFix(4))), -10, 1e-4);
+  CHECK_NEAR(fixToFloat(fixDiv(floatToFix(1), floatToFix(3))), 1.0/3, 1e-4);
+}
+
+template<typename F> double benchmark(F f){
+  const int n = 1000000;
+  double t = hostMicros();
+  for (int i=0; i < n; i++) f(i);
+  return (hostMicros() - t) * 1000.0 / n;
+}
+
+void bench(){
+  double a = benchmark([](int i){ sink = atan2f(0.001f * i, 3.0f); });
+  double b = benchmark([](int i){ sink = fixAtan2f(0.001f * i, 3.0f); });
+  printf("atan2:   float %.1fns  fixed %.1fns per call (host)\n", a, b);
+  a = benchmark([](int i){ sink = sinf(0.0001f * i) + cosf(0.0001f * i); });
+  b = benchmark([](int i){ float s; float c; fixSinCosf(0.0001f * i, s, c); sink = s + c; });
+  printf("sin+cos: float %.1fns  fixed %.1fns per call (host)\n", a, b);
+  a = benchmark([](int i){ sink = sqrtf(0.01f * i); });
+  b = benchmark([](int i){ sink = fixSqrtf(0.01f * i); });
+  printf("sqrt:    float %.1fns  fixed %.1fns per call (host)\n", a, b);
+}
+
+
+int main(){
+  std::mt19937 rng(1);
+  testRange();
+  testAtan2(rng);
+  testSinCos(rng);
+  testSqrt(rng);
+  bench();
+  return testResult("fixmath_test");
+}
@@ -0,0 +1,120 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// line tracking geometry per control cycle: recomputed per cycle (before the segment cache) against the 
+// cached segment geometry of Map (segmentDir, distanceToTargetLine, segmentNextStraight)
+//   recomputed: atan2 (target), sqrt (distanceLine), 3x sqrt (target/last target distances), 2x atan2 (next point straight)
+//   cached:     atan2 (target), sqrt (target distance) - the rest are products 
+// on the Due every atan2/sqrt is a soft-float library call, the console shows the time on target (ctlUs)
+// (host numbers only compare the variants, they are no measure for the Due)
+
+#include "test.h"
+#include <algorithm>
+#include "testmap.h"
+
+#define ROUNDS   9     // drives over the map (host timing varies between runs: median and range are reported)
+#define REPEAT   50    // calls per variant and control cycle
+
+Map maps;
+
+volatile float sink;
+
+// geometry as computed per cycle before the cache
+static void recomputed(float x, float y){
+  pt_t target = maps.targetPoint;
+  pt_t last = maps.lastTargetPoint;
+  float targetDelta = atan2f(target.y - y, target.x - x);
+  float len = sqrtf( sq(target.y - last.y) + sq(target.x - last.x) );
+  float lateralError = (len < 0.01) ? 0 : ((target.y-last.y)*x - (target.x-last.x)*y + (target.x*last.y - target.y*last.x)) / len;
+  float targetDist = sqrtf( sq(target.x - x) + sq(target.y - y) );
+  float lastTargetDist = sqrtf( sq(last.x - x) + sq(last.y - y) );
+  float approachDist = sqrtf( sq(target.x - x) + sq(target.y - y) );
+  bool straight = false;
+  if ((maps.wayMode == WAY_MOW) && (maps.mowPointsIdx+1 < maps.mowPointsCount)){
+    pt_t next = maps.points[maps.mowStartIdx + maps.mowPointsIdx + 1];
+    float angleCurr = atan2f(target.y - last.y, target.x - last.x);
+    float angleNext = scalePIangles(atan2f(next.y - target.y, next.x - target.x), angleCurr);
+    straight = (fabs(distancePI(angleCurr, angleNext))/PI*180.0 < 20);
+  }
+  sink = targetDelta + lateralError + targetDist + lastTargetDist + approachDist + straight;
+}
+
+// geometry as computed per cycle with the cache (controlRobotVelocity)
+static void cached(float x, float y){
+  pt_t last = maps.lastTargetPoint;
+  float targetDelta = atan2f(maps.targetPoint.y - y, maps.targetPoint.x - x);
+  float lateralError = maps.distanceToTargetLine(x, y);
+  float targetDist = maps.distanceToTargetPoint(x, y);
+  float lastTargetDistSq = sq(last.x - x) + sq(last.y - y);
+  bool straight = maps.nextPointIsStraight();
+  sink = targetDelta + lateralError + targetDist + lastTargetDistSq + straight;
+}
+
+
+struct RoundResult {
+  double nsRecomputed;   // per control cycle
+  double nsCached;
+  long cycles;
+};
+
+// one drive over the lane map (same inputs in every round), variants alternate which one runs first
+RoundResult drive(const TestMap &map, bool cachedFirst){
+  TestMap m = map;
+  m.upload(maps);
+  TestRobot robot;
+  robot.x = m.mow[0].x;
+  robot.y = m.mow[0].y;
+  maps.setLastTargetPoint(robot.x, robot.y);
+  maps.startMowing(robot.x, robot.y);
+  double timeRecomputed = 0;
+  double timeCached = 0;
+  RoundResult res = { 0, 0, 0 };
+  while (robot.step(maps, 0.02)){
+    for (int pass=0; pass < 2; pass++){
+      bool runCached = (pass == 0) == cachedFirst;
+      double t0 = hostMicros();
+      if (runCached) for (int i=0; i < REPEAT; i++) cached(robot.x, robot.y);
+        else for (int i=0; i < REPEAT; i++) recomputed(robot.x, robot.y);
+      double t = hostMicros() - t0;
+      if (runCached) timeCached += t;
+        else timeRecomputed += t;
+    }
+    res.cycles++;
+    // both variants must agree on the lateral error
+    float len = distance(maps.lastTargetPoint.x, maps.lastTargetPoint.y, maps.targetPoint.x, maps.targetPoint.y);
+    if (len > 0.01) CHECK_NEAR(maps.distanceToTargetLine(robot.x, robot.y), 
+        distanceLine(robot.x, robot.y, maps.lastTargetPoint.x, maps.lastTargetPoint.y, maps.targetPoint.x, maps.targetPoint.y), 0.01);
+  }
+  res.nsRecomputed = timeRecomputed * 1000.0 / (res.cycles * REPEAT);
+  res.nsCached = timeCached * 1000.0 / (res.cycles * REPEAT);
+  return res;
+}
+
+int main(){
+  TestMap map;
+  map.lanes(30, 20, 0.5, 0.5);
+  std::vector<double> saved;
+  std::vector<double> recomputedNs;
+  std::vector<double> cachedNs;
+  long cycles = 0;
+  for (int round=0; round < ROUNDS; round++){
+    RoundResult r = drive(map, (round % 2) == 1);
+    cycles = r.cycles;
+    recomputedNs.push_back(r.nsRecomputed);
+    cachedNs.push_back(r.nsCached);
+    saved.push_back(100.0 * (1.0 - r.nsCached / r.nsRecomputed));
+  }
+  std::sort(saved.begin(), saved.end());
+  std::sort(recomputedNs.begin(), recomputedNs.end());
+  std::sort(cachedNs.begin(), cachedNs.end());
+  int mid = ROUNDS / 2;
+  printf("control cycles=%ld x %d rounds (host, -O2, median [min..max] per cycle):\n", cycles, ROUNDS);
+  printf("  recomputed %.1f ns [%.1f..%.1f]  cached %.1f ns [%.1f..%.1f]  saved %.0f%% [%.0f..%.0f%%]\n",
+    recomputedNs[mid], recomputedNs[0], recomputedNs[ROUNDS-1], cachedNs[mid], cachedNs[0], cachedNs[ROUNDS-1],
+    saved[mid], saved[0], saved[ROUNDS-1]);
+  printf("library calls per cycle: recomputed 3 atan2 + 4 sqrt + 1 div, cached 1 atan2 + 1 sqrt\n");
+  CHECK(saved[mid] > 0);
+  return testResult("geometry_bench");
+}
@@ -0,0 +1,132 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// line tracking controllers (linetracker.h): Stanley, pure pursuit and MPC on a 30 m line
+//   robot: unicycle, motors follow set speeds with 0.1 s lag, 20 ms control period, position noise 1 cm and
+//          heading noise 0.01 rad per cycle, steering restricted to +-PI/16 (as controlRobotVelocity on lines)
+//   cases: lateral offset 0.3 m, heading error 20 degree, side slope (lateral drift 0.03 m/s)
+//   metrics: cross-track RMS (crossTrackRMS), overshoot, time until |error| < 5 cm, mean error of the last 10 s
+//            (no integral action: the side slope leaves a steady error), host time per control call
+
+#include "test.h"
+#include <random>
+#include "linetracker.h"
+#include "helper.h"
+
+#define LINE_LENGTH    30.0    // m
+#define CYCLE          0.02    // s
+#define MOTOR_TAU      0.1     // s
+#define POS_NOISE      0.01    // m
+#define HEADING_NOISE  0.01    // rad
+#define MAX_ANGULAR    (PI/16)
+
+struct BenchResult {
+  float rms;          // m (forward tracking at mowing speed: crossTrackRMS)
+  float overshoot;    // m
+  float settleTime;   // s
+  float steadyError;  // m (mean over last 10 s)
+};
+
+volatile float sink;
+
+BenchResult track(LineTracker &tracker, float speed, float offset, float heading, float drift){
+  std::mt19937 rng(1);
+  std::normal_distribution<float> posNoise(0, POS_NOISE);
+  std::normal_distribution<float> headingNoise(0, HEADING_NOISE);
+  float x = 0;
+  float y = offset;     // left of line (+x direction) is positive y
+  float delta = heading;
+  float linear = 0;
+  float angular = 0;
+  float linearSet = speed;
+  BenchResult res = { 0, 0, -1, 0 };
+  float steadySum = 0;
+  int steadyCount = 0;
+  bool crossed = false;
+  tracker.crossTrackRMS();
+  for (float t=0; x < LINE_LENGTH - 0.5; t += CYCLE){
+    float mx = x + posNoise(rng);
+    float my = y + posNoise(rng);
+    float md = delta + headingNoise(rng);
+    track_t tr;
+    tr.lateralError = -my;
+    tr.headingError = distancePI(md, 0);
+    tr.targetError = distancePI(md, atan2(-my, LINE_LENGTH - mx));
+    tr.targetDist = LINE_LENGTH - mx;
+    tr.speed = linearSet;
+    tr.slow = false;
+    tr.reverse = false;
+    float angularSet = max(-MAX_ANGULAR, min(MAX_ANGULAR, tracker.angular(tr)));
+    // motors
+    float w = CYCLE / (MOTOR_TAU + CYCLE);
+    linear += w * (linearSet - linear);
+    angular += w * (angularSet - angular);
+    delta = scalePI(delta + angular * CYCLE);
+    x += linear * cos(delta) * CYCLE;
+    y += linear * sin(delta) * CYCLE + drift * CYCLE;
+    if ((offset != 0) && (y * offset < 0)) crossed = true;
+    if (crossed) res.overshoot = max(res.overshoot, (float)fabs(y));
+    if (fabs(y) >= 0.05) res.settleTime = -1;
+      else if (res.settleTime < 0) res.settleTime = t;
+    if (x > LINE_LENGTH - 0.5 - 10.0 * speed){
+      steadySum += fabs(y);
+      steadyCount++;
+    }
+  }
+  res.rms = tracker.crossTrackRMS();
+  res.steadyError = (steadyCount == 0) ? 0 : steadySum / steadyCount;
+  return res;
+}
+
+double callTime(LineTracker &tracker){
+  track_t tr = { 0.1, 0.05, 0.06, 5.0, 0.3, false, false };
+  double start = hostMicros();
+  for (int i=0; i < 1000000; i++){
+    tr.lateralError = 0.1 + i * 1e-7;
+    sink = tracker.angular(tr);
+  }
+  return (hostMicros() - start) / 1000.0;  // ns per call
+}
+
+int main(){
+  LineTracker tracker;
+  tracker.begin();
+  const char *cases[3] = { "offset 0.3 m", "heading 20 deg", "side slope" };
+  for (int type=0; type < CTL_COUNT; type++){
+    tracker.setType(type);
+    printf("%s (host %.1f ns per call)\n", tracker.typeName(), callTime(tracker));
+    for (int s=0; s < 2; s++){
+      float speed = (s == 0) ? 0.3 : 0.5;
+      for (int c=0; c < 3; c++){
+        BenchResult r;
+        if (c == 0) r = track(tracker, speed, 0.3, 0, 0);
+          else if (c == 1) r = track(tracker, speed, 0, 20.0 / 180.0 * PI, 0);
+          else r = track(tracker, speed, 0, 0, 0.03);
+        printf("  %.1f m/s %-15s rms %.3f m  overshoot %.3f m  settled %4.1f s  steady error %.3f m\n", speed, cases[c], 
+          r.rms, r.overshoot, r.settleTime, r.steadyError);
+        CHECK(r.rms < 0.1);
+        CHECK(r.overshoot < 0.05);
+        if (c < 2) CHECK((r.settleTime >= 0) && (r.settleTime < 10));
+        CHECK(r.steadyError < 0.1);
+      }
+    }
+  }
+  // crossTrackRMS only counts forward tracking at mowing speed
+  tracker.setType(CTL_STANLEY);
+  track_t tr = { 0.5, 0, 0, 5.0, 0.1, false, false };
+  tracker.angular(tr);          // approaching/float speed
+  tr.speed = 0.3;
+  tr.slow = true;
+  tracker.angular(tr);          // docking
+  tr.slow = false;
+  tr.reverse = true;
+  tracker.angular(tr);          // reverse
+  CHECK(tracker.crossTrackRMS() == 0);
+  tr.reverse = false;
+  tr.lateralError = 0.2;
+  tracker.angular(tr);
+  CHECK_NEAR(tracker.crossTrackRMS(), 0.2, 1e-6);
+  return testResult("linetracker_bench");
+}
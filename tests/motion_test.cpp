@@ -0,0 +1,94 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// slip/stall/obstacle detection (motion.h): replays the traces in traces/*.csv (format: traces/make_traces.py)
+// and checks the classification - false positives on normal driving, detection latency on events
+
+#include "test.h"
+#include <algorithm>
+#include <string>
+#include <cstring>
+#include <dirent.h>
+#include "motion.h"
+
+#define TRACE_DIR     "traces"
+#define WHEEL_DIAMETER_M  0.25
+#define WHEEL_BASE_M      0.36
+
+static MotionState parseState(const char *name){
+  if (strcmp(name, "slip") == 0) return MOTION_SLIP;
+  if (strcmp(name, "stall") == 0) return MOTION_STALL;
+  if (strcmp(name, "obstacle") == 0) return MOTION_OBSTACLE;
+  return MOTION_NONE;
+}
+
+// optional CSV field (empty: no sample)
+static bool field(char *&p, float &value){
+  char *end = strchr(p, ',');
+  if (end) *end = 0;
+  bool valid = (*p != 0) && (*p != '\n') && (*p != '\r');
+  if (valid) value = atof(p);
+  p = end ? end + 1 : p + strlen(p);
+  return valid;
+}
+
+void replay(const std::string &name){
+  std::string path = std::string(TRACE_DIR) + "/" + name;
+  FILE *f = fopen(path.c_str(), "r");
+  CHECK(f != NULL);
+  if (!f) return;
+  char line[256];
+  char expectName[16] = "none";
+  long after = -1;
+  long within = 0;
+  if (fgets(line, sizeof(line), f)) sscanf(line, "# expect=%15s after=%ld within=%ld", expectName, &after, &within);
+  MotionState expect = parseState(expectName);
+  fgets(line, sizeof(line), f);  // column names
+
+  MotionDetector detector;
+  hostMillis = 0;
+  detector.begin();
+  detector.enabled = true;
+  float wheelSpeedScale = PI * WHEEL_DIAMETER_M / 60.0;  // rpm => m/s
+  MotionState detected = MOTION_NONE;
+  long detectTime = -1;
+  while (fgets(line, sizeof(line), f)){
+    char *p = line;
+    float v[9];
+    bool valid[9];
+    for (int i=0; i < 9; i++) valid[i] = field(p, v[i]);
+    // millis() 0 is the 'no sample' marker of the detector: start at 1 ms
+    hostMillis = (unsigned long)v[0] + 1;
+    if (valid[7]) detector.addGroundSpeed(v[7]);
+    if (valid[8]) detector.addYawIMU(v[8]);
+    detector.run(v[1], v[2], v[3], v[4], v[3] * wheelSpeedScale, v[4] * wheelSpeedScale, WHEEL_BASE_M, v[5], v[6]);
+    if ((detector.state != MOTION_NONE) && (detected == MOTION_NONE)){
+      detected = detector.state;
+      detectTime = (long)v[0];
+    }
+  }
+  fclose(f);
+  if (detected == MOTION_NONE) printf("%-16s expect=%-8s detected=none\n", name.c_str(), expectName);
+    else printf("%-16s expect=%-8s detected=%-8s at %ld ms\n", name.c_str(), expectName, detector.stateName(), detectTime);
+  CHECK(detected == expect);
+  if (expect != MOTION_NONE) CHECK((detectTime >= after) && (detectTime <= after + within));
+}
+
+int main(){
+  std::vector<std::string> traces;
+  DIR *dir = opendir(TRACE_DIR);
+  CHECK(dir != NULL);
+  if (dir){
+    while (struct dirent *e = readdir(dir)){
+      std::string name = e->d_name;
+      if ((name.size() > 4) && (name.compare(name.size() - 4, 4, ".csv") == 0)) traces.push_back(name);
+    }
+    closedir(dir);
+  }
+  std::sort(traces.begin(), traces.end());
+  CHECK(traces.size() > 0);
+  for (size_t i=0; i < traces.size(); i++) replay(traces[i]);
+  return testResult("motion_test");
+}
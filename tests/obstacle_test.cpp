@@ -0,0 +1,135 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// obstacle layer and detour planner (Map::addObstacle, startDetour, planDetour):
+// a robot mows a lane map with scripted obstacles, a sonar triggers when an obstacle is ahead - the 
+// robot must drive around each obstacle, rejoin the lane and finish the mission without touching one
+
+#include "testmap.h"
+
+#define SONAR_RANGE   0.35    // trigger distance to obstacle surface (m)
+#define SONAR_ANGLE   0.5     // sonar half opening angle (rad)
+
+Map maps;
+
+struct ScriptedObstacle {
+  float x;
+  float y;
+  float radius;
+};
+
+
+void testMergeAndDecay(){
+  maps.begin();
+  hostMillis = 1000;
+  int a = maps.addObstacle(5, 5);
+  int b = maps.addObstacle(5.2, 5);   // within merge radius: grows obstacle a
+  CHECK(a == b);
+  CHECK(maps.obstacleCount == 1);
+  CHECK(maps.obstacles[a].radius > 0.15);
+  int c = maps.addObstacle(8, 5);
+  CHECK(c != a);
+  CHECK(maps.obstacleCount == 2);
+  // obstacle c is seen again later, a decays
+  hostMillis = 1000 + 500000;
+  maps.addObstacle(8, 5);
+  hostMillis = 1000 + 700000;
+  for (int i=0; i < 10; i++) maps.run();
+  CHECK(maps.obstacleCount == 1);
+  CHECK_NEAR(maps.obstacles[0].x, 8, 0.01);
+}
+
+
+// returns number of detours, -1 if mission failed
+int simulate(TestMap &map, const std::vector<ScriptedObstacle> &obstacles, float &minClearance, double &maxPlanUs){
+  map.upload(maps);
+  TestRobot robot;
+  robot.x = map.mow[0].x;
+  robot.y = map.mow[0].y;
+  maps.setLastTargetPoint(robot.x, robot.y);
+  maps.startMowing(robot.x, robot.y);
+  int detours = 0;
+  minClearance = 1e9;
+  maxPlanUs = 0;
+  for (int cycle=0; cycle < 500000; cycle++){
+    hostMillis += 20;
+    if (maps.detourPlanning){
+      double t = hostMicros();
+      bool found = maps.planDetour();
+      maxPlanUs = max(maxPlanUs, hostMicros() - t);
+      if (found) detours++;
+      else if (!maps.detourPlanning) return -1;  // no detour: robot would stop (OP_ERROR)
+      continue;
+    }
+    for (const ScriptedObstacle &o : obstacles){
+      float d = distance(robot.x, robot.y, o.x, o.y) - o.radius;
+      minClearance = min(minClearance, d);
+      if ((maps.trackReverse) || (d > SONAR_RANGE)) continue;
+      float angle = distancePI(robot.delta, pointsAngle(robot.x, robot.y, o.x, o.y));
+      if (fabs(angle) > SONAR_ANGLE) continue;
+      // sonar echo: obstacle surface straight ahead
+      int idx = maps.addObstacle(robot.x + d * cos(robot.delta), robot.y + d * sin(robot.delta));
+      if (!maps.startDetour(idx, robot.x, robot.y, robot.delta)) return -1;
+      break;
+    }
+    if (maps.detourPlanning) continue;
+    if (!robot.step(maps, 0.02)) return detours;   // mowing finished
+  }
+  return -1;
+}
+
+
+void testLaneDetours(){
+  TestMap map;
+  map.lanes(20, 10, 1.0, 0.5);
+  std::vector<ScriptedObstacle> obstacles;
+  obstacles.push_back({5.0, 2.5, 0.2});    // on lane
+  obstacles.push_back({12.0, 4.4, 0.2});   // slightly off lane
+  obstacles.push_back({16.0, 7.5, 0.3});   // larger obstacle, on lane
+  obstacles.push_back({3.0, 9.5, 0.2});    // lane next to perimeter: detour must pass on the lawn side
+  float minClearance;
+  double maxPlanUs;
+  int detours = simulate(map, obstacles, minClearance, maxPlanUs);
+  printf("lane map: detours=%d minClearance=%.2fm maxPlanStep=%.1fus (host)\n", detours, minClearance, maxPlanUs);
+  CHECK(detours >= (int)obstacles.size());
+  CHECK(minClearance > 0.05);
+  CHECK(!maps.detourActive);
+}
+
+void testNoObstacles(){
+  TestMap map;
+  map.lanes(20, 10, 1.0, 0.5);
+  std::vector<ScriptedObstacle> obstacles;
+  float minClearance;
+  double maxPlanUs;
+  CHECK(simulate(map, obstacles, minClearance, maxPlanUs) == 0);
+}
+
+// obstacle between perimeter and exclusion - no valid detour on either side, robot must stop
+void testBlocked(){
+  TestMap map;
+  map.lanes(20, 10, 1.0, 0.5);
+  std::vector<pt_t> exclusion;
+  map.rectangle(exclusion, 9.0, 1.0, 11.0, 3.0);
+  map.exclusions.push_back(exclusion);
+  map.mow.clear();
+  map.mow.push_back(TestMap::pt(1, 0.5));
+  map.mow.push_back(TestMap::pt(19, 0.5));
+  std::vector<ScriptedObstacle> obstacles;
+  obstacles.push_back({10.0, 0.5, 0.2});
+  float minClearance;
+  double maxPlanUs;
+  CHECK(simulate(map, obstacles, minClearance, maxPlanUs) == -1);
+  CHECK(!maps.detourPlanning);
+}
+
+
+int main(){
+  testMergeAndDecay();
+  testNoObstacles();
+  testLaneDetours();
+  testBlocked();
+  return testResult("obstacle_test");
+}
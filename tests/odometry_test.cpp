@@ -0,0 +1,116 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// online odometry calibration (odometry.h): simulated lane mowing with 180 degree point turns, stops and
+// reverse driving (wheel scales and wheel base differ from nominal, GPS antenna ahead of the wheel axle)
+
+#include "test.h"
+#include <random>
+#include "odometry.h"
+#include "config.h"
+#include "storage.h"
+
+Storage storage;   // (robot.cpp) no EEPROM on host: nothing loaded
+
+#define TRUE_SCALE_LEFT    1.04
+#define TRUE_SCALE_RIGHT   0.97
+#define TRUE_WHEEL_BASE    40.0   // cm (nominal: WHEEL_BASE_CM)
+#define ANTENNA_OFFSET     15.0   // cm ahead of wheel axle
+#define ODO_DT             0.02   // s
+#define GPS_INTERVAL       10     // odometry steps per GPS fix (5 Hz)
+#define GPS_NOISE          1.0    // cm
+
+struct SimRobot {
+  OdometryCalibration &calib;
+  std::mt19937 rng;
+  std::normal_distribution<float> noise;
+  float x, y, heading;   // cm, rad
+  long steps;
+  bool fix;
+  SimRobot(OdometryCalibration &c) : calib(c), rng(1), noise(0, GPS_NOISE), x(0), y(0), heading(0), steps(0), fix(true) {}
+  // one odometry step with true wheel distances (cm)
+  void step(float trueLeft, float trueRight){
+    float d = 0.5 * (trueLeft + trueRight);
+    float dTheta = (trueRight - trueLeft) / TRUE_WHEEL_BASE;
+    x += d * cos(heading + 0.5 * dTheta);
+    y += d * sin(heading + 0.5 * dTheta);
+    heading += dTheta;
+    calib.addOdometry(trueLeft / TRUE_SCALE_LEFT, trueRight / TRUE_SCALE_RIGHT);
+    steps++;
+    if (steps % GPS_INTERVAL != 0) return;
+    if (!fix) {
+      calib.reset();
+      return;
+    }
+    float antX = x + ANTENNA_OFFSET * cos(heading) + noise(rng);
+    float antY = y + ANTENNA_OFFSET * sin(heading) + noise(rng);
+    calib.addPosition(antX / 100.0, antY / 100.0);
+  }
+  void drive(float dist, float speed){
+    int n = fabs(dist) / (speed * ODO_DT);
+    float s = (dist < 0) ? -speed * ODO_DT : speed * ODO_DT;
+    for (int i=0; i < n; i++) step(s, s);
+  }
+  void rotate(float angle, float omega){
+    int n = fabs(angle) / (omega * ODO_DT);
+    float s = 0.5 * TRUE_WHEEL_BASE * omega * ODO_DT;
+    if (angle < 0) s = -s;
+    for (int i=0; i < n; i++) step(-s, s);
+  }
+  void stop(float duration){
+    for (int i=0; i < duration / ODO_DT; i++) step(0, 0);
+  }
+};
+
+// lane pattern: straight lanes, point turn at each lane end (no forward curves)
+void mowLanes(SimRobot &robot, int lanes, bool reverse){
+  for (int i=0; i < lanes; i++){
+    robot.drive(1000, 30);
+    robot.stop(1);
+    if (reverse) robot.drive(-100, 20);
+    robot.rotate((i % 2 == 0) ? PI/2 : -PI/2, 0.5);
+    robot.drive(30, 20);
+    robot.rotate((i % 2 == 0) ? PI/2 : -PI/2, 0.5);
+  }
+}
+
+void testLanes(bool reverse){
+  OdometryCalibration calib;
+  calib.begin();
+  calib.enabled = true;
+  SimRobot robot(calib);
+  mowLanes(robot, 60, reverse);
+  printf("lanes%s: updates=%lu scaleLeft=%.4f scaleRight=%.4f wheelBaseCm=%.2f\n", reverse ? " (reverse)" : "",
+    calib.updates, calib.scaleLeft, calib.scaleRight, calib.wheelBaseCm);
+  CHECK(calib.updates >= 200);
+  CHECK_NEAR(calib.scaleLeft, TRUE_SCALE_LEFT, 0.01);
+  CHECK_NEAR(calib.scaleRight, TRUE_SCALE_RIGHT, 0.01);
+  CHECK_NEAR(calib.wheelBaseCm, TRUE_WHEEL_BASE, 1.0);
+}
+
+// only in-place rotations between straight lanes observe the wheel base - no FIX in every turn: no estimate
+void testNoFixInTurns(){
+  OdometryCalibration calib;
+  calib.begin();
+  calib.enabled = true;
+  SimRobot robot(calib);
+  for (int i=0; i < 60; i++){
+    robot.drive(1000, 30);
+    robot.fix = false;
+    robot.rotate(PI, 0.5);
+    robot.fix = true;
+  }
+  printf("no FIX in turns: updates=%lu wheelBaseCm=%.2f\n", calib.updates, calib.wheelBaseCm);
+  CHECK_NEAR(calib.scaleLeft, TRUE_SCALE_LEFT, 0.01);
+  CHECK_NEAR(calib.scaleRight, TRUE_SCALE_RIGHT, 0.01);
+  CHECK_NEAR(calib.wheelBaseCm, WHEEL_BASE_CM, 0.5);
+}
+
+int main(){
+  testLanes(false);
+  testLanes(true);
+  testNoFixInTurns();
+  return testResult("odometry_test");
+}
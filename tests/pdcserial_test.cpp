@@ -0,0 +1,163 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// PDC serial receive (pdcserial.h) against a simulated USART/PDC: the PDC runs concurrently to the
+// reader (usartHook: bytes may arrive between any two register accesses)
+//   stream: 115200 baud, reader every 1..20 ms, 150 ms stalls (no loss), one 400 ms stall (overrun,
+//           receive continues)
+//   race: current transfer completes between the RCR check and the RNCR write in PdcSerial::service
+//   (the ring must be below 4 GB: rxBuffer addresses are stored in 32-bit PDC registers)
+
+#include "test.h"
+#include <random>
+#include <new>
+#include <sys/mman.h>
+#include "pdcserial.h"
+
+#define BYTES_PER_MS   11.52   // 115200 baud, 10 bits per byte
+#define HALF           (PDC_RX_BUFFER_SIZE/2)
+
+Usart &usart = usart3;
+uint8_t nextByte = 0;      // byte sequence sent
+unsigned long sent = 0;    // bytes arrived at USART
+bool rhrFull = false;      // byte waiting in receive holding register
+uint8_t rhr = 0;
+unsigned long lost = 0;    // bytes lost in USART (overrun)
+std::mt19937 rng(1);
+int arrivalChance = 0;     // percent: byte arrives on register access
+bool arrivalOnRCR = false; // byte arrives after next RCR read
+
+
+// PDC: move byte from RHR into buffer (next transfer is loaded only when current one completes - 
+// a stopped PDC is not restarted by writing RNCR)
+void pdcStep(){
+  if ((!rhrFull) || ((usart.US_PTCR.v & US_PTCR_RXTEN) == 0) || (usart.US_RCR.v == 0)) return;
+  *((uint8_t*)(uintptr_t)usart.US_RPR.v) = rhr;
+  rhrFull = false;
+  usart.US_RPR.v++;
+  usart.US_RCR.v--;
+  if ((usart.US_RCR.v == 0) && (usart.US_RNCR.v != 0)){
+    usart.US_RPR.v = usart.US_RNPR.v;
+    usart.US_RCR.v = usart.US_RNCR.v;
+    usart.US_RNCR.v = 0;
+  }
+}
+
+// USART: byte received
+void arrive(){
+  if (rhrFull) {
+    usart.US_CSR.v |= US_CSR_OVRE;
+    lost++;
+  }
+  rhr = nextByte++;
+  rhrFull = true;
+  sent++;
+  pdcStep();
+}
+
+void hook(UsartReg *reg, bool write){
+  if ((write) && (reg == &usart.US_CR) && (usart.US_CR.v & US_CR_RSTSTA)) usart.US_CSR.v = 0;
+  bool arrival = (arrivalChance > 0) && ((int)(rng() % 100) < arrivalChance);
+  if ((arrivalOnRCR) && (!write) && (reg == &usart.US_RCR)){
+    arrivalOnRCR = false;
+    arrival = true;
+  }
+  // pause while reprogramming is far shorter than one byte: at most one byte waits in RHR
+  if ((arrival) && (!rhrFull)) arrive();
+    else pdcStep();
+}
+
+PdcSerial *newSerial(){
+  void *mem = mmap(NULL, sizeof(PdcSerial), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  CHECK(mem != MAP_FAILED);
+  PdcSerial *serial = new (mem) PdcSerial(Serial3, USART3);
+  nextByte = 0;
+  sent = 0;
+  rhrFull = false;
+  lost = 0;
+  usartHook = NULL;
+  serial->begin(115200);
+  usartHook = hook;
+  return serial;
+}
+
+// read all available bytes, returns number of sequence errors
+int readAll(PdcSerial *serial, uint8_t &expect, unsigned long &count){
+  int errors = 0;
+  while (serial->available() > 0){
+    int data = serial->read();
+    if (data != expect) errors++;
+    expect = data + 1;
+    count++;
+  }
+  return errors;
+}
+
+void stream(){
+  PdcSerial *serial = newSerial();
+  arrivalChance = 5;
+  std::uniform_int_distribution<int> period(1, 20);
+  uint8_t expect = 0;
+  unsigned long received = 0;
+  int errors = 0;
+  int errorsBeforeStall = -1;
+  for (int step=0; step < 20000; step++){
+    int ms = period(rng);
+    if (step % 500 == 0) ms = 150;
+    if (step == 10000) {
+      errorsBeforeStall = errors;
+      CHECK(serial->overruns == 0);
+      ms = 400;
+    }
+    int n = (int)(ms * BYTES_PER_MS);
+    for (int i=0; i < n; i++) arrive();
+    errors += readAll(serial, expect, received);
+  }
+  printf("stream: sent %lu, received %lu, lost in USART %lu, sequence errors %d, overruns %lu, max. fill %lu\n",
+    sent, received, lost, errors, serial->overruns, serial->maxFill);
+  CHECK(errorsBeforeStall == 0);       // 150 ms stalls: no loss
+  CHECK(serial->overruns > 0);         // 400 ms stall: overrun counted
+  CHECK(errors == 1);                  // one gap, then receive continues
+  CHECK(received + lost == sent);
+  CHECK(serial->maxFill <= PDC_RX_BUFFER_SIZE);
+  arrivalChance = 0;
+}
+
+void race(){
+  PdcSerial *serial = newSerial();
+  // fill first half and all but one byte of second half (first half cannot be queued: unread)
+  for (int i=0; i < 2 * HALF - 1; i++) arrive();
+  CHECK(usart.US_RCR.v == 1);
+  CHECK(usart.US_RNCR.v == 0);
+  uint8_t expect = 0;
+  unsigned long received = 0;
+  int errors = 0;
+  for (int i=0; i < HALF; i++){
+    int data = serial->read();
+    if (data != expect) errors++;
+    expect = data + 1;
+    received++;
+  }
+  // reader left first half: service queues it, last byte of current transfer arrives right after RCR check
+  arrivalOnRCR = true;
+  serial->available();
+  CHECK(!arrivalOnRCR);
+  CHECK(usart.US_RCR.v + usart.US_RNCR.v > 0);   // PDC receives
+  for (int i=0; i < 3 * HALF; i++){
+    arrive();
+    if (i % 100 == 0) errors += readAll(serial, expect, received);
+  }
+  errors += readAll(serial, expect, received);
+  printf("race: received %lu of %d bytes, lost in USART %lu\n", received, 5 * HALF, lost);
+  CHECK(errors == 0);
+  CHECK(lost == 0);
+  CHECK(received == 5 * HALF);
+}
+
+int main(){
+  race();
+  stream();
+  return testResult("pdcserial_test");
+}
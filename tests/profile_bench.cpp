@@ -0,0 +1,125 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// velocity profile (VELOCITY_PROFILE): mission time against the fixed speed rule (0.1 m/s approaching a
+// non-straight point and 3 s after a rotation), and the acceleration/jerk limits of Map::limitAcceleration
+// with the control period varying around 20 ms
+//   robot: heading follows the target line, rotates on the spot (0.5 rad/s) for turns above 20 degree
+
+#include "test.h"
+#include <random>
+#include "testmap.h"
+
+#define ROTATION_SPEED  0.5     // rad/s (controlRobotVelocity)
+#define MIN_SPEED       0.1     // m/s (PROFILE_MIN_SPEED)
+
+Map maps;
+
+struct MissionResult {
+  float time;          // s
+  float distance;      // m
+  float maxAccel;      // m/s^2
+  float maxDecel;
+  float maxJerk;       // m/s^3
+};
+
+MissionResult mission(const TestMap &map, float setSpeed, bool profile){
+  TestMap m = map;
+  m.upload(maps);
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<int> period(15, 25);   // control period (ms)
+  float x = m.mow[0].x;
+  float y = m.mow[0].y;
+  float delta = atan2(m.mow[1].y - y, m.mow[1].x - x);
+  maps.setLastTargetPoint(x, y);
+  maps.startMowing(x, y);
+  MissionResult res = { 0, 0, 0, 0, 0 };
+  float speed = 0;
+  float lastAccel = 0;
+  float leavingTime = 0;    // s since last rotation (fixed speed rule: start counts as rotation)
+  while (res.time < 36000){
+    float dt = period(rng) / 1000.0;
+    res.time += dt;
+    leavingTime += dt;
+    maps.run();
+    pt_t target = maps.targetPoint;
+    float targetDist = maps.distanceToTargetPoint(x, y);
+    float targetAlong = maps.segmentDirX * (target.x - x) + maps.segmentDirY * (target.y - y);
+    bool reached = (maps.transitionActive) ? ((targetDist < 0.1) || (targetAlong <= 0)) : (targetDist < 0.05);
+    if (reached){
+      if (!maps.nextPoint(false)) break;
+      continue;
+    }
+    float bearing = atan2(target.y - y, target.x - x);
+    float diffDelta = distancePI(delta, bearing);
+    float linear;
+    if (fabs(diffDelta) > 20.0 / 180.0 * PI){
+      // rotate on the spot
+      linear = 0;
+      float step = min((float)fabs(diffDelta), (float)(ROTATION_SPEED * dt));
+      delta = scalePI(delta + ((diffDelta < 0) ? -step : step));
+      leavingTime = 0;
+    } else if (profile) {
+      linear = min(setSpeed, max((float)MIN_SPEED, maps.profileSpeed(targetDist)));
+      linear = maps.limitAcceleration(speed, linear, dt);
+      delta = bearing;
+    } else {
+      bool approaching = (setSpeed > 0.2) && (targetDist < 0.3) && (!maps.nextPointIsStraight());
+      linear = ((approaching) || (leavingTime < 3.0)) ? 0.1 : setSpeed;
+      delta = bearing;
+    }
+    float accel = (linear - speed) / dt;
+    if (linear > 0.01 && speed > 0.01){
+      res.maxAccel = max(res.maxAccel, accel);
+      res.maxDecel = max(res.maxDecel, -accel);
+      res.maxJerk = max(res.maxJerk, (float)fabs(accel - lastAccel) / dt);
+    }
+    lastAccel = accel;
+    speed = linear;
+    float step = min(targetDist, speed * dt);
+    x += cos(delta) * step;
+    y += sin(delta) * step;
+    res.distance += step;
+  }
+  return res;
+}
+
+void compare(const char *name, const TestMap &map, float setSpeed){
+  MissionResult fixed = mission(map, setSpeed, false);
+  MissionResult prof = mission(map, setSpeed, true);
+  printf("%-28s setSpeed=%.1f  fixed rule: %6.0f s  profile: %6.0f s (%+.1f%%)  distance %.0f m\n", name, setSpeed,
+    fixed.time, prof.time, 100.0 * (prof.time - fixed.time) / fixed.time, prof.distance);
+  printf("%-28s profile: max. accel %.2f m/s^2, max. decel %.2f m/s^2, max. jerk %.2f m/s^3\n", "",
+    prof.maxAccel, prof.maxDecel, prof.maxJerk);
+  CHECK(prof.time < fixed.time);
+  CHECK_NEAR(prof.distance, fixed.distance, 0.01 * fixed.distance);
+  CHECK(prof.maxAccel <= 0.3 + 1e-3);
+  CHECK(prof.maxDecel <= 0.5 + 1e-3);
+  CHECK(prof.maxJerk <= 1.0 + 1e-2);
+}
+
+// concentric polygons (many small corners that are driven without rotation)
+void rings(TestMap &map, float radius, float laneDist, int corners){
+  map.rectangle(map.perimeter, -radius - 1, -radius - 1, radius + 1, radius + 1);
+  map.mow.clear();
+  for (float r = radius; r > 1.0; r -= laneDist){
+    for (int i=0; i < corners; i++){
+      float a = 2 * PI * i / corners;
+      map.mow.push_back(TestMap::pt(r * cos(a), r * sin(a)));
+    }
+  }
+}
+
+int main(){
+  TestMap lanes;
+  lanes.lanes(20, 10, 0.3, 0.5);
+  TestMap polygons;
+  rings(polygons, 6, 0.3, 36);
+  compare("lanes 20x10 m", lanes, 0.3);
+  compare("lanes 20x10 m", lanes, 0.5);
+  compare("rings r=6 m (10 deg corners)", polygons, 0.3);
+  compare("rings r=6 m (10 deg corners)", polygons, 0.5);
+  return testResult("profile_bench");
+}
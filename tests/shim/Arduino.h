@@ -0,0 +1,125 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// minimal Arduino Due API for host tests (declarations only, see host.cpp) - serial output is discarded,
+// millis() is the simulated time hostMillis
+
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <string>
+typedef uint8_t byte; typedef bool boolean;
+#define PI 3.1415926535897932384626433832795
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 3
+#define FALLING 2
+#define CHANGE 4
+#define HEX 16
+#define DEC 10
+#define A0 54
+#define A1 55
+#define A2 56
+#define A3 57
+#define A4 58
+#define A5 59
+#define A7 61
+#define A8 62
+#define A9 63
+#define A11 65
+#define DAC0 66
+#define DAC1 67
+#define CANRX 68
+#define CANTX 69
+#define B1101000 0x68
+#define B1010000 0x50
+#define F(x) x
+#define sq(x) ((x)*(x))
+#define radians(x) ((x)*PI/180.0)
+#define degrees(x) ((x)*180.0/PI)
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+template<class T> T abs_(T x){return x<0?-x:x;}
+unsigned long millis(); unsigned long micros(); void delay(unsigned long); void delayMicroseconds(unsigned int);
+void pinMode(int,int); void digitalWrite(int,int); int digitalRead(int); int analogRead(int); void analogReadResolution(int);
+void attachInterrupt(int, void(*)(), int); void detachInterrupt(int); int digitalPinToInterrupt(int);
+void watchdogReset(); void watchdogEnable(unsigned long);
+void noInterrupts(); void interrupts();
+class String { public: std::string s; String(){} String(const char*c):s(c){} String(int v){s=std::to_string(v);} String(unsigned v){s=std::to_string(v);} String(long v){s=std::to_string(v);} String(unsigned long v){s=std::to_string(v);} String(float v){s=std::to_string(v);} String(double v){s=std::to_string(v);} String(int v,int){s=std::to_string(v);} String(float v,int){s=std::to_string(v);}
+ unsigned length() const {return s.size();} char operator[](int i) const {return s[i];} char& operator[](int i){return s[i];}
+ String& operator+=(const String&o){s+=o.s;return *this;} String& operator+=(const char*o){s+=o;return *this;} String& operator+=(char c){s+=c;return *this;}
+ String& operator+=(int v){s+=std::to_string(v);return *this;} String& operator+=(unsigned v){s+=std::to_string(v);return *this;} String& operator+=(long v){s+=std::to_string(v);return *this;} String& operator+=(unsigned long v){s+=std::to_string(v);return *this;} String& operator+=(float v){s+=std::to_string(v);return *this;} String& operator+=(double v){s+=std::to_string(v);return *this;}
+ String substring(int a,int b) const {return String(s.substr(a,b-a).c_str());} String substring(int a) const {return String(s.substr(a).c_str());} long toInt() const {return atol(s.c_str());} float toFloat() const {return atof(s.c_str());} double toDouble() const {return atof(s.c_str());}
+ int indexOf(const char*c) const {return s.find(c);} int indexOf(const String&c) const {return s.find(c.s);} int lastIndexOf(char c) const {return s.rfind(c);} const char* c_str() const {return s.c_str();} char charAt(int i) const {return s[i];} bool startsWith(const char*c) const{return s.rfind(c,0)==0;}
+};
+inline String operator+(const String&a,const String&b){String r=a;r+=b;return r;}
+inline String operator+(const String&a,const char*b){String r=a;r+=b;return r;}
+inline String operator+(const String&a,char b){String r=a;r+=b;return r;}
+inline bool operator==(const String&a,const char*b){return a.s==b;}
+class Print { public: virtual size_t write(uint8_t)=0; virtual size_t write(const uint8_t*b,size_t n){for(size_t i=0;i<n;i++)write(b[i]);return n;} size_t write(const char*){return 0;}
+ template<class T> size_t print(T){return 0;} template<class T> size_t print(T,int){return 0;} template<class T> size_t println(T){return 0;} template<class T> size_t println(T,int){return 0;} size_t println(){return 0;} };
+class Stream: public Print { public: virtual int available()=0; virtual int read()=0; virtual int peek()=0; virtual void flush(){} };
+class HardwareSerial: public Stream { public: virtual void begin(unsigned long){} virtual size_t write(uint8_t){return 1;} virtual int available(){return 0;} virtual int read(){return -1;} virtual int peek(){return -1;} using Print::write; };
+extern HardwareSerial SerialUSB, Serial;
+class USARTClass: public HardwareSerial { public: void end(){} };
+extern USARTClass Serial1, Serial2, Serial3;
+// USART/PDC register: usartHook (if set) is called after each access (host tests run the PDC concurrently)
+struct UsartReg; extern void (*usartHook)(UsartReg *reg, bool write);
+struct UsartReg { uint32_t v; operator uint32_t(){ uint32_t r=v; if(usartHook) usartHook(this,false); return r; } UsartReg& operator=(uint32_t x){ v=x; if(usartHook) usartHook(this,true); return *this; } };
+typedef struct { UsartReg US_CR, US_IDR, US_CSR, US_RPR, US_RCR, US_RNPR, US_RNCR, US_PTCR; } Usart;
+extern Usart usart3;
+extern unsigned long hostMillis;
+#define USART3 (&usart3)
+#define US_IDR_RXRDY 1
+#define US_IDR_OVRE 32
+#define US_IDR_FRAME 64
+#define US_CSR_OVRE 32
+#define US_CSR_FRAME 64
+#define US_CR_RSTSTA 256
+#define US_PTCR_RXTEN 1
+#define US_PTCR_RXTDIS 2
+class TwoWire { public: void begin(); void beginTransmission(int); int endTransmission(bool s=true); size_t write(uint8_t); int requestFrom(int,int); int available(); int read(); void setClock(long);};
+extern TwoWire Wire;
+class IPAddress { public: IPAddress(){} IPAddress(uint8_t,uint8_t,uint8_t,uint8_t){} IPAddress(uint32_t){} operator uint32_t() const {return 0;} uint8_t operator[](int)const{return 0;} uint8_t& operator[](int){static uint8_t x;return x;} bool operator==(const IPAddress&)const{return true;} };
+class Client: public Stream { public: virtual int connect(IPAddress, uint16_t)=0; virtual int connect(const char*, uint16_t)=0; virtual size_t write(const uint8_t*,size_t)=0; virtual int read(uint8_t*,size_t)=0; virtual void stop()=0; virtual uint8_t connected()=0; virtual operator bool()=0; };
+class Server: public Print { public: virtual void begin()=0; };
+class UDP: public Stream { public: virtual uint8_t begin(uint16_t)=0; virtual void stop()=0; virtual int beginPacket(IPAddress,uint16_t)=0; virtual int beginPacket(const char*,uint16_t)=0; virtual int endPacket()=0; virtual size_t write(const uint8_t*,size_t)=0; virtual int parsePacket()=0; virtual int read(unsigned char*,size_t)=0; virtual int read(char*,size_t)=0; virtual IPAddress remoteIP()=0; virtual uint16_t remotePort()=0; };
+class __FlashStringHelper;
+#define PROGMEM
+#define PGM_P const char*
+#define pgm_read_byte(x) (*(const uint8_t*)(x))
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strstr_P strstr
+#define vsnprintf_P vsnprintf
+struct Adc { volatile uint32_t ADC_CR, ADC_MR, ADC_EMR, ADC_CHER, ADC_CHDR, ADC_CHSR, ADC_ISR, ADC_IER, ADC_IDR, ADC_RPR, ADC_RCR, ADC_RNPR, ADC_RNCR, ADC_PTCR; };
+extern Adc* ADC;
+#define ADC_ISR_ENDRX 1
+#define ADC_IER_ENDRX 1
+#define ADC_CR_SWRST 1
+#define ADC_CR_START 2
+#define ADC_MR_FREERUN_ON 1
+#define ADC_MR_PRESCAL(x) (x)
+#define ADC_MR_STARTUP_SUT64 1
+#define ADC_MR_TRACKTIM(x) (x)
+#define ADC_MR_SETTLING_AST17 1
+#define ADC_MR_TRANSFER(x) (x)
+#define ADC_EMR_TAG 1
+#define ADC_PTCR_RXTDIS 1
+#define ADC_PTCR_RXTEN 1
+#define ID_ADC 37
+#define ADC_IRQn 37
+void pmc_enable_periph_clk(int); void NVIC_EnableIRQ(int);
+struct PinDescription { int ulADCChannelNumber; };
+extern PinDescription g_APinDescription[];
@@ -0,0 +1,2 @@
+#include "Arduino.h"
+class NewPing{public: NewPing(int,int,int); unsigned ping_cm();};
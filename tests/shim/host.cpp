@@ -0,0 +1,47 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// host implementation of the Arduino shim (simulated time, no hardware)
+
+#include <Arduino.h>
+
+unsigned long hostMillis = 0;
+
+HardwareSerial SerialUSB, Serial; 
+USARTClass Serial1, Serial2, Serial3; 
+Usart usart3;
+void (*usartHook)(UsartReg *reg, bool write) = NULL;
+TwoWire Wire;
+Adc adcRegisters;
+Adc* ADC = &adcRegisters;
+PinDescription g_APinDescription[100];
+
+unsigned long millis(){ return hostMillis; }
+unsigned long micros(){ return hostMillis * 1000; }
+void delay(unsigned long ms){ hostMillis += ms; }
+void delayMicroseconds(unsigned int){}
+void pinMode(int,int){}
+void digitalWrite(int,int){}
+int digitalRead(int){ return 0; }
+int analogRead(int){ return 0; }
+void analogReadResolution(int){}
+void attachInterrupt(int, void(*)(), int){}
+void detachInterrupt(int){}
+int digitalPinToInterrupt(int pin){ return pin; }
+void watchdogReset(){}
+void watchdogEnable(unsigned long){}
+void noInterrupts(){}
+void interrupts(){}
+void pmc_enable_periph_clk(int){}
+void NVIC_EnableIRQ(int){}
+
+void TwoWire::begin(){}
+void TwoWire::beginTransmission(int){}
+int TwoWire::endTransmission(bool){ return 0; }
+size_t TwoWire::write(uint8_t){ return 1; }
+int TwoWire::requestFrom(int,int){ return 0; }
+int TwoWire::available(){ return 0; }
+int TwoWire::read(){ return -1; }
+void TwoWire::setClock(long){}
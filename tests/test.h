@@ -0,0 +1,36 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// host test helpers: checks, result summary and benchmark timer
+// (include first - the Arduino min/max macros break the standard headers)
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <vector>
+
+static int testChecks = 0;
+static int testFailures = 0;
+
+#define CHECK(cond) do { testChecks++; if (!(cond)) { testFailures++; \
+  printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); } } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { testChecks++; double va_ = (a), vb_ = (b); if (!(fabs(va_ - vb_) <= (tol))) { \
+  testFailures++; printf("%s:%d: check failed: %s=%g %s=%g (tol %g)\n", __FILE__, __LINE__, #a, va_, #b, vb_, (double)(tol)); } } while (0)
+
+// host time (us) for benchmarks
+static inline double hostMicros(){
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline int testResult(const char *name){
+  printf("%s: %d checks, %d failed\n", name, testChecks, testFailures);
+  return (testFailures > 0) ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,102 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// host tests: map upload (same order as the app: points, then counts and exclusion lengths) and a 
+// kinematic robot that drives the waypoints of a Map
+
+#ifndef TESTMAP_H
+#define TESTMAP_H
+
+#include "test.h"
+#include "map.h"
+#include "helper.h"
+
+
+struct TestMap {
+  std::vector<pt_t> perimeter;
+  std::vector< std::vector<pt_t> > exclusions;
+  std::vector<pt_t> dock;
+  std::vector<pt_t> mow;
+
+  static pt_t pt(float x, float y){ 
+    pt_t p; 
+    p.x = x; 
+    p.y = y; 
+    return p; 
+  }
+
+  void rectangle(std::vector<pt_t> &poly, float x0, float y0, float x1, float y1){
+    poly.clear();
+    poly.push_back(pt(x0, y0));
+    poly.push_back(pt(x1, y0));
+    poly.push_back(pt(x1, y1));
+    poly.push_back(pt(x0, y1));
+  }
+
+  // lawn (0,0)-(width,height) with mowing lanes along x (alternating direction)
+  void lanes(float width, float height, float laneDist, float margin){
+    rectangle(perimeter, 0, 0, width, height);
+    mow.clear();
+    bool forward = true;
+    for (float y = margin; y <= height - margin + 0.001; y += laneDist){
+      mow.push_back(pt(forward ? margin : width - margin, y));
+      mow.push_back(pt(forward ? width - margin : margin, y));
+      forward = !forward;
+    }
+  }
+
+  bool upload(Map &m){
+    m.begin();
+    // optional map features are off by default (config.h) - host tests drive with them
+    m.nearestResume = true;
+    m.velocityProfile = true;
+    m.smoothTransitions = true;
+    int idx = 0;
+    bool ok = true;
+    for (pt_t p : perimeter) ok &= m.setPoint(idx++, p.x, p.y);
+    for (auto &e : exclusions) for (pt_t p : e) ok &= m.setPoint(idx++, p.x, p.y);
+    for (pt_t p : dock) ok &= m.setPoint(idx++, p.x, p.y);
+    for (pt_t p : mow) ok &= m.setPoint(idx++, p.x, p.y);
+    int exclusionPoints = 0;
+    for (auto &e : exclusions) exclusionPoints += e.size();
+    ok &= m.setWayCount(WAY_PERIMETER, perimeter.size());
+    ok &= m.setWayCount(WAY_EXCLUSION, exclusionPoints);
+    ok &= m.setWayCount(WAY_DOCK, dock.size());
+    ok &= m.setWayCount(WAY_MOW, mow.size());
+    ok &= m.setWayCount(WAY_FREE, 0);
+    for (int i=0; i < (int)exclusions.size(); i++) ok &= m.setExclusionLength(i, exclusions[i].size());
+    return ok;
+  }
+};
+
+
+// robot driving straight to the target point (no dynamics), one call per control cycle
+struct TestRobot {
+  float x;
+  float y;
+  float delta;
+  float speed;         // m/s
+  float reachedDist;   // target reached below this distance (m)
+  float distance;      // distance driven (m)
+
+  TestRobot() : x(0), y(0), delta(0), speed(0.3), reachedDist(0.05), distance(0) {}
+
+  // returns false if no more waypoints
+  bool step(Map &m, float dt){
+    m.run();
+    float d = sqrt( sq(m.targetPoint.x - x) + sq(m.targetPoint.y - y) );
+    if (d < reachedDist) return m.nextPoint(false);
+    float step = min(d, speed * dt);
+    float heading = atan2(m.targetPoint.y - y, m.targetPoint.x - x);
+    x += cos(heading) * step;
+    y += sin(heading) * step;
+    distance += step;
+    delta = m.trackReverse ? scalePI(heading + PI) : heading;
+    return true;
+  }
+};
+
+
+#endif
@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+# Ardumower Sunray 
+# Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+# Licensed GPLv3 for open source use
+# or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+# generates the motion detector traces (*.csv) for motion_test: control cycle values as the firmware
+# passes them to MotionDetector (tick-quantized wheel rpm, motor currents, 5 Hz GPS ground speed,
+# 50 Hz IMU yaw change); recorded robot traces in the same format can be added next to them
+#
+# header line:  # expect=<none|slip|stall|obstacle> [after=<event start ms> within=<max. latency ms>]
+# columns:      t_ms, rpm_set_left, rpm_set_right, rpm_left, rpm_right, current_left, current_right,
+#               gps_speed (m/s, empty: no new solution), imu_delta_yaw (rad, empty: no sample)
+
+import math
+import os
+import random
+
+CYCLE = 20                 # control cycle (ms)
+TICKS_PER_REVOLUTION = 525
+WHEEL_DIAMETER = 0.25      # m
+WHEEL_BASE = 0.36          # m
+MOTOR_TAU = 150.0          # wheel speed time constant (ms)
+BASE_CURRENT = 0.4         # driving current (A)
+
+
+def rpm_to_speed(rpm):
+  return rpm / 60.0 * math.pi * WHEEL_DIAMETER
+
+
+def trace(name, duration, set_rpm, event=None, expect='none', after=None, within=None, seed=1):
+  """set_rpm(t) -> (left, right); event(t) -> dict with optional keys:
+     ratio_left/ratio_right (wheel speed of set speed), load_left/load_right (A),
+     move (robot speed of wheel speed), rotate (robot yaw rate of wheel yaw rate), gps (False: no GPS)"""
+  rnd = random.Random(seed)
+  rpm = [0.0, 0.0]
+  ticks = [0.0, 0.0]
+  lines = []
+  header = '# expect=%s' % expect
+  if after is not None:
+    header += ' after=%d within=%d' % (after, within)
+  lines.append(header)
+  lines.append('t_ms,rpm_set_left,rpm_set_right,rpm_left,rpm_right,current_left,current_right,gps_speed,imu_delta_yaw')
+  for t in range(0, duration, CYCLE):
+    sets = set_rpm(t)
+    ev = event(t) if event else {}
+    ratios = (ev.get('ratio_left', 1.0), ev.get('ratio_right', 1.0))
+    meas = []
+    currents = []
+    for i in range(2):
+      target = sets[i] * ratios[i]
+      accel = (target - rpm[i]) * (1 - math.exp(-CYCLE / MOTOR_TAU))
+      rpm[i] += accel
+      # encoder: whole ticks per control cycle
+      ticks[i] += abs(rpm[i]) / 60.0 * TICKS_PER_REVOLUTION * CYCLE / 1000.0
+      n = math.floor(ticks[i])
+      ticks[i] -= n
+      meas.append(math.copysign(60.0 * n / TICKS_PER_REVOLUTION / (CYCLE / 1000.0), rpm[i]))
+      load = ev.get('load_left' if i == 0 else 'load_right', 0.0)
+      current = 0.0
+      if abs(sets[i]) > 0.5 or abs(rpm[i]) > 0.5:
+        current = BASE_CURRENT + 0.02 * abs(accel) / (CYCLE / 1000.0) + load
+      currents.append(max(0.0, current + rnd.gauss(0, 0.03)))
+    speed_left = rpm_to_speed(rpm[0])
+    speed_right = rpm_to_speed(rpm[1])
+    move = ev.get('move', 1.0)
+    ground = abs(speed_left + speed_right) / 2.0 * move
+    gps = ''
+    if (t % 200 == 0) and ev.get('gps', True):
+      gps = '%.3f' % max(0.0, ground + rnd.gauss(0, 0.02))
+    yaw_rate = (speed_right - speed_left) / WHEEL_BASE * ev.get('rotate', 1.0)
+    imu = '%.5f' % (yaw_rate * CYCLE / 1000.0 + rnd.gauss(0, 0.0005))
+    lines.append('%d,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,%s,%s' % (t, sets[0], sets[1], meas[0], meas[1],
+      currents[0], currents[1], gps, imu))
+  path = os.path.join(os.path.dirname(os.path.abspath(__file__)), name + '.csv')
+  with open(path, 'w') as f:
+    f.write('\n'.join(lines) + '\n')
+
+
+def straight(t):
+  return (30.0, 30.0) if t >= 500 else (0.0, 0.0)
+
+
+def turn(t):
+  return (-20.0, 20.0) if t >= 500 else (0.0, 0.0)
+
+
+def start_stop(t):
+  if t < 500: return (0.0, 0.0)
+  if t < 4000: return (30.0, 30.0)
+  if t < 5000: return (0.0, 0.0)
+  if t < 8000: return (-20.0, -20.0)
+  if t < 9000: return (20.0, -20.0)
+  return (35.0, 25.0)
+
+
+def after(t0, t1, values):
+  return lambda t: values if t0 <= t < t1 else {}
+
+
+trace('straight', 10000, straight)
+trace('start_stop', 12000, start_stop)
+trace('point_turn', 8000, turn)
+trace('curve', 10000, lambda t: (25.0, 35.0) if t >= 500 else (0.0, 0.0))
+trace('gps_dropout', 10000, straight, after(3000, 6000, {'gps': False}))
+trace('bump', 8000, straight, after(4000, 4150, {'ratio_left': 0.5, 'ratio_right': 0.5, 'load_left': 1.0, 'load_right': 1.0}))
+trace('pwm_limit', 10000, straight, after(3000, 10000, {'ratio_left': 0.55, 'ratio_right': 0.55, 'load_left': 0.1, 'load_right': 0.1}))
+trace('slip_gps', 8000, straight, after(3000, 8000, {'move': 0.05, 'load_left': -0.1, 'load_right': -0.1}),
+      expect='slip', after=3000, within=1000)
+trace('slip_yaw', 8000, turn, after(3000, 8000, {'rotate': 0.0}), expect='slip', after=3000, within=1000)
+trace('stall_left', 8000, straight, after(3000, 8000, {'ratio_left': 0.0, 'load_left': 2.0}),
+      expect='stall', after=3000, within=1000)
+trace('obstacle', 8000, straight, after(3000, 8000, {'ratio_left': 0.35, 'ratio_right': 0.35, 'load_left': 1.2, 'load_right': 1.2}),
+      expect='obstacle', after=3000, within=1000)
@@ -0,0 +1,170 @@
+// Ardumower Sunray 
+// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+// Licensed GPLv3 for open source use
+// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+// map validation (validator.h): fixtures with one defect each, and a random 5000-point map (perimeter,
+// 40 exclusions, mowing points inside and outside) against a brute-force point-in-polygon count
+//   benchmark: host time per validate() and sweep buffer size (2 bytes per event and per edge)
+
+#include "test.h"
+#include <random>
+#include "testmap.h"
+#include "validator.h"
+#include "robot.h"
+
+#define BENCH_PERIMETER    400   // points
+#define BENCH_EXCLUSIONS   40
+#define BENCH_EXCLUSION    20    // points per exclusion
+#define BENCH_RUNS         20
+
+Map maps;
+OperationType stateOp = OP_IDLE;
+MapValidator validator;
+
+
+// only issue of given type?
+bool onlyIssue(MapIssue type){
+  return (validator.issueCount == 1) && (validator.issues[0].type == type);
+}
+
+// issue stored (any position)?
+bool hasIssue(MapIssue type, int idx){
+  for (int i=0; i < min(validator.issueCount, MAX_VALIDATION_ISSUES); i++){
+    if ((validator.issues[i].type == type) && (validator.issues[i].idx == idx)) return true;
+  }
+  return false;
+}
+
+int validateMap(TestMap &m){
+  m.upload(maps);
+  validator.validate();
+  return validator.issueCount;
+}
+
+void fixtures(){
+  TestMap valid;
+  valid.lanes(20, 10, 0.5, 0.5);
+  valid.exclusions.resize(1);
+  valid.rectangle(valid.exclusions[0], 5, 4, 7, 6);
+  CHECK(validateMap(valid) == 0);
+  CHECK(validator.validated);
+
+  // bow-tie perimeter
+  TestMap m = valid;
+  m.perimeter.clear();
+  m.perimeter.push_back(TestMap::pt(0, 0));
+  m.perimeter.push_back(TestMap::pt(20, 10));
+  m.perimeter.push_back(TestMap::pt(20, 0));
+  m.perimeter.push_back(TestMap::pt(0, 10));
+  m.mow.clear();
+  validateMap(m);
+  CHECK(onlyIssue(MAP_ISSUE_INTERSECTION));
+
+  // exclusion outside perimeter
+  m = valid;
+  m.rectangle(m.exclusions[0], 25, 4, 27, 6);
+  validateMap(m);
+  CHECK(onlyIssue(MAP_ISSUE_EXCLUSION_OUTSIDE));
+  CHECK(validator.issues[0].idx == 4);
+
+  // exclusion crossing perimeter (right edge: point 1), also covers mowing points at the lane ends
+  m = valid;
+  m.rectangle(m.exclusions[0], 18, 4, 22, 6);
+  validateMap(m);
+  CHECK(hasIssue(MAP_ISSUE_INTERSECTION, 1));
+
+  // mowing point inside exclusion, mowing point outside perimeter
+  m = valid;
+  m.mow.push_back(TestMap::pt(6, 5));
+  validateMap(m);
+  CHECK(onlyIssue(MAP_ISSUE_MOW_OUTSIDE));
+  CHECK(validator.issues[0].idx == 4 + 4 + (int)valid.mow.size());
+  m = valid;
+  m.mow.insert(m.mow.begin(), TestMap::pt(25, 5));
+  validateMap(m);
+  CHECK(onlyIssue(MAP_ISSUE_MOW_OUTSIDE));
+  CHECK(validator.issues[0].idx == 4 + 4);
+
+  // polygon with two points
+  m = valid;
+  m.exclusions[0].resize(2);
+  validateMap(m);
+  CHECK(onlyIssue(MAP_ISSUE_POLYGON));
+
+  // exclusion lengths not matching exclusion points
+  m = valid;
+  m.upload(maps);
+  maps.setExclusionLength(0, 3);
+  validator.validate();
+  CHECK(onlyIssue(MAP_ISSUE_EXCLUSION));
+
+  // validation only while standing still
+  stateOp = OP_MOW;
+  CHECK(!validator.canValidate());
+  stateOp = OP_DOCK;
+  CHECK(!validator.canValidate());
+  stateOp = OP_CHARGE;
+  CHECK(validator.canValidate());
+  stateOp = OP_IDLE;
+  CHECK(validator.canValidate());
+}
+
+bool insidePolygon(const std::vector<pt_t> &poly, pt_t p){
+  bool inside = false;
+  for (int i=0, j=poly.size()-1; i < (int)poly.size(); j = i++){
+    pt_t a = poly[i];
+    pt_t b = poly[j];
+    if (((a.y > p.y) != (b.y > p.y)) && (p.x < (b.x - a.x) * (p.y - a.y) / (b.y - a.y) + a.x)) inside = !inside;
+  }
+  return inside;
+}
+
+void benchmark(){
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> unit(0, 1);
+  TestMap m;
+  for (int i=0; i < BENCH_PERIMETER; i++){
+    float a = 2 * PI * i / BENCH_PERIMETER;
+    float r = 40 + 5 * unit(rng);
+    m.perimeter.push_back(TestMap::pt(r * cos(a), r * sin(a)));
+  }
+  // exclusions on grid (3 m apart, radius up to 1.4 m)
+  for (int i=0; i < BENCH_EXCLUSIONS; i++){
+    float cx = -12 + 3 * (i % 8);
+    float cy = -6 + 3 * (i / 8);
+    std::vector<pt_t> e;
+    for (int j=0; j < BENCH_EXCLUSION; j++){
+      float a = -2 * PI * j / BENCH_EXCLUSION;   // clockwise
+      float r = 1.0 + 0.4 * unit(rng);
+      e.push_back(TestMap::pt(cx + r * cos(a), cy + r * sin(a)));
+    }
+    m.exclusions.push_back(e);
+  }
+  int outside = 0;
+  while ((int)(m.perimeter.size() + BENCH_EXCLUSIONS * BENCH_EXCLUSION + m.mow.size()) < MAX_POINTS){
+    pt_t p = TestMap::pt(-50 + 100 * unit(rng), -50 + 100 * unit(rng));
+    bool valid = insidePolygon(m.perimeter, p);
+    for (auto &e : m.exclusions) if (insidePolygon(e, p)) valid = false;
+    if (!valid) outside++;
+    m.mow.push_back(p);
+  }
+  CHECK(m.upload(maps));
+  int events = 2 * (BENCH_PERIMETER + BENCH_EXCLUSIONS * BENCH_EXCLUSION) + BENCH_EXCLUSIONS + m.mow.size();
+  int edges = BENCH_PERIMETER + BENCH_EXCLUSIONS * BENCH_EXCLUSION;
+  double start = hostMicros();
+  for (int i=0; i < BENCH_RUNS; i++) validator.validate();
+  double time = (hostMicros() - start) / BENCH_RUNS / 1000.0;
+  printf("%d points (%d edges, %d mowing points, %d outside): host %.2f ms per validation, buffers %d bytes\n",
+    MAX_POINTS, edges, (int)m.mow.size(), outside, time, (int)((events + edges + 1) * 2));
+  CHECK(outside > 0);
+  CHECK(validator.issueCount == outside);
+  for (int i=0; i < MAX_VALIDATION_ISSUES; i++) CHECK(validator.issues[i].type == MAP_ISSUE_MOW_OUTSIDE);
+}
+
+int main(){
+  validator.begin();
+  fixtures();
+  benchmark();
+  return testResult("validator_test");
+}
@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+# Ardumower Sunray
+# Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH
+# Licensed GPLv3 for open source use
+# or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)
+
+# converts a u-center configuration file (View->Generation 9 Configuration View->Save configuration)
+# into the compact key/value table the firmware uploads to the F9P at startup (sunray/ubloxcfg.h)
+#
+# usage: python3 f9p_config.py alex_rover_f9p.txt ../sunray/ubloxcfg.h
+#
+# run again whenever the configuration file changes
+
+import sys
+import os
+
+# configuration groups (key bits 16..23) uploaded by the firmware
+GROUPS = {
+  0x11: 'NAVSPG',
+  0x14: 'NAVHPG',
+  0x21: 'RATE',
+  0x31: 'SIGNAL',
+  0x52: 'UART1',
+  0x53: 'UART2',
+  0x73: 'UART1INPROT',
+  0x74: 'UART1OUTPROT',
+  0x75: 'UART2INPROT',
+  0x76: 'UART2OUTPROT',
+  0x91: 'MSGOUT',
+}
+
+# keys handled by the firmware itself
+SKIP_KEYS = {
+  0x40520001,  # CFG-UART1-BAUDRATE (GPS_CONFIG_BAUDRATE)
+  0x40530001,  # CFG-UART2-BAUDRATE (radio link)
+}
+
+VALUE_SIZES = {1: 1, 2: 1, 3: 2, 4: 4, 5: 8}
+
+
+def parse(filename):
+  items = []
+  for line in open(filename):
+    if not line.startswith('CFG-VALGET'):
+      continue
+    msg = bytes.fromhex(line.split(' - ')[1])
+    # class, id, length (2), version, layer, position (2)
+    payload = msg[8:]
+    i = 0
+    while i < len(payload):
+      key = int.from_bytes(payload[i:i+4], 'little')
+      size = VALUE_SIZES[(key >> 28) & 7]
+      items.append((key, payload[i+4:i+4+size]))
+      i += 4 + size
+  return items
+
+
+def main():
+  if len(sys.argv) != 3:
+    print('usage: f9p_config.py <u-center config.txt> <ubloxcfg.h>')
+    sys.exit(1)
+  items = [(key, value) for key, value in parse(sys.argv[1])
+           if ((key >> 16) & 0xFF) in GROUPS and key not in SKIP_KEYS]
+  out = open(sys.argv[2], 'w')
+  out.write('// Ardumower Sunray \n')
+  out.write('// Copyright (c) 2013-2020 by Alexander Grau, Grau GmbH\n')
+  out.write('// Licensed GPLv3 for open source use\n')
+  out.write('// or Grau GmbH Commercial License for commercial use (http://grauonline.de/cms2/?page_id=153)\n\n')
+  out.write('// F9P configuration uploaded at startup (key, little-endian value)\n')
+  out.write('// generated by ublox_f9p_configs/f9p_config.py from %s - do not edit\n\n' % os.path.basename(sys.argv[1]))
+  out.write('#ifndef UBLOXCFG_H\n#define UBLOXCFG_H\n\n')
+  out.write('const uint8_t ubloxConfig[] = {\n')
+  for key, value in items:
+    data = key.to_bytes(4, 'little') + value
+    out.write('  ' + ', '.join('0x%02X' % b for b in data) + ',\n')
+  out.write('};\n\n#endif\n')
+  out.close()
+  print('%d items (%s) written to %s' % (len(items), ', '.join(sorted(GROUPS.values())), sys.argv[2]))
+
+
+if __name__ == '__main__':
+  main()